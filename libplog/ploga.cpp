@@ -1,22 +1,26 @@
 #include "ploga.h"
 
+#include <algorithm>
+#include <charconv>
 #include <fstream>
 #include <istream>
+#include <limits>
 #include <memory>
 #include <string>
 #include <string_view>
+#include <vector>
 
-static std::string_view parseLogLine(std::string const& input, PLogAnalyzer::LineInfo& info) {
+static std::string_view parseLogLine(std::string_view input, PLogAnalyzer::LineInfo& info) {
   // Built-in standard regexp is slow as christmas, we can't use it here :/
   // "(.+);(.+);(T|D|I|W|E|C);(.+);(\\d+);(\\d+);(.*);(.*);(.+)"
   size_t  strpos  = 0;
   int32_t currKey = 0;
 
-  auto inputView = std::string_view(input);
+  auto inputView = input;
   do {
     if (input.length() <= strpos) return {};
     size_t const keyEnd = input.find(';', strpos);
-    if (keyEnd == std::string::npos) return {};
+    if (keyEnd == std::string_view::npos) return {};
     auto const keySize = keyEnd - strpos;
 
     switch (currKey++) {
@@ -34,9 +38,11 @@ static std::string_view parseLogLine(std::string const& input, PLogAnalyzer::Lin
       } break;
       case 4: { // ProcessID
         info.processId = 0;
+        std::from_chars(input.data() + strpos, input.data() + keyEnd, info.processId);
       } break;
       case 5: { // ThreadID
         info.threadId = 0;
+        std::from_chars(input.data() + strpos, input.data() + keyEnd, info.threadId);
       } break;
       case 6: { // Source
         info.source = inputView.substr(strpos, keySize);
@@ -54,258 +60,240 @@ static std::string_view parseLogLine(std::string const& input, PLogAnalyzer::Lin
   return out;
 }
 
+std::string_view PLogAnalyzer::parseLine(std::string_view line, LineInfo& info) {
+  return parseLogLine(line, info);
+}
+
+namespace {
+constexpr uint32_t CheckpointVersion = 1;
+constexpr size_t   PrefixSample      = 64 * 1024;
+
+// Stands for the first size bytes of the input in a checkpoint. Hashing all of them would cost the read the checkpoint is there to save,
+// so it's their head, their tail and the size: a log that was rotated, rewritten or cut doesn't match anymore, an edit in the middle
+// goes unnoticed
+uint64_t prefixHash(std::istream& stream, uint64_t size) {
+  uint64_t          hash = 0xcbf29ce484222325ull ^ size; // FNV-1a
+  std::vector<char> sample;
+
+  auto take = [&](uint64_t from, uint64_t count) {
+    sample.resize((size_t)count);
+    stream.clear();
+    stream.seekg((std::streamoff)from);
+    if (!stream.read(sample.data(), (std::streamsize)count)) return false;
+    for (auto c: sample)
+      hash = (hash ^ (uint8_t)c) * 0x100000001b3ull;
+    return true;
+  };
+
+  auto const head = std::min<uint64_t>(size, PrefixSample);
+  auto const tail = std::max<uint64_t>(size - std::min<uint64_t>(size, PrefixSample), head);
+  if (!take(0, head) || !take(tail, size - tail)) return 0; // Shorter than it was, 0 matches no checkpoint
+  return hash;
+}
+} // namespace
+
 class CharArrayBuffer: public std::streambuf {
   public:
   CharArrayBuffer(const char* data, size_t dataSize) { setg(const_cast<char*>(data), const_cast<char*>(data), const_cast<char*>(data) + dataSize); }
 };
 
-PLogAnalyzer::PLogAnalyzer(const char* data, size_t dataSize) {
+PLogAnalyzer::PLogAnalyzer(const char* data, size_t dataSize, PLogOptions const& options): PLogAnalyzer(options) {
+  m_context.setInput(std::string_view(data, dataSize));
+
   CharArrayBuffer cbuff(data, dataSize);
 
   std::istream strm(&cbuff);
   readstream(strm);
 }
 
-PLogAnalyzer::PLogAnalyzer(std::filesystem::path const& path) {
-  std::ifstream file(path);
+PLogAnalyzer::PLogAnalyzer(std::filesystem::path const& path, PLogOptions const& options): PLogAnalyzer(options) {
+  std::ifstream file(path, std::ios::in | std::ios::binary); // Offsets have to be the file's own, text mode would eat the \r's
   readstream(file);
 }
 
+bool PLogAnalyzer::readLine(std::istream& stream, std::vector<char>& buffer, std::string_view& line, size_t& skipped) {
+  stream.getline(buffer.data(), (std::streamsize)buffer.size());
+
+  auto const got = (size_t)stream.gcount();
+  if (got == 0 && stream.fail()) return false;
+
+  skipped = 0;
+  if (stream.fail() && !stream.eof()) { // Buffer is full and the line goes on
+    stream.clear();
+    stream.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    skipped = (size_t)stream.gcount() - (stream.eof() ? 0 : 1);
+    line    = std::string_view(buffer.data(), got);
+    return true;
+  }
+
+  line = std::string_view(buffer.data(), stream.eof() ? got : got - 1); // gcount() includes the newline
+  return true;
+}
+
 void PLogAnalyzer::readstream(std::istream& stream) {
-  std::string line;
-  while (std::getline(stream, line)) {
-    LineInfo li;
+  readLines(stream);
+  finish();
+}
 
-    auto out = parseLogLine(line, li);
-    if (!render(li, out)) {
-      break;
+bool PLogAnalyzer::readLines(std::istream& stream, bool wholeLines) {
+  // The tap wants the whole log, the analysis may be done with it before
+  bool analysing = true;
+  auto take      = [&](std::string_view line) {
+    if (analysing) {
+      analysing = feed(line);
+    } else {
+      LineInfo li = {};
+
+      auto const out = parseLogLine(line, li);
+      m_tap(line, li, out);
     }
-  }
+    return analysing || m_tap != nullptr;
+  };
 
-  auto& labels = m_jsonInfo["labels"];
-  auto& hints  = m_jsonInfo["hints"];
-
-  if (_isChildprocess) {
-    if (_unityEngineDetected) labels.push_back("engine-unity");
-    if (_unrealEngineDetected) labels.push_back("engine-unreal");
-    if (_cryEngineDetected) labels.push_back("engine-cry");
-    if (_phyreEngineDetected) labels.push_back("engine-phyre");
-    if (_gmakerEngineDetected) labels.push_back("engine-gamemaker");
-    if (_naughtyEngineDetected) labels.push_back("engine-naughty");
-    if (_irrlichtEngineDetected) labels.push_back("engine-irrlicht");
-    if (_exceptionDetected) labels.push_back("exception");
-    if (_fmodSdkDetected) labels.push_back("sdk-fmod");
-    if (_monoSdkDetected) labels.push_back("sdk-mono");
-    if (_criSdkDetected) labels.push_back("sdk-criware");
-    if (_havokSdkDetected) labels.push_back("sdk-havok");
-    if (_wwiseSdkDetected) labels.push_back("sdk-wwise");
-    if (_missingSymbolDetected) labels.push_back("missing-symbol");
-  } else {
-    if (_inputNotFoundHint)
-      hints.push_back("One of your users has the input device set incorrectly, if you can't control the PS4 app, this could be the cause.");
-    if (_nvidiaHint)
-      hints.push_back("You are using an NVIDIA graphics card, these cards have many issues on our emulator that may not be present on AMD cards.");
-    if (_hintAndnPatched || _hintExtrqPatched || _hintInsertqPatched) {
-      std::string unsupported = "Your CPU does not support some instructions (";
-      if (_hintAndnPatched) unsupported += "ANDN, ";
-      if (_hintExtrqPatched) unsupported += "EXTRQ, ";
-      if (_hintInsertqPatched) unsupported += "INSERTQ, ";
-      hints.push_back(unsupported + ") and they have been patched");
+  if (m_lineBytes == SIZE_MAX) {
+    std::string line;
+    while (std::getline(stream, line)) {
+      if (wholeLines && stream.eof()) break; // Ran into the end before a newline
+      if (!take(line)) {
+        return false;
+      }
     }
-    if (_hintAjmFound) hints.push_back("This game uses hardware audio encoding/decoding");
-    if (_vkValidation) labels.push_back("graphics");
-    if (_shaderGenTodo) labels.push_back("shader-gen");
-    if (_vkNoDevices) {
-      hints.push_back("Your GPU is not supported at the moment");
-      labels.push_back("badgpu");
+  } else {
+    std::vector<char> buffer(m_lineBytes + 1); // getline() wants room for the terminator
+    std::string_view  line;
+    size_t            skipped;
+    while (readLine(stream, buffer, line, skipped)) {
+      if (wholeLines && stream.eof()) break;
+      bool const fed       = analysing;
+      bool const keepGoing = take(line);
+      if (skipped > 0 && fed) skip(skipped);
+      if (!keepGoing) return false;
     }
   }
+  return analysing;
+}
+
+bool PLogAnalyzer::feed(std::string_view line) {
+  LineInfo li = {};
+
+  auto out = parseLogLine(line, li);
+  if (m_tap != nullptr) m_tap(line, li, out);
+  return feed(line, li, out);
+}
+
+bool PLogAnalyzer::feed(std::string_view line, LineInfo const& info, std::string_view out) {
+  auto const offset = m_offset;
+  m_offset += line.size() + 1; // getline() ate the newline
 
-  if (_hintTrophyKey)
-    hints.push_back("You don't have the trophy key installed, this can cause problems in games, also you won't be able to see the list of trophies you have "
-                    "received. To solve this problem, check #faq channel in on Discord Server.");
+  m_context.push(offset, line, info.threadId);
+  m_rules.setLinePosition(offset, ++m_line);
+  return render(info, out);
+}
+
+bool PLogAnalyzer::feed(size_t lineSize, LineInfo const& info, std::string_view out) {
+  auto const offset = m_offset;
+  m_offset += lineSize + 1;
+
+  m_context.push(offset, (uint32_t)lineSize, info.threadId);
+  m_rules.setLinePosition(offset, ++m_line);
+  return render(info, out);
+}
+
+void PLogAnalyzer::skip(size_t bytes) {
+  m_offset += bytes;
+  ++m_cutLines;
+}
+
+void PLogAnalyzer::finish() {
+  m_rules.finalize();
+  m_rules.markTruncated("lines", m_cutLines);
+}
+
+nlohmann::json PLogAnalyzer::current() const {
+  auto report = m_rules.current();
+  if (m_cutLines > 0) report["truncated"]["lines"] = m_cutLines;
+  return report;
 }
 
 bool PLogAnalyzer::render(LineInfo const& lineInfo, std::string_view out) {
   if (out.empty()) return true; // Skip line rendering
 
-  if (!_processTypeGuessed) {
-    _processTypeGuessed = true;
-    if ((_isChildprocess = (out == "child process")) == true) { // Prepare child process things
-      m_jsonInfo = {
-          {"type", "child-process"},
-          {
-              "labels",
-              nlohmann::json::array(),
-          },
-          {
-              "firmware",
-              nlohmann::json::array(),
-          },
-          {
-              "hints",
-              nlohmann::json::array(),
-          },
-          {"emu_neo", false},
-          {"emu_skipAjm", false},
-          {"emu_skipMovies", false},
-          {"emu_networking", false},
-          {"emu_noElfCheck", false},
-          {"title_name", "Unnamed"},
-          {"title_id", "CUSA00000"},
-          {"title_neo", false},
-      };
-    } else { // Prepare main process things
-      m_jsonInfo = {
-          {"type", "main-process"},
-          {
-              "labels",
-              nlohmann::json::array(),
-          },
-          {
-              "hints",
-              nlohmann::json::array(),
-          },
-          {"user-gp", "UNDETECTED"},
-          {"user-lang", "UNDETECTED"},
-      };
-    }
+  bool const hadException = m_rules._exceptionDetected;
+  bool const keepGoing    = m_rules.render(lineInfo.module, out);
+  if (!hadException && m_rules._exceptionDetected) m_rules.attach("crash_context", m_context.snapshot(lineInfo.threadId));
+  m_rules.tick();
+  return keepGoing;
+}
 
-    return true;
-  }
+nlohmann::json PLogAnalyzer::save() const {
+  return {
+      {"offset", m_offset},
+      {"line", m_line},
+      {"cut_lines", m_cutLines},
+      {"rules", m_rules.save()},
+      {"context", m_context.save()},
+  };
+}
 
-  if (_isChildprocess) { // Handle child logs
-    if (lineInfo.module == "TTY") {
-      if (!_gmakerEngineDetected && out.contains("YoYo Games PS4 Runner")) _gmakerEngineDetected = true;
-      if (!_irrlichtEngineDetected && out.contains("Irrlicht Engine")) _irrlichtEngineDetected = true;
-      if (!_unrealEngineDetected && out.starts_with("Additional") && out.contains(".uproject")) _unrealEngineDetected = true;
-      if (!_unrealEngineDetected && out.contains("uecommandline.txt")) _unrealEngineDetected = true;
-      if (!_naughtyEngineDetected && out.contains("ND File Server")) _naughtyEngineDetected = true;
-      if (!_naughtyEngineDetected && out.contains("----- Switching world: from")) _naughtyEngineDetected = true;
-    } else {
-      if (out.starts_with("todo ")) {
-        if (!_netStuffDetected && out.starts_with("todo sceNp")) _netStuffDetected = true;
-        return true;
-      }
+bool PLogAnalyzer::load(nlohmann::json const& state) {
+  uint64_t offset, line, cutLines;
 
-      if (lineInfo.module == "pthread") {
-        if (out.starts_with("--> thread")) { // Thread run log
-          if (!_unityEngineDetected) {
-            if (out.contains("UnityWorker")) _unityEngineDetected = true;
-            if (!_unityEngineDetected && out.contains("UnityGfx")) _unityEngineDetected = true;
-          }
-          if (!_criSdkDetected) {
-            if (out.contains("CriThread") || out.contains("CRI FS")) _criSdkDetected = true;
-          }
-          if (!_wwiseSdkDetected) {
-            if (out.contains("Wwise")) _wwiseSdkDetected = true;
-            if (!_wwiseSdkDetected && out.contains("AK::LibAudioOut")) _wwiseSdkDetected = true;
-          }
-          if (!_phyreEngineDetected) {
-            if (out.contains("PhyreEngine")) _phyreEngineDetected = true;
-          }
-          if (!_fmodSdkDetected) {
-            if (out.contains("FMOD mixer")) _fmodSdkDetected = true;
-          }
-          if (!_havokSdkDetected) {
-            if (out.contains("HavokWorkerThread")) _havokSdkDetected = true;
-          }
-        }
-      } else if (lineInfo.module == "libSceKernel") {
-        if (!_monoSdkDetected) {
-          // todo regex?
-          if (out.contains(".mono\\config")) _monoSdkDetected = true;
-          if (!_monoSdkDetected && out.contains(".mono/config")) _monoSdkDetected = true;
-        }
-        if (!_unityEngineDetected) {
-          if (out.contains("unity default resources")) _unityEngineDetected = true;
-        }
-        if (!_unrealEngineDetected) {
-          if (out.contains("UE3_logo.")) _unrealEngineDetected = true;
-        }
-      } else if (lineInfo.module == "runtime") {
-        if (out.contains("Missing Symbol|")) _missingSymbolDetected = true;
-      } else if (lineInfo.module == "Kernel") {
-        if (out == "-> client shutdown request") {
-          // Stop processing log lines after the Stop button press
-          // the rest is unrelated to the game itself.
-          return false;
-        }
-        if (out.starts_with("psOff.")) {
-          auto value = out.substr(out.find_first_of('=') + 2);
-
-          if (out.contains(".isNeo = "))
-            m_jsonInfo["emu_neo"] = value == "1";
-          else if (out.contains(".skipAJM = "))
-            m_jsonInfo["emu_skipAjm"] = value == "1";
-          else if (out.contains(".skipMovies = "))
-            m_jsonInfo["emu_skipMovies"] = value == "1";
-          else if (out.contains(".networking = "))
-            m_jsonInfo["emu_networking"] = value == "1";
-          else if (out.contains(".noElfCheck = "))
-            m_jsonInfo["emu_noElfCheck"] = value == "1";
-          else if (out.contains(".app.neoSupport = "))
-            m_jsonInfo["title_neo"] = value == "1";
-          else if (out.contains(".app.id = "))
-            m_jsonInfo["title_id"] = value;
-          else if (out.contains(".app.title = "))
-            m_jsonInfo["title_name"] = value;
-        }
-      } else if (lineInfo.module == "ExceptionHandler") {
-        if (!_exceptionDetected && out.starts_with("Faulty instruction:")) _exceptionDetected = true;
-      } else if (lineInfo.module == "libSceSysmodule") {
-        if (out.starts_with("loading id = ")) {
-          if (!_dialogSdkDetected && out.contains("Dialog")) _dialogSdkDetected = true;
-        }
-      } else if (lineInfo.module == "libSceNpTrophy") {
-        if (out == "Missing trophy key!") _hintTrophyKey = true;
-      } else if (lineInfo.module == "elf_loader") {
-        if (!_unityEngineDetected && out.contains("Il2CppUserAssemblies")) _unityEngineDetected = true;
-        if (out.starts_with("load library[") && out.ends_with(".sprx")) {
-          auto start = out.find_last_of("\\/");
-          if (start == std::string_view::npos) {
-            start = 0;
-          } else {
-            start += 1;
-          }
-          m_jsonInfo["firmware"].push_back(out.substr(start));
-        }
-      } else if (lineInfo.module == "patcher") {
-        if (out.starts_with("Applying ") && out.ends_with(" patch")) {
-          if (!_hintInsertqPatched && out.contains("ANDN")) _hintAndnPatched = true;
-          if (!_hintInsertqPatched && out.contains("INSERTQ")) _hintInsertqPatched = true;
-          if (!_hintInsertqPatched && out.contains("EXTRQ")) _hintExtrqPatched = true;
-        }
-      } else if (!_hintAjmFound && lineInfo.module == "Ajm::Instance") {
-        _hintAjmFound = true;
-      }
-    }
-  } else { // Handle main logs
-    if (out.contains("Language switched to ")) m_jsonInfo["user-lang"] = out.substr(out.find(" to ") + 4);
-    if (!_isGpuPicked && out.contains("Selected GPU:")) {
-      _nvidiaHint           = out.contains("NVIDIA") || out.contains("nvidia");
-      m_jsonInfo["user-gp"] = out.substr(out.find_first_of(u':') + 1);
-    }
-    if (!_inputNotFoundHint && out.contains("No pad with specified name was found")) _inputNotFoundHint = true;
-    if (lineInfo.module == "sb2spirv") {
-      if (!_shaderGenTodo && (out.contains("todo") || out.contains("Instruction missing"))) _shaderGenTodo = true;
-    } else if (lineInfo.module == "videoout") {
-      if (!_vkValidation && out.contains("Validation Error: ")) _vkValidation = true;
-      if (!_vkNoDevices && out == "Failed to find any suitable Vulkan device") _vkNoDevices = true;
-    }
+  try {
+    offset   = state.at("offset").get<uint64_t>();
+    line     = state.at("line").get<uint64_t>();
+    cutLines = state.at("cut_lines").get<uint64_t>();
+    if (!m_rules.load(state.at("rules")) || !m_context.load(state.at("context"))) return false;
+  } catch (nlohmann::json::exception const&) {
+    return false;
   }
 
+  m_offset   = offset;
+  m_line     = line;
+  m_cutLines = cutLines;
   return true;
 }
 
 std::string PLogAnalyzer::spit() const {
-  return m_jsonInfo.dump(2, ' ', true);
+  return m_rules.info().dump(2, ' ', true);
+}
+
+std::unique_ptr<PLogAnalyzer> createFileAnalyser(std::filesystem::path const& fpath, PLogOptions const& options) {
+  return std::make_unique<PLogAnalyzer>(fpath, options);
 }
 
-std::unique_ptr<PLogAnalyzer> createFileAnalyser(std::filesystem::path const& fpath) {
-  return std::make_unique<PLogAnalyzer>(fpath);
+std::unique_ptr<PLogAnalyzer> createStreamAnalyser(std::istream& stream, PLogOptions const& options) {
+  auto analyser = std::make_unique<PLogAnalyzer>(options);
+  analyser->readstream(stream);
+  return analyser;
 }
 
-std::unique_ptr<PLogAnalyzer> createMemAnalyser(const char* memory, size_t size) {
-  return std::make_unique<PLogAnalyzer>(memory, size);
+std::unique_ptr<PLogAnalyzer> createMemAnalyser(const char* memory, size_t size, PLogOptions const& options) {
+  return std::make_unique<PLogAnalyzer>(memory, size, options);
+}
+
+std::unique_ptr<PLogAnalyzer> createResumedAnalyser(std::filesystem::path const& fpath, nlohmann::json& checkpoint, PLogOptions const& options) {
+  std::ifstream file(fpath, std::ios::in | std::ios::binary); // Offsets have to be the file's own, text mode would eat the \r's
+  auto          analyser = std::make_unique<PLogAnalyzer>(options);
+
+  if (checkpoint.is_object() && checkpoint.value("plog_checkpoint", 0u) == CheckpointVersion) {
+    auto       resumed = std::make_unique<PLogAnalyzer>(options);
+    auto const prefix  = checkpoint.find("prefix");
+    auto const state   = checkpoint.find("analysis");
+    if (prefix != checkpoint.end() && state != checkpoint.end() && resumed->load(*state) && *prefix == prefixHash(file, resumed->offset()))
+      analyser = std::move(resumed);
+  }
+
+  file.clear();
+  file.seekg((std::streamoff)analyser->offset());
+  analyser->readLines(file, true);
+
+  file.clear();
+  checkpoint = {
+      {"plog_checkpoint", CheckpointVersion},
+      {"prefix", prefixHash(file, analyser->offset())},
+      {"analysis", analyser->save()},
+  };
+
+  analyser->finish();
+  return analyser;
 }
@@ -1,53 +1,18 @@
 #pragma once
 
-#include "third_party/json.hpp"
+#include "plogctx.h"
+#include "plogrules.h"
 
 #include <filesystem>
+#include <functional>
 #include <istream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
 
 class PLogAnalyzer {
   public:
-  struct /* Flags */ {
-    // psOff specific
-    bool _processTypeGuessed : 1 = false;
-    bool _isChildprocess     : 1 = false;
-    bool _isGpuPicked        : 1 = false;
-
-    // Hints
-    bool _inputNotFoundHint  : 1 = false;
-    bool _nvidiaHint         : 1 = false;
-    bool _hintTrophyKey      : 1 = false;
-    bool _hintAndnPatched    : 1 = false;
-    bool _hintInsertqPatched : 1 = false;
-    bool _hintExtrqPatched   : 1 = false;
-    bool _hintAjmFound       : 1 = false;
-
-    // Game engines
-    bool _unityEngineDetected    : 1 = false;
-    bool _cryEngineDetected      : 1 = false;
-    bool _unrealEngineDetected   : 1 = false;
-    bool _phyreEngineDetected    : 1 = false;
-    bool _gmakerEngineDetected   : 1 = false;
-    bool _naughtyEngineDetected  : 1 = false;
-    bool _irrlichtEngineDetected : 1 = false;
-
-    // SDKs
-    bool _fmodSdkDetected   : 1 = false;
-    bool _monoSdkDetected   : 1 = false;
-    bool _criSdkDetected    : 1 = false;
-    bool _havokSdkDetected  : 1 = false;
-    bool _wwiseSdkDetected  : 1 = false;
-    bool _dialogSdkDetected : 1 = false;
-
-    // Problems
-    bool _shaderGenTodo         : 1 = false;
-    bool _vkValidation          : 1 = false;
-    bool _exceptionDetected     : 1 = false;
-    bool _netStuffDetected      : 1 = false;
-    bool _vkNoDevices           : 1 = false;
-    bool _missingSymbolDetected : 1 = false;
-  };
-
   struct LineInfo {
     std::string_view channel;
     std::string_view module;
@@ -60,18 +25,68 @@ class PLogAnalyzer {
     uint32_t threadId;
   };
 
-  PLogAnalyzer() {}
+  PLogAnalyzer(PLogOptions const& options = {}): m_rules(options), m_lineBytes(PLogBudget(options.memoryBudget).lineBytes) {}
+
+  PLogAnalyzer(std::filesystem::path const& path, PLogOptions const& options = {});
+  PLogAnalyzer(const char* data, size_t dataSize, PLogOptions const& options = {});
+
+  // Splits a plog line into info, returns the message part (empty for lines that don't split)
+  static std::string_view parseLine(std::string_view line, LineInfo& info);
 
-  PLogAnalyzer(std::filesystem::path const& path);
-  PLogAnalyzer(const char* data, size_t dataSize);
+  // getline() into a fixed buffer, a line longer than it is cut and the rest of it skipped. skipped is how many bytes were left out
+  static bool readLine(std::istream& stream, std::vector<char>& buffer, std::string_view& line, size_t& skipped);
 
   void readstream(std::istream& stream);
+
+  // readstream() without the finish(). With wholeLines a last line that has no newline yet is left unread, the log is still being written.
+  // Returns false once the rest of the log is of no interest
+  bool readLines(std::istream& stream, bool wholeLines = false);
+
   bool render(LineInfo const& lineInfo, std::string_view out);
 
+  // Line by line feeding for callers that own the reading loop, returns false once the rest of the log is of no interest
+  bool feed(std::string_view line);
+
+  // Same for lines that were split already, out is the message part of line
+  bool feed(std::string_view line, LineInfo const& info, std::string_view out);
+
+  // Sees every line fed as text, split, before the analysis does: exports that want the same lines take them from here instead of
+  // reading the log again. readLines() keeps feeding it after the analysis lost interest in the rest of the log. Lines the memory
+  // budget cuts come to it cut
+  using Tap = std::function<void(std::string_view line, LineInfo const& info, std::string_view out)>;
+  void setTap(Tap tap) { m_tap = std::move(tap); }
+
+  // Inputs that can read a line again when a crash context wants it (archives) only pass the line size
+  bool feed(size_t lineSize, LineInfo const& info, std::string_view out);
+  void setLineResolver(PLogContext::Resolver resolver) { m_context.setResolver(std::move(resolver)); }
+
+  // The last fed line was cut, that many bytes of it were left out. Shows up as truncated lines in the report
+  void skip(size_t bytes);
+  void finish();
+
+  nlohmann::json const& info() const { return m_rules.info(); }
+
+  // What info() would be if the log ended here, the analysis goes on
+  nlohmann::json current() const;
+
+  // Checkpoint of an analysis that isn't finished: rules, crash context and input position. A fresh analyser with the same options
+  // that load()s it goes on with the line at offset()
+  nlohmann::json save() const;
+  bool           load(nlohmann::json const& state);
+
+  // Input offset of the next line
+  uint64_t offset() const { return m_offset; }
+
   std::string spit() const;
 
   private:
-  nlohmann::json m_jsonInfo;
+  PLogRules<char> m_rules;
+  PLogContext     m_context;
+  uint64_t        m_offset = 0; // Input offset of the next fed line
+  uint64_t        m_line   = 0; // Number of the last fed line, the first one is 1
+  size_t          m_lineBytes;  // Longest line kept whole, see PLogBudget
+  uint64_t        m_cutLines = 0;
+  Tap             m_tap;
 };
 
 #ifdef _WIN32
@@ -80,6 +95,11 @@ class PLogAnalyzer {
 #define EXPORT
 #endif
 
-EXPORT std::unique_ptr<PLogAnalyzer> createFileAnalyser(std::filesystem::path const& fpath);
-EXPORT std::unique_ptr<PLogAnalyzer> createStreamAnalyser(std::istream& stream);
-EXPORT std::unique_ptr<PLogAnalyzer> createMemAnalyser(const char* memory, size_t size);
+EXPORT std::unique_ptr<PLogAnalyzer> createFileAnalyser(std::filesystem::path const& fpath, PLogOptions const& options = {});
+EXPORT std::unique_ptr<PLogAnalyzer> createStreamAnalyser(std::istream& stream, PLogOptions const& options = {});
+EXPORT std::unique_ptr<PLogAnalyzer> createMemAnalyser(const char* memory, size_t size, PLogOptions const& options = {});
+
+// Analyses a plog that keeps being appended to. checkpoint is what the previous run on the same file left in it (null for the first run),
+// when it still matches the file only the bytes after it are read. It is replaced with this run's checkpoint, taken at the end of the
+// last complete line
+EXPORT std::unique_ptr<PLogAnalyzer> createResumedAnalyser(std::filesystem::path const& fpath, nlohmann::json& checkpoint, PLogOptions const& options = {});
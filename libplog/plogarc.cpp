@@ -0,0 +1,507 @@
+#include "plogarc.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <zlib.h>
+
+namespace {
+constexpr char     HeaderMagic[8] = {'P', 'L', 'O', 'G', 'A', 'R', 'C', 1};
+constexpr char     FooterMagic[4] = {'P', 'L', 'Z', 'X'};
+constexpr size_t   FooterSize     = 8 + 4 + 4;
+constexpr size_t   IndexItemSize  = 8 + 8 + 4 + 4 + 4;
+constexpr size_t   BlockHeader    = 4 + 4 + 4;
+constexpr uint32_t MaxTimeDigits  = 18;        // Digits of a timestamp packed into one int64
+constexpr size_t   BlockBytes     = 16u << 20;  // A block is flushed early once it holds this much, lines can be long
+constexpr uint32_t MaxBlockSize   = 256u << 20; // Readers refuse bigger blocks instead of allocating what a broken index says
+
+enum LineKind : uint8_t {
+  Verbatim,
+  Parsed,
+};
+
+template <typename T>
+void put(std::string& out, T value) {
+  out.append((const char*)&value, sizeof(value));
+}
+
+template <typename T>
+bool get(std::string_view& in, T& value) {
+  if (in.size() < sizeof(value)) return false;
+  std::memcpy(&value, in.data(), sizeof(value));
+  in.remove_prefix(sizeof(value));
+  return true;
+}
+
+void putVarint(std::string& out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back((char)(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back((char)value);
+}
+
+bool getVarint(std::string_view& in, uint64_t& value) {
+  value = 0;
+  for (uint32_t shift = 0; shift < 64; shift += 7) {
+    if (in.empty()) return false;
+    auto const byte = (uint8_t)in.front();
+    in.remove_prefix(1);
+    value |= uint64_t(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) return true;
+  }
+  return false;
+}
+
+void putDelta(std::string& out, int64_t value, int64_t& prev) {
+  auto const delta = value - prev;
+  prev             = value;
+  putVarint(out, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63)); // Zigzag, small negative deltas stay short
+}
+
+bool getDelta(std::string_view& in, int64_t& prev) {
+  uint64_t zz;
+  if (!getVarint(in, zz)) return false;
+  prev += (int64_t)((zz >> 1) ^ (~(zz & 1) + 1));
+  return true;
+}
+
+bool getBytes(std::string_view& in, std::string_view& bytes) {
+  uint64_t size;
+  if (!getVarint(in, size) || in.size() < size) return false;
+  bytes = in.substr(0, size);
+  in.remove_prefix(size);
+  return true;
+}
+
+// Process and thread IDs are kept as numbers only if printing them back gives the same text
+bool parseId(std::string_view field, int64_t& value) {
+  if (field.empty() || field.size() > 9 || (field.size() > 1 && field.front() == '0')) return false;
+  uint32_t id;
+  auto const [ptr, ec] = std::from_chars(field.data(), field.data() + field.size(), id);
+  if (ec != std::errc() || ptr != field.data() + field.size()) return false;
+  value = id;
+  return true;
+}
+
+// "2024-01-01 00:00:00.123" becomes the layout "0000-00-00 00:00:00.000" (a dictionary entry) and 20240101000000123. The packed digits
+// grow with time as long as the layout stays the same, so consecutive lines have small deltas
+bool splitTimestamp(std::string_view field, std::string& layout, int64_t& value) {
+  layout.assign(field);
+  value = 0;
+
+  uint32_t digits = 0;
+  for (auto& ch: layout) {
+    if (ch >= '0' && ch <= '9') {
+      if (++digits > MaxTimeDigits) return false;
+      value = value * 10 + (ch - '0');
+      ch    = '0';
+    }
+  }
+
+  return true;
+}
+
+uint32_t decimalDigits(uint32_t value) {
+  uint32_t digits = 1;
+  for (; value >= 10; value /= 10)
+    ++digits;
+  return digits;
+}
+} // namespace
+
+PLogArchiveWriter::PLogArchiveWriter(std::ostream& out, uint32_t blockLines): m_out(out), m_blockLines(blockLines) {
+  m_out.write(HeaderMagic, sizeof(HeaderMagic));
+  m_written = sizeof(HeaderMagic);
+}
+
+uint32_t PLogArchiveWriter::intern(std::string_view str) {
+  if (auto it = m_dictIds.find(str); it != m_dictIds.end()) return it->second;
+
+  auto const id = (uint32_t)m_dictIds.size();
+  m_dictIds.emplace(std::string(str), id);
+  putVarint(m_dict, str.size());
+  m_dict.append(str);
+  return id;
+}
+
+void PLogArchiveWriter::write(std::string_view line) {
+  ++m_lines;
+  m_bytesIn += line.size() + 1;
+
+  // Same split parseLogLine() does: eight fields, the message is whatever follows
+  std::string_view fields[8];
+  size_t           pos = 0;
+  for (auto& field: fields) {
+    auto const end = line.find(';', pos);
+    if (end == std::string_view::npos) {
+      pos = std::string_view::npos;
+      break;
+    }
+    field = line.substr(pos, end - pos);
+    pos   = end + 1;
+  }
+
+  int64_t time, pid, tid;
+  if (pos != std::string_view::npos && parseId(fields[4], pid) && parseId(fields[5], tid) && splitTimestamp(fields[3], m_layout, time)) {
+    auto const message = line.substr(pos);
+
+    m_meta.push_back(LineKind::Parsed);
+    putVarint(m_meta, intern(fields[0]));
+    putVarint(m_meta, intern(fields[1]));
+    putVarint(m_meta, intern(fields[2]));
+    putVarint(m_meta, intern(m_layout));
+    putDelta(m_meta, time, m_prevTime);
+    putDelta(m_meta, pid, m_prevPid);
+    putDelta(m_meta, tid, m_prevTid);
+    putVarint(m_meta, intern(fields[6]));
+    putVarint(m_meta, intern(fields[7]));
+    putVarint(m_meta, message.size());
+    m_text.append(message);
+  } else {
+    m_meta.push_back(LineKind::Verbatim);
+    putVarint(m_meta, line.size());
+    m_text.append(line);
+  }
+
+  if (++m_pending == m_blockLines || m_dict.size() + m_meta.size() + m_text.size() >= BlockBytes) flushBlock();
+}
+
+bool PLogArchiveWriter::flushBlock() {
+  if (m_pending == 0) return !m_failed;
+
+  m_raw.clear();
+  putVarint(m_raw, m_dictIds.size());
+  putVarint(m_raw, m_dict.size());
+  putVarint(m_raw, m_meta.size());
+  m_raw.append(m_dict).append(m_meta).append(m_text);
+  if (m_raw.size() > MaxBlockSize) { // A single line that big, no reader would take the block
+    m_failed = true;
+    return false;
+  }
+
+  uLongf compressedSize = compressBound((uLong)m_raw.size());
+  m_compressed.resize(compressedSize);
+  if (compress2((Bytef*)m_compressed.data(), &compressedSize, (Bytef const*)m_raw.data(), (uLong)m_raw.size(), Z_DEFAULT_COMPRESSION) != Z_OK) {
+    m_failed = true;
+    return false;
+  }
+
+  m_index.push_back({
+      .offset         = m_written,
+      .firstLine      = m_lines - m_pending,
+      .lines          = m_pending,
+      .rawSize        = (uint32_t)m_raw.size(),
+      .compressedSize = (uint32_t)compressedSize,
+  });
+
+  std::string header;
+  header.reserve(BlockHeader);
+  put(header, (uint32_t)m_raw.size());
+  put(header, (uint32_t)compressedSize);
+  put(header, m_pending);
+  m_out.write(header.data(), header.size());
+  m_out.write(m_compressed.data(), compressedSize);
+  m_written += header.size() + compressedSize;
+
+  m_dict.clear();
+  m_meta.clear();
+  m_text.clear();
+  m_dictIds.clear();
+  m_pending  = 0;
+  m_prevTime = m_prevPid = m_prevTid = 0;
+  return m_out.good();
+}
+
+bool PLogArchiveWriter::finish() {
+  if (!flushBlock()) return false;
+
+  std::string tail;
+  for (auto const& block: m_index) {
+    put(tail, block.offset);
+    put(tail, block.firstLine);
+    put(tail, block.lines);
+    put(tail, block.rawSize);
+    put(tail, block.compressedSize);
+  }
+
+  put(tail, m_written);
+  put(tail, (uint32_t)m_index.size());
+  tail.append(FooterMagic, sizeof(FooterMagic));
+
+  m_out.write(tail.data(), tail.size());
+  m_written += tail.size();
+  m_out.flush();
+  return m_out.good();
+}
+
+PLogArchiveReader::PLogArchiveReader(std::istream& in): m_in(in), m_depth(std::clamp(std::thread::hardware_concurrency(), 2u, 9u) - 1) {
+  char header[sizeof(HeaderMagic)];
+  if (!m_in.seekg(0) || !m_in.read(header, sizeof(header)) || std::memcmp(header, HeaderMagic, sizeof(header)) != 0) return;
+
+  if (!m_in.seekg(0, std::ios::end)) return;
+  auto const fileSize = (uint64_t)m_in.tellg();
+  if (fileSize < sizeof(HeaderMagic) + FooterSize) return;
+
+  std::string footer(FooterSize, '\0');
+  if (!m_in.seekg((std::streamoff)(fileSize - FooterSize)) || !m_in.read(footer.data(), footer.size())) return;
+  if (std::memcmp(footer.data() + 12, FooterMagic, sizeof(FooterMagic)) != 0) return;
+
+  std::string_view fv(footer);
+  uint64_t         indexOffset;
+  uint32_t         blockCount;
+  get(fv, indexOffset);
+  get(fv, blockCount);
+
+  // Nothing the file says gets allocated before it is known to fit in the file: the index fills the space up to the footer
+  auto const indexEnd = fileSize - FooterSize;
+  if (indexOffset < sizeof(HeaderMagic) || indexOffset > indexEnd || (indexEnd - indexOffset) != (uint64_t)blockCount * IndexItemSize) return;
+
+  std::string index((size_t)blockCount * IndexItemSize, '\0');
+  if (!m_in.seekg((std::streamoff)indexOffset) || !m_in.read(index.data(), index.size())) return;
+
+  std::string_view iv(index);
+  uint64_t         offset = sizeof(HeaderMagic);
+  uint64_t         line   = 0;
+  m_index.resize(blockCount);
+  for (auto& block: m_index) {
+    get(iv, block.offset);
+    get(iv, block.firstLine);
+    get(iv, block.lines);
+    get(iv, block.rawSize);
+    get(iv, block.compressedSize);
+
+    // Blocks come one after another, up to the index
+    if (block.offset != offset || block.firstLine != line || block.rawSize > MaxBlockSize) return;
+    if (block.compressedSize > indexOffset - offset || BlockHeader > indexOffset - offset - block.compressedSize) return;
+    offset += BlockHeader + block.compressedSize;
+    line += block.lines;
+  }
+
+  m_valid = offset == indexOffset;
+}
+
+bool PLogArchiveReader::seek(size_t block) {
+  if (!m_valid || block > m_index.size()) return false;
+  m_block = block;
+  m_left  = 0;
+  return true;
+}
+
+PLogArchiveReader::~PLogArchiveReader() {
+  for (auto& prefetch: m_prefetch)
+    prefetch.done.wait();
+}
+
+bool PLogArchiveReader::readBlock(size_t block, std::string& compressed) {
+  auto const& info = m_index[block];
+
+  compressed.resize(info.compressedSize);
+  m_in.clear();
+  return m_in.seekg((std::streamoff)(info.offset + BlockHeader)) && m_in.read(compressed.data(), compressed.size());
+}
+
+bool PLogArchiveReader::inflateBlock(PLogArchiveBlock const& info, std::string const& compressed, std::string& raw) {
+  uLongf rawSize = info.rawSize;
+  raw.resize(rawSize);
+  return uncompress((Bytef*)raw.data(), &rawSize, (Bytef const*)compressed.data(), (uLong)compressed.size()) == Z_OK && rawSize == info.rawSize;
+}
+
+bool PLogArchiveReader::loadBlock(size_t block) {
+  auto const& info = m_index[block];
+
+  bool loaded;
+  if (!m_prefetch.empty() && m_prefetch.front().block == block) {
+    loaded = m_prefetch.front().done.get();
+    std::swap(m_raw, m_prefetch.front().raw);
+    m_prefetch.pop_front();
+  } else {
+    for (auto& prefetch: m_prefetch) // Jumped elsewhere, whatever was inflated ahead is of no use
+      prefetch.done.wait();
+    m_prefetch.clear();
+    loaded = readBlock(block, m_compressed) && inflateBlock(info, m_compressed, m_raw);
+  }
+
+  // Inflating a block takes longer than analysing it, so several of the following ones get done on other threads meanwhile. Lookups
+  // that jump around don't read ahead. The stream is only touched here
+  bool const sequential = block == m_loaded + 1;
+  m_loaded              = block;
+  for (auto next = m_prefetch.empty() ? block + 1 : m_prefetch.back().block + 1; sequential && next < m_index.size() && m_prefetch.size() < m_depth;
+       ++next) {
+    auto& prefetch = m_prefetch.emplace_back();
+    if (!readBlock(next, prefetch.compressed)) {
+      m_prefetch.pop_back();
+      break;
+    }
+
+    prefetch.block = next;
+    prefetch.done  = std::async(std::launch::async, [&prefetch, &info = m_index[next]] { return inflateBlock(info, prefetch.compressed, prefetch.raw); });
+  }
+
+  if (!loaded) return false;
+
+  std::string_view raw(m_raw);
+  uint64_t         dictCount, dictSize, metaSize;
+  if (!getVarint(raw, dictCount) || !getVarint(raw, dictSize) || !getVarint(raw, metaSize) || raw.size() < dictSize ||
+      raw.size() - dictSize < metaSize || dictCount > dictSize)
+    return false;
+
+  auto dict = raw.substr(0, dictSize);
+  m_meta    = raw.substr(dictSize, metaSize);
+  m_text    = raw.substr(dictSize + metaSize);
+
+  m_dict.resize(dictCount);
+  for (auto& entry: m_dict) {
+    if (!getBytes(dict, entry)) return false;
+  }
+
+  m_left       = info.lines;
+  m_timeLayout = UINT64_MAX; // Dictionary ids start over
+  m_prevTime = m_prevPid = m_prevTid = 0;
+  return true;
+}
+
+bool PLogArchiveReader::next(PLogAnalyzer::LineInfo& info, std::string_view& out, bool& parsed) {
+  while (m_left == 0) {
+    if (!m_valid || m_block >= m_index.size()) return false;
+    if (!loadBlock(m_block++)) {
+      m_valid = false; // Broken block, nothing after it can be trusted either
+      return false;
+    }
+  }
+  --m_left;
+
+  if (m_meta.empty()) return m_valid = false;
+  auto const kind = (LineKind)m_meta.front();
+  m_meta.remove_prefix(1);
+
+  uint64_t size;
+  if (kind == LineKind::Verbatim) {
+    if (!getVarint(m_meta, size) || size > m_text.size()) return m_valid = false;
+    m_message = m_text.substr(0, size);
+    m_text.remove_prefix(size);
+    m_lineSize = size;
+    parsed = m_parsed = false;
+    return true;
+  }
+
+  auto& ids = m_fields;
+  if (!getVarint(m_meta, ids[0]) || !getVarint(m_meta, ids[1]) || !getVarint(m_meta, ids[2]) || !getVarint(m_meta, ids[3]) ||
+      !getDelta(m_meta, m_prevTime) || !getDelta(m_meta, m_prevPid) || !getDelta(m_meta, m_prevTid) || !getVarint(m_meta, ids[4]) ||
+      !getVarint(m_meta, ids[5]) || !getVarint(m_meta, size) || size > m_text.size())
+    return m_valid = false;
+
+  if (*std::max_element(std::begin(ids), std::end(ids)) >= m_dict.size()) return m_valid = false;
+
+  m_message = m_text.substr(0, size);
+  m_text.remove_prefix(size);
+  fillTimestamp(ids[3]);
+
+  info.channel   = m_dict[ids[0]];
+  info.module    = m_dict[ids[1]];
+  info.level     = m_dict[ids[2]];
+  info.timestamp = m_time;
+  info.source    = m_dict[ids[4]];
+  info.func      = m_dict[ids[5]];
+  info.processId = (uint32_t)m_prevPid;
+  info.threadId  = (uint32_t)m_prevTid;
+
+  m_lineSize = 8 + decimalDigits(info.processId) + decimalDigits(info.threadId) + m_message.size();
+  for (auto id: ids)
+    m_lineSize += m_dict[id].size();
+
+  out    = m_message.ends_with('\r') ? m_message.substr(0, m_message.size() - 1) : m_message;
+  parsed = m_parsed = true;
+  return true;
+}
+
+std::string_view PLogArchiveReader::line() {
+  if (!m_parsed) return m_message;
+
+  char idbuf[2][16];
+  auto pidEnd = std::to_chars(idbuf[0], idbuf[0] + sizeof(idbuf[0]), (uint32_t)m_prevPid).ptr;
+  auto tidEnd = std::to_chars(idbuf[1], idbuf[1] + sizeof(idbuf[1]), (uint32_t)m_prevTid).ptr;
+
+  std::string_view const fields[] = {m_dict[m_fields[0]],
+                                     m_dict[m_fields[1]],
+                                     m_dict[m_fields[2]],
+                                     m_time,
+                                     std::string_view(idbuf[0], pidEnd),
+                                     std::string_view(idbuf[1], tidEnd),
+                                     m_dict[m_fields[4]],
+                                     m_dict[m_fields[5]]};
+
+  m_line.clear();
+  for (auto field: fields)
+    m_line.append(field).push_back(';');
+  m_line.append(m_message);
+  return m_line;
+}
+
+bool PLogArchiveReader::readLine(uint64_t number, std::string& text) {
+  auto it = std::upper_bound(m_index.begin(), m_index.end(), number, [](uint64_t num, PLogArchiveBlock const& block) { return num < block.firstLine; });
+  if (it == m_index.begin() || !seek(std::distance(m_index.begin(), it) - 1)) return false;
+
+  PLogAnalyzer::LineInfo info;
+  std::string_view       out;
+  bool                   parsed;
+  for (auto skip = number - std::prev(it)->firstLine;; --skip) {
+    if (!next(info, out, parsed)) return false;
+    if (skip == 0) break;
+  }
+
+  text = line();
+  return true;
+}
+
+void PLogArchiveReader::fillTimestamp(uint64_t layout) {
+  auto const pattern = m_dict[layout];
+  auto       value   = m_prevTime;
+  auto       prev    = m_timeValue;
+  if (layout != m_timeLayout) {
+    m_time.assign(pattern);
+    m_timeLayout = layout;
+    prev         = -1; // Every digit gets written
+  }
+
+  // Once the remaining high digits match, the text already holds them
+  for (auto i = pattern.size(); i-- > 0 && value != prev;) {
+    if (pattern[i] == '0') {
+      m_time[i] = char('0' + value % 10);
+      value /= 10;
+      prev /= 10;
+    }
+  }
+
+  m_timeValue = m_prevTime;
+}
+
+std::unique_ptr<PLogAnalyzer> createArchiveAnalyser(std::istream& stream, PLogOptions const& options) {
+  PLogArchiveReader reader(stream);
+  if (!reader.valid()) return nullptr;
+
+  auto analyser = std::make_unique<PLogAnalyzer>(options);
+
+  // Crash context lines are read back through a second reader, the first one keeps its block
+  PLogArchiveReader lookup(stream);
+  analyser->setLineResolver([&lookup](uint64_t line, std::string& text) { return lookup.readLine(line, text); });
+
+  PLogAnalyzer::LineInfo info;
+  std::string_view       out;
+  bool                   parsed;
+  while (reader.next(info, out, parsed)) {
+    if (!(parsed ? analyser->feed(reader.lineSize(), info, out) : analyser->feed(reader.line()))) break;
+  }
+
+  analyser->finish();
+  analyser->setLineResolver(nullptr);
+  return analyser;
+}
+
+std::unique_ptr<PLogAnalyzer> createArchiveAnalyser(std::filesystem::path const& fpath, PLogOptions const& options) {
+  std::ifstream file(fpath, std::ios::in | std::ios::binary);
+  return createArchiveAnalyser(file, options);
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "ploga.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Archive format for keeping plogs around. Lines are cut into blocks, every block is self-contained: channel, module, level, source,
+// function and timestamp layout go through a per-block dictionary, timestamps and process/thread IDs are stored as deltas to the previous
+// line, and the result is deflated. A block index at the end of the file allows seeking to any block.
+//
+// It is a storage format: archives are about 12 times smaller than the plog, but analysing one costs about what parsing the text does,
+// inflating takes the time the pre-split lines save. Following blocks are inflated on other cores while one is analysed.
+//
+// File: header | block... | index | footer
+//   header: "PLOGARC" + version byte
+//   block:  rawSize u32, compressedSize u32, lines u32, deflated payload. Blocks follow each other without gaps
+//   index:  (offset u64, firstLine u64, lines u32, rawSize u32, compressedSize u32) for every block
+//   footer: index offset u64, block count u32, "PLZX"
+//
+// Lines that don't split into the nine plog fields, or whose fields wouldn't survive the round trip, are stored verbatim.
+
+struct PLogArchiveBlock {
+  uint64_t offset;
+  uint64_t firstLine;
+  uint32_t lines;
+  uint32_t rawSize;
+  uint32_t compressedSize;
+};
+
+class PLogArchiveWriter {
+  public:
+  static constexpr uint32_t DefaultBlockLines = 16384;
+
+  PLogArchiveWriter(std::ostream& out, uint32_t blockLines = DefaultBlockLines);
+
+  void write(std::string_view line);
+
+  // Flushes the last block and writes the index, the archive can't be read without it
+  bool finish();
+
+  uint64_t lines() const { return m_lines; }
+
+  uint64_t bytesIn() const { return m_bytesIn; }
+
+  uint64_t bytesOut() const { return m_written; }
+
+  private:
+  struct Hash {
+    using is_transparent = void;
+
+    size_t operator()(std::string_view str) const { return std::hash<std::string_view>{}(str); }
+  };
+
+  uint32_t intern(std::string_view str);
+  bool     flushBlock();
+
+  std::ostream& m_out;
+  uint32_t      m_blockLines;
+  bool          m_failed = false;
+
+  // Current block
+  std::unordered_map<std::string, uint32_t, Hash, std::equal_to<>> m_dictIds;
+
+  std::string m_dict, m_meta, m_text;
+  uint32_t    m_pending  = 0;
+  int64_t     m_prevTime = 0;
+  int64_t     m_prevPid  = 0;
+  int64_t     m_prevTid  = 0;
+
+  std::vector<PLogArchiveBlock> m_index;
+  std::string                   m_raw, m_compressed, m_layout; // Scratch, kept between blocks and lines
+
+  uint64_t m_lines   = 0;
+  uint64_t m_bytesIn = 0;
+  uint64_t m_written = 0;
+};
+
+class PLogArchiveReader {
+  public:
+  PLogArchiveReader(std::istream& in);
+  ~PLogArchiveReader();
+
+  bool valid() const { return m_valid; }
+
+  std::vector<PLogArchiveBlock> const& blocks() const { return m_index; }
+
+  // Jumps to the given block, the next next() call returns its first line
+  bool seek(size_t block);
+
+  // Views stay valid until the next call. parsed tells whether info and out were filled, verbatim lines only have line()
+  bool next(PLogAnalyzer::LineInfo& info, std::string_view& out, bool& parsed);
+
+  // Size of the line returned last, known without putting it together
+  size_t lineSize() const { return m_lineSize; }
+
+  // Text of the line returned last. Only built on request, analysis doesn't need it
+  std::string_view line();
+
+  // Reads a line by its zero based number, the reader is left right after it
+  bool readLine(uint64_t number, std::string& text);
+
+  private:
+  static bool inflateBlock(PLogArchiveBlock const& info, std::string const& compressed, std::string& raw);
+
+  bool readBlock(size_t block, std::string& compressed);
+  bool loadBlock(size_t block);
+  void fillTimestamp(uint64_t layout);
+
+  std::istream&                 m_in;
+  bool                          m_valid = false;
+  std::vector<PLogArchiveBlock> m_index;
+
+  // Current block
+  size_t                        m_block = 0;
+  uint32_t                      m_left  = 0; // Lines not returned yet
+  std::string                   m_raw, m_compressed;
+  std::vector<std::string_view> m_dict;
+  std::string_view              m_meta, m_text;
+  int64_t                       m_prevTime = 0;
+  int64_t                       m_prevPid  = 0;
+  int64_t                       m_prevTid  = 0;
+
+  // Line returned last
+  bool             m_parsed = false;
+  uint64_t         m_fields[6]; // Dictionary ids of channel, module, level, timestamp layout, source and func
+  std::string_view m_message;
+  size_t           m_lineSize = 0;
+  std::string      m_line;
+
+  // Digits are only rewritten from where they differ from the previous timestamp
+  std::string m_time;
+  uint64_t    m_timeLayout = UINT64_MAX;
+  int64_t     m_timeValue  = 0;
+
+  // Blocks after the current one, inflated on other threads
+  struct Prefetch {
+    size_t            block = SIZE_MAX;
+    std::string       raw, compressed;
+    std::future<bool> done;
+  };
+
+  std::deque<Prefetch> m_prefetch; // References stay valid while the threads fill them, unlike a vector's
+  size_t               m_depth;    // Blocks inflated ahead
+  size_t               m_loaded = SIZE_MAX;
+};
+
+// Every line is handed to the analyser already split, reports match the ones of the plog the archive was made from
+EXPORT std::unique_ptr<PLogAnalyzer> createArchiveAnalyser(std::istream& stream, PLogOptions const& options = {});
+EXPORT std::unique_ptr<PLogAnalyzer> createArchiveAnalyser(std::filesystem::path const& fpath, PLogOptions const& options = {});
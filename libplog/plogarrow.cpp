@@ -0,0 +1,414 @@
+#include "plogarrow.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <utility>
+
+namespace {
+constexpr uint32_t Continuation = 0xffffffff;
+
+// Values from Arrow's Schema.fbs and Message.fbs
+constexpr uint16_t MetadataV5        = 4;
+constexpr uint8_t  HeaderSchema      = 1;
+constexpr uint8_t  HeaderDictionary  = 2;
+constexpr uint8_t  HeaderRecordBatch = 3;
+constexpr uint8_t  TypeInt           = 2;
+constexpr uint8_t  TypeUtf8          = 5;
+
+// Just enough of FlatBuffers to write Arrow's metadata. Objects are laid out front to back with the parent first, so every offset points
+// forward as the format wants. A message is a handful of tables, the vtable sharing of the real builder isn't worth it here
+struct FbNode {
+  enum Kind : uint8_t { Table, String, Vector, Structs } kind = Table;
+
+  struct Field {
+    uint16_t slot;
+    uint8_t  size; // Of a scalar, 0 for an offset to children[value]
+    uint64_t value;
+  };
+
+  std::vector<Field>  fields   = {};
+  std::vector<FbNode> children = {}; // Objects the table fields point at, elements of a Vector
+  std::string         data     = {}; // String text, Structs elements
+  uint32_t            count    = 0;  // Structs
+
+  FbNode& scalar(uint16_t slot, uint8_t size, uint64_t value) {
+    fields.push_back({.slot = slot, .size = size, .value = value});
+    return *this;
+  }
+
+  FbNode& child(uint16_t slot, FbNode node) {
+    fields.push_back({.slot = slot, .size = 0, .value = children.size()});
+    children.push_back(std::move(node));
+    return *this;
+  }
+};
+
+class FbWriter {
+  public:
+  // Metadata of one message, padded to 8 bytes as the IPC framing wants
+  static std::string build(FbNode const& root) {
+    FbWriter writer;
+    writer.grow(4); // Offset to the root table
+    writer.place(root, 0);
+    writer.pad(8);
+    return std::move(writer.m_buf);
+  }
+
+  private:
+  void pad(size_t align) { m_buf.resize((m_buf.size() + align - 1) / align * align, '\0'); }
+
+  size_t grow(size_t size) {
+    auto const pos = m_buf.size();
+    m_buf.resize(pos + size, '\0');
+    return pos;
+  }
+
+  template <typename T>
+  void patch(size_t pos, T value) {
+    std::memcpy(m_buf.data() + pos, &value, sizeof(value));
+  }
+
+  // Appends node and points the offset at ref to it
+  void place(FbNode const& node, size_t ref);
+
+  std::string m_buf;
+};
+
+void FbWriter::place(FbNode const& node, size_t ref) {
+  switch (node.kind) {
+    case FbNode::String: {
+      pad(4);
+      patch(ref, uint32_t(m_buf.size() - ref));
+      patch(grow(4), (uint32_t)node.data.size());
+      m_buf.append(node.data).push_back('\0');
+    } break;
+    case FbNode::Structs: { // The elements are 8-byte aligned, the length sits right before them
+      while ((m_buf.size() + 4) % 8 != 0)
+        m_buf.push_back('\0');
+      patch(ref, uint32_t(m_buf.size() - ref));
+      patch(grow(4), node.count);
+      m_buf.append(node.data);
+    } break;
+    case FbNode::Vector: {
+      pad(4);
+      patch(ref, uint32_t(m_buf.size() - ref));
+      patch(grow(4), (uint32_t)node.children.size());
+      auto const items = grow(4 * node.children.size());
+      for (size_t i = 0; i < node.children.size(); ++i)
+        place(node.children[i], items + 4 * i);
+    } break;
+    case FbNode::Table: {
+      uint16_t slots = 0;
+      for (auto const& field: node.fields)
+        slots = std::max<uint16_t>(slots, field.slot + 1);
+
+      // The vtable goes first, the table points back at it
+      pad(2);
+      auto const vtable = grow(4 + 2 * slots);
+      pad(4);
+      auto const table = grow(4);
+      patch(table, int32_t(table - vtable));
+      patch(ref, uint32_t(table - ref));
+
+      // Biggest fields first, they want the most alignment
+      auto fields = node.fields;
+      std::stable_sort(fields.begin(), fields.end(), [](auto const& a, auto const& b) { return (a.size ? a.size : 4) > (b.size ? b.size : 4); });
+
+      std::vector<std::pair<size_t, uint64_t>> refs;
+      for (auto const& field: fields) {
+        auto const size = field.size != 0 ? field.size : 4;
+        pad(size);
+        auto const pos = grow(size);
+        patch(vtable + 4 + 2 * field.slot, uint16_t(pos - table));
+        if (field.size != 0)
+          std::memcpy(m_buf.data() + pos, &field.value, field.size); // Little endian, the low bytes are the value
+        else
+          refs.emplace_back(pos, field.value);
+      }
+
+      patch(vtable, uint16_t(4 + 2 * slots));
+      patch(vtable + 2, uint16_t(m_buf.size() - table));
+      for (auto const& [pos, index]: refs)
+        place(node.children[index], pos);
+    } break;
+  }
+}
+
+// Eats the string eight bytes at a time, the dictionary lookups are most of the export's own work
+uint32_t hashOf(std::string_view str) {
+  uint64_t hash = str.size() * 0x9e3779b97f4a7c15ull;
+  for (uint64_t word; !str.empty(); str.remove_prefix(std::min(str.size(), sizeof(word)))) {
+    word = 0;
+    std::memcpy(&word, str.data(), std::min(str.size(), sizeof(word)));
+    hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+    hash ^= hash >> 32;
+  }
+  return (uint32_t)hash;
+}
+
+FbNode intType(uint32_t bits, bool isSigned) {
+  FbNode type;
+  type.scalar(0, 4, bits).scalar(1, 1, isSigned);
+  return type;
+}
+
+FbNode schemaField(std::string_view name, uint8_t typeType, FbNode type, int64_t dictionary = -1) {
+  FbNode field;
+  field.child(0, {.kind = FbNode::String, .data = std::string(name)}).scalar(1, 1, true).scalar(2, 1, typeType).child(3, std::move(type));
+  if (dictionary >= 0) {
+    FbNode encoding;
+    encoding.scalar(0, 8, (uint64_t)dictionary).child(1, intType(32, true));
+    field.child(4, std::move(encoding));
+  }
+  return field.child(5, {.kind = FbNode::Vector}); // No children, but readers want the vector
+}
+
+FbNode message(uint8_t headerType, FbNode header, size_t bodyLength) {
+  FbNode msg;
+  msg.scalar(0, 2, MetadataV5).scalar(1, 1, headerType).child(2, std::move(header)).scalar(3, 8, bodyLength);
+  return msg;
+}
+
+// Record batch body: the buffers go one after another into body, 8-byte aligned, the metadata lists where they are
+class BatchBuilder {
+  public:
+  BatchBuilder(std::string& body): m_body(body) { m_body.clear(); }
+
+  void node(uint64_t length, uint64_t nulls) { put(m_nodes, length, nulls, m_nodeCount); }
+
+  void buffer(const void* data, size_t size) {
+    put(m_buffers, m_body.size(), size, m_bufferCount);
+    if (size > 0) m_body.append((const char*)data, size);
+    m_body.resize((m_body.size() + 7) & ~size_t(7), '\0');
+  }
+
+  FbNode table(uint64_t length) {
+    FbNode batch;
+    batch.scalar(0, 8, length);
+    batch.child(1, {.kind = FbNode::Structs, .data = std::move(m_nodes), .count = m_nodeCount});
+    batch.child(2, {.kind = FbNode::Structs, .data = std::move(m_buffers), .count = m_bufferCount});
+    return batch;
+  }
+
+  private:
+  static void put(std::string& out, uint64_t a, uint64_t b, uint32_t& count) {
+    out.append((const char*)&a, sizeof(a)).append((const char*)&b, sizeof(b));
+    ++count;
+  }
+
+  std::string& m_body;
+  std::string  m_nodes, m_buffers;
+  uint32_t     m_nodeCount = 0, m_bufferCount = 0;
+};
+} // namespace
+
+void PLogArrowWriter::StringColumn::add(std::string_view value) {
+  data.append(value);
+  offsets.push_back((int32_t)data.size());
+}
+
+void PLogArrowWriter::StringColumn::clear() {
+  offsets.resize(1);
+  data.clear();
+}
+
+void PLogArrowWriter::DictionaryColumn::add(std::string_view str) {
+  if (lastId >= 0 && value(lastId) == str) {
+    indices.push_back(lastId);
+    return;
+  }
+
+  if (entries.size() * 2 >= index.size()) { // Keep the index at most half full
+    index.assign(std::max<size_t>(index.size() * 2, 1024), 0);
+    for (uint32_t id = 0; id < entries.size(); ++id) {
+      auto pos = entries[id].hash & (index.size() - 1);
+      while (index[pos] != 0)
+        pos = (pos + 1) & (index.size() - 1);
+      index[pos] = id + 1;
+    }
+  }
+
+  auto const hash = hashOf(str);
+  auto       pos  = hash & (index.size() - 1);
+  for (; index[pos] != 0; pos = (pos + 1) & (index.size() - 1)) {
+    auto const id = index[pos] - 1;
+    if (entries[id].hash == hash && value(id) == str) {
+      lastId = (int32_t)id;
+      indices.push_back(lastId);
+      return;
+    }
+  }
+
+  lastId     = (int32_t)entries.size();
+  index[pos] = lastId + 1;
+  entries.push_back({.hash = hash, .offset = (uint32_t)strings.size(), .length = (uint32_t)str.size()});
+  strings.append(str);
+  indices.push_back(lastId);
+}
+
+void PLogArrowWriter::DictionaryColumn::reset() {
+  strings.clear();
+  entries.clear();
+  std::fill(index.begin(), index.end(), 0);
+  sentEntries = 0;
+  sent        = false;
+  lastId      = -1;
+}
+
+PLogArrowWriter::PLogArrowWriter(std::ostream& out, uint32_t groupLines): m_out(out), m_groupLines(std::max<uint32_t>(groupLines, 1)) {
+  std::vector<FbNode> fields;
+  fields.push_back(schemaField("module", TypeUtf8, {}, 0));
+  fields.push_back(schemaField("level", TypeUtf8, {}, 1));
+  fields.push_back(schemaField("timestamp", TypeUtf8, {}));
+  fields.push_back(schemaField("pid", TypeInt, intType(32, false)));
+  fields.push_back(schemaField("tid", TypeInt, intType(32, false)));
+  fields.push_back(schemaField("source", TypeUtf8, {}, 2));
+  fields.push_back(schemaField("func", TypeUtf8, {}, 3));
+  fields.push_back(schemaField("message", TypeUtf8, {}));
+
+  FbNode schema;
+  schema.scalar(0, 2, 0).child(1, {.kind = FbNode::Vector, .children = std::move(fields)}); // Little endian
+
+  m_body.clear();
+  writeMessage(FbWriter::build(message(HeaderSchema, std::move(schema), 0)));
+}
+
+void PLogArrowWriter::write(std::string_view line) {
+  PLogAnalyzer::LineInfo info = {};
+
+  auto const out = PLogAnalyzer::parseLine(line, info);
+  write(line, info, out);
+}
+
+void PLogArrowWriter::write(std::string_view line, PLogAnalyzer::LineInfo const& info, std::string_view out) {
+  ++m_lines;
+  m_bytesIn += line.size() + 1;
+
+  bool const parsed  = out.data() != nullptr; // An empty message still points into the line
+  auto const message = (parsed ? out : line).substr(0, GroupBytes);
+
+  if (m_rows > 0 && m_timestamp.data.size() + m_message.data.size() + info.timestamp.size() + message.size() > GroupBytes) flushGroup();
+
+  if (m_rows % 8 == 0) m_valid.push_back(0);
+  if (parsed) {
+    m_valid.back() |= uint8_t(1 << (m_rows % 8));
+    m_module.add(info.module);
+    m_level.add(info.level);
+    m_timestamp.add(info.timestamp.substr(0, GroupBytes));
+    m_pid.push_back(info.processId);
+    m_tid.push_back(info.threadId);
+    m_source.add(info.source);
+    m_func.add(info.func);
+  } else { // Null slots still take a value, any will do
+    ++m_nulls;
+    for (auto* column: {&m_module, &m_level, &m_source, &m_func})
+      column->indices.push_back(0);
+    m_timestamp.add({});
+    m_pid.push_back(0);
+    m_tid.push_back(0);
+  }
+  m_message.add(message);
+
+  if (++m_rows == m_groupLines) flushGroup();
+}
+
+void PLogArrowWriter::writeMessage(std::string const& metadata) {
+  uint32_t const prefix[2] = {Continuation, (uint32_t)metadata.size()};
+  m_out.write((const char*)prefix, sizeof(prefix));
+  m_out.write(metadata.data(), (std::streamsize)metadata.size());
+  m_out.write(m_body.data(), (std::streamsize)m_body.size());
+  m_written += sizeof(prefix) + metadata.size() + m_body.size();
+}
+
+void PLogArrowWriter::flushGroup() {
+  DictionaryColumn* const dictionaries[] = {&m_module, &m_level, &m_source, &m_func};
+
+  // Strings the group introduced, everything in the dictionary if it wasn't sent since the last reset
+  for (size_t id = 0; id < std::size(dictionaries); ++id) {
+    auto& dict = *dictionaries[id];
+    if (dict.sent && dict.sentEntries == dict.entries.size()) continue;
+
+    auto const count = dict.entries.size() - dict.sentEntries;
+    auto const first = count > 0 ? dict.entries[dict.sentEntries].offset : 0;
+
+    m_offsets.clear();
+    m_offsets.push_back(0);
+    for (auto i = dict.sentEntries; i < dict.entries.size(); ++i)
+      m_offsets.push_back(int32_t(dict.entries[i].offset + dict.entries[i].length - first));
+
+    BatchBuilder batch(m_body);
+    batch.node(count, 0);
+    batch.buffer(nullptr, 0);
+    batch.buffer(m_offsets.data(), m_offsets.size() * sizeof(int32_t));
+    batch.buffer(dict.strings.data() + first, dict.strings.size() - first);
+
+    FbNode header;
+    header.scalar(0, 8, id).child(1, batch.table(count)).scalar(2, 1, dict.sent); // Delta once the dictionary was sent whole
+    writeMessage(FbWriter::build(message(HeaderDictionary, std::move(header), m_body.size())));
+
+    dict.sent        = true;
+    dict.sentEntries = (uint32_t)dict.entries.size();
+  }
+
+  BatchBuilder batch(m_body);
+
+  // The bitmap may be left out while there are no nulls
+  auto validity = [&]() { batch.buffer(m_valid.data(), m_nulls > 0 ? m_valid.size() : 0); };
+
+  auto dictionary = [&](DictionaryColumn const& column) {
+    batch.node(m_rows, m_nulls);
+    validity();
+    batch.buffer(column.indices.data(), column.indices.size() * sizeof(int32_t));
+  };
+
+  auto string = [&](StringColumn const& column, uint32_t nulls) {
+    batch.node(m_rows, nulls);
+    if (nulls > 0)
+      validity();
+    else
+      batch.buffer(nullptr, 0);
+    batch.buffer(column.offsets.data(), column.offsets.size() * sizeof(int32_t));
+    batch.buffer(column.data.data(), column.data.size());
+  };
+
+  auto integer = [&](std::vector<uint32_t> const& column) {
+    batch.node(m_rows, m_nulls);
+    validity();
+    batch.buffer(column.data(), column.size() * sizeof(uint32_t));
+  };
+
+  dictionary(m_module);
+  dictionary(m_level);
+  string(m_timestamp, m_nulls);
+  integer(m_pid);
+  integer(m_tid);
+  dictionary(m_source);
+  dictionary(m_func);
+  string(m_message, 0);
+
+  writeMessage(FbWriter::build(message(HeaderRecordBatch, batch.table(m_rows), m_body.size())));
+
+  for (auto* dict: dictionaries) {
+    dict->indices.clear();
+    if (dict->bytes() > DictionaryBytes) dict->reset(); // Sent again from scratch with the next group
+  }
+  m_timestamp.clear();
+  m_message.clear();
+  m_pid.clear();
+  m_tid.clear();
+  m_valid.clear();
+  m_rows  = 0;
+  m_nulls = 0;
+}
+
+bool PLogArrowWriter::finish() {
+  if (m_rows > 0) flushGroup();
+
+  uint32_t const end[2] = {Continuation, 0};
+  m_out.write((const char*)end, sizeof(end));
+  m_written += sizeof(end);
+
+  m_out.flush();
+  return m_out.good();
+}
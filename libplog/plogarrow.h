@@ -0,0 +1,102 @@
+#pragma once
+
+#include "ploga.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Columnar export for data tools: the fields parseLine() splits a line into, written as an Arrow IPC stream (the streaming format, so
+// pyarrow.ipc.open_stream() and friends load it as is). Columns, in this order:
+//   module, level:    dictionary-encoded utf8
+//   timestamp:        utf8
+//   pid, tid:         uint32
+//   source, func:     dictionary-encoded utf8
+//   message:          utf8
+//
+// Lines are collected into row groups of groupLines lines (fewer once their text gets past GroupBytes), each group is one record batch
+// preceded by delta dictionary batches carrying the strings it introduced. A dictionary that grows past DictionaryBytes is dropped after
+// a group and sent from scratch as a replacement with the next one, so memory stays bounded whatever the log size. Lines that don't split
+// into the plog fields keep their text in message and have every other column null.
+
+class PLogArrowWriter {
+  public:
+  static constexpr uint32_t DefaultGroupLines = 65536;
+  static constexpr size_t   GroupBytes        = 16 * 1024 * 1024; // Text of one row group, longer values are cut to it
+  static constexpr size_t   DictionaryBytes   = 16 * 1024 * 1024; // Strings of one dictionary
+
+  PLogArrowWriter(std::ostream& out, uint32_t groupLines = DefaultGroupLines);
+
+  void write(std::string_view line);
+
+  // Same for a line that was split already, out is what parseLine() returned for it
+  void write(std::string_view line, PLogAnalyzer::LineInfo const& info, std::string_view out);
+
+  // Flushes the last row group and ends the stream
+  bool finish();
+
+  uint64_t lines() const { return m_lines; }
+
+  uint64_t bytesIn() const { return m_bytesIn; }
+
+  uint64_t bytesOut() const { return m_written; }
+
+  private:
+  struct StringColumn {
+    std::vector<int32_t> offsets = {0};
+    std::string          data;
+
+    void add(std::string_view value);
+    void clear();
+  };
+
+  // Strings are interned into one buffer in the order they got their ids, so the strings new since the last group are the tail of it.
+  // Lookups go through an open addressing index, neighbouring lines mostly repeat the value so the last one is checked first
+  struct DictionaryColumn {
+    struct Entry {
+      uint32_t hash;
+      uint32_t offset;
+      uint32_t length;
+    };
+
+    std::string           strings;
+    std::vector<Entry>    entries; // By id
+    std::vector<uint32_t> index;   // Id + 1, 0 is empty
+    uint32_t              sentEntries = 0;     // Entries the reader has
+    bool                  sent        = false; // False while the dictionary has to go out whole, as the first one or a replacement
+
+    std::vector<int32_t> indices; // Of the current group
+    int32_t              lastId = -1;
+
+    std::string_view value(size_t id) const { return std::string_view(strings).substr(entries[id].offset, entries[id].length); }
+
+    size_t bytes() const { return strings.size() + entries.size() * sizeof(Entry) + index.size() * sizeof(uint32_t); }
+
+    void add(std::string_view value);
+    void reset();
+  };
+
+  void writeMessage(std::string const& metadata);
+  void flushGroup();
+
+  std::ostream& m_out;
+  uint32_t      m_groupLines;
+
+  // Current row group
+  DictionaryColumn      m_module, m_level, m_source, m_func;
+  StringColumn          m_timestamp, m_message;
+  std::vector<uint32_t> m_pid, m_tid;
+  std::vector<uint8_t>  m_valid; // Bitmap shared by all columns but the message
+  uint32_t              m_rows  = 0;
+  uint32_t              m_nulls = 0;
+
+  std::string          m_body;    // Scratch for message bodies
+  std::vector<int32_t> m_offsets; // Scratch for dictionary batches
+
+  uint64_t m_lines   = 0;
+  uint64_t m_bytesIn = 0;
+  uint64_t m_written = 0;
+};
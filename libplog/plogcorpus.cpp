@@ -0,0 +1,314 @@
+#include "plogcorpus.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr uint32_t StateVersion = 1;
+
+// operator[] on a const json asserts on missing keys, shard files come from outside
+nlohmann::json const& field(nlohmann::json const& state, const char* key) {
+  static nlohmann::json const missing;
+
+  auto const it = state.find(key);
+  return it != state.end() ? *it : missing;
+}
+
+bool loadNumber(nlohmann::json const& state, const char* key, uint64_t& to) {
+  auto const& value = field(state, key);
+  if (!value.is_number_unsigned()) return false;
+  to = value.get<uint64_t>();
+  return true;
+}
+
+void mergeCounters(std::map<std::string, uint64_t, std::less<>>& to, std::map<std::string, uint64_t, std::less<>> const& from) {
+  for (auto const& [key, count]: from)
+    to[key] += count;
+}
+
+bool loadCounters(nlohmann::json const& state, std::map<std::string, uint64_t, std::less<>>& to) {
+  if (!state.is_object()) return false;
+  for (auto const& [key, count]: state.items()) {
+    if (!count.is_number_unsigned()) return false;
+    to[key] = count.get<uint64_t>();
+  }
+  return true;
+}
+} // namespace
+
+// FNV-1a, std::hash differs between standard libraries and saved sketches have to line up
+uint64_t PLogCountMin::hashOf(std::string_view key) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (auto ch: key)
+    hash = (hash ^ (uint8_t)ch) * 0x100000001b3ull;
+  return hash;
+}
+
+void PLogCountMin::add(std::string_view key, uint64_t count) {
+  auto const hash = hashOf(key);
+  auto const step = (hash >> 32) | 1; // Rows are (h1 + i * h2) mod Width, two hashes are as good as Depth of them here
+
+  for (size_t row = 0; row < Depth; ++row)
+    m_table[row][(hash + row * step) % Width] += (uint32_t)count;
+  m_total += count;
+}
+
+uint64_t PLogCountMin::estimate(std::string_view key) const {
+  auto const hash = hashOf(key);
+  auto const step = (hash >> 32) | 1;
+
+  uint64_t result = UINT64_MAX;
+  for (size_t row = 0; row < Depth; ++row)
+    result = std::min<uint64_t>(result, m_table[row][(hash + row * step) % Width]);
+  return result;
+}
+
+uint64_t PLogCountMin::errorBound() const {
+  return (uint64_t)std::ceil(std::exp(1.0) * m_total / Width);
+}
+
+void PLogCountMin::merge(PLogCountMin const& other) {
+  for (size_t row = 0; row < Depth; ++row) {
+    for (size_t col = 0; col < Width; ++col)
+      m_table[row][col] += other.m_table[row][col];
+  }
+  m_total += other.m_total;
+}
+
+nlohmann::json PLogCountMin::save() const {
+  auto table = nlohmann::json::array();
+  for (auto const& row: m_table)
+    table.push_back(row);
+
+  return {
+      {"total", m_total},
+      {"table", std::move(table)},
+  };
+}
+
+bool PLogCountMin::load(nlohmann::json const& state) {
+  if (!state.is_object()) return false;
+
+  auto const& table = field(state, "table");
+  uint64_t    total;
+  if (!loadNumber(state, "total", total) || !table.is_array() || table.size() != Depth) return false;
+
+  for (size_t row = 0; row < Depth; ++row) {
+    auto const& cols = table[row];
+    if (!cols.is_array() || cols.size() != Width) return false;
+    for (size_t col = 0; col < Width; ++col) {
+      if (!cols[col].is_number_unsigned()) return false;
+      m_table[row][col] = cols[col].get<uint32_t>();
+    }
+  }
+
+  m_total = total;
+  return true;
+}
+
+void PLogCorpus::add(nlohmann::json const& report) {
+  if (!report.is_object() || !field(report, "type").is_string()) {
+    skip();
+    return;
+  }
+
+  ++m_logs;
+  ++m_types[field(report, "type").get<std::string>()];
+
+  // Labels and firmware are counted once per log, however often they were reported
+  std::set<std::string> labels;
+  if (auto const it = report.find("labels"); it != report.end() && it->is_array()) {
+    for (auto const& label: *it) {
+      if (label.is_string()) labels.insert(label.get<std::string>());
+    }
+  }
+
+  bool const failing = labels.contains("exception");
+  if (failing) ++m_failing;
+
+  for (auto first = labels.begin(); first != labels.end(); ++first) {
+    ++m_labels[*first];
+    for (auto second = std::next(first); second != labels.end(); ++second)
+      ++m_labelPairs[*first][*second];
+  }
+
+  if (auto const it = report.find("hints"); it != report.end() && it->is_array()) {
+    for (auto const& hint: *it) {
+      if (hint.is_string()) ++m_hints[hint.get<std::string>()];
+    }
+  }
+
+  std::set<std::string> firmware;
+  if (auto const it = report.find("firmware"); it != report.end() && it->is_array()) {
+    for (auto const& name: *it) {
+      if (name.is_string()) firmware.insert(name.get<std::string>());
+    }
+  }
+
+  for (auto const& name: firmware) {
+    m_firmware.add(name);
+    if (failing) m_failingFirmware.add(name);
+
+    m_firmwareNames.insert(name);
+  }
+  trimFirmware(2 * MaxFirmwareNames); // Ranking is sorting, not worth doing for every new name
+}
+
+std::vector<std::string const*> PLogCorpus::rankFirmware() const {
+  struct Ranked {
+    std::string const* name;
+    uint64_t           logs;
+  };
+
+  std::vector<Ranked> ranked;
+  ranked.reserve(m_firmwareNames.size());
+  for (auto const& name: m_firmwareNames)
+    ranked.push_back({.name = &name, .logs = m_firmware.estimate(name)});
+
+  std::stable_sort(ranked.begin(), ranked.end(), [](Ranked const& a, Ranked const& b) { return a.logs > b.logs; }); // The set is sorted by name
+
+  std::vector<std::string const*> names;
+  names.reserve(ranked.size());
+  for (auto const& item: ranked)
+    names.push_back(item.name);
+  return names;
+}
+
+void PLogCorpus::trimFirmware(size_t limit) {
+  if (m_firmwareNames.size() <= limit) return;
+
+  auto const                         ranked = rankFirmware();
+  std::set<std::string, std::less<>> kept;
+  for (size_t i = 0; i < MaxFirmwareNames; ++i)
+    kept.insert(*ranked[i]);
+  m_firmwareNames = std::move(kept);
+}
+
+void PLogCorpus::merge(PLogCorpus const& other) {
+  m_logs += other.m_logs;
+  m_failing += other.m_failing;
+  m_skipped += other.m_skipped;
+
+  mergeCounters(m_types, other.m_types);
+  mergeCounters(m_labels, other.m_labels);
+  mergeCounters(m_hints, other.m_hints);
+  for (auto const& [label, pairs]: other.m_labelPairs)
+    mergeCounters(m_labelPairs[label], pairs);
+
+  m_firmware.merge(other.m_firmware);
+  m_failingFirmware.merge(other.m_failingFirmware);
+  m_firmwareNames.insert(other.m_firmwareNames.begin(), other.m_firmwareNames.end());
+  trimFirmware(MaxFirmwareNames); // Ranked by the merged sketch, a name frequent in one shard only still makes it
+}
+
+nlohmann::json PLogCorpus::report() const {
+  // Pairs are stored once, the report lists them from both sides so any label can be looked up directly
+  auto pairs = nlohmann::json::object();
+  for (auto const& [first, seconds]: m_labelPairs) {
+    for (auto const& [second, count]: seconds) {
+      pairs[first][second] = count;
+      pairs[second][first] = count;
+    }
+  }
+
+  struct Firmware {
+    std::string const* name;
+    uint64_t           logs;
+    uint64_t           failing;
+  };
+
+  auto const            ranked = rankFirmware();
+  std::vector<Firmware> firmware;
+  firmware.reserve(std::min(ranked.size(), MaxFirmwareNames));
+  for (size_t i = 0; i < ranked.size() && i < MaxFirmwareNames; ++i)
+    firmware.push_back({.name = ranked[i], .logs = m_firmware.estimate(*ranked[i]), .failing = m_failingFirmware.estimate(*ranked[i])});
+
+  auto const n = std::min<size_t>(50, firmware.size());
+  std::partial_sort(firmware.begin(), firmware.begin() + n, firmware.end(), [](Firmware const& a, Firmware const& b) {
+    return a.logs != b.logs ? a.logs > b.logs : a.failing != b.failing ? a.failing > b.failing : *a.name < *b.name;
+  });
+
+  auto top = nlohmann::json::array();
+  for (size_t i = 0; i < n; ++i) {
+    top.push_back({
+        {"name", *firmware[i].name},
+        {"logs", firmware[i].logs},
+        {"failing", firmware[i].failing},
+    });
+  }
+
+  return {
+      {"logs", m_logs},
+      {"failing", m_failing},
+      {"skipped", m_skipped},
+      {"types", m_types},
+      {"labels", m_labels},
+      {"label_pairs", std::move(pairs)},
+      {"hints", m_hints},
+      {
+          "firmware",
+          {
+              {"names", firmware.size()},
+              {"error_bound", m_firmware.errorBound()},
+              {"failing_error_bound", m_failingFirmware.errorBound()},
+              {"top", std::move(top)},
+          },
+      },
+  };
+}
+
+nlohmann::json PLogCorpus::save() const {
+  auto pairs = nlohmann::json::object();
+  for (auto const& [first, seconds]: m_labelPairs)
+    pairs[first] = seconds;
+
+  auto       names  = nlohmann::json::array();
+  auto const ranked = rankFirmware();
+  for (size_t i = 0; i < ranked.size() && i < MaxFirmwareNames; ++i)
+    names.push_back(*ranked[i]);
+
+  return {
+      {"plog_corpus", StateVersion},
+      {"logs", m_logs},
+      {"failing", m_failing},
+      {"skipped", m_skipped},
+      {"types", m_types},
+      {"labels", m_labels},
+      {"label_pairs", std::move(pairs)},
+      {"hints", m_hints},
+      {"firmware", m_firmware.save()},
+      {"failing_firmware", m_failingFirmware.save()},
+      {"firmware_names", std::move(names)},
+  };
+}
+
+bool PLogCorpus::load(nlohmann::json const& state) {
+  uint64_t version;
+  if (!state.is_object() || !loadNumber(state, "plog_corpus", version) || version != StateVersion) return false;
+
+  PLogCorpus loaded;
+  if (!loadNumber(state, "logs", loaded.m_logs) || !loadNumber(state, "failing", loaded.m_failing) || !loadNumber(state, "skipped", loaded.m_skipped))
+    return false;
+
+  if (!loadCounters(field(state, "types"), loaded.m_types) || !loadCounters(field(state, "labels"), loaded.m_labels) ||
+      !loadCounters(field(state, "hints"), loaded.m_hints))
+    return false;
+
+  auto const& pairs = field(state, "label_pairs");
+  if (!pairs.is_object()) return false;
+  for (auto const& [label, seconds]: pairs.items()) {
+    if (!loadCounters(seconds, loaded.m_labelPairs[label])) return false;
+  }
+
+  auto const& names = field(state, "firmware_names");
+  if (!loaded.m_firmware.load(field(state, "firmware")) || !loaded.m_failingFirmware.load(field(state, "failing_firmware")) || !names.is_array() ||
+      names.size() > MaxFirmwareNames)
+    return false;
+  for (auto const& name: names) {
+    if (!name.is_string()) return false;
+    loaded.m_firmwareNames.insert(name.get<std::string>());
+  }
+
+  *this = std::move(loaded);
+  return true;
+}
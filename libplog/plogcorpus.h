@@ -0,0 +1,87 @@
+#pragma once
+
+#include "third_party/json.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Count-min sketch with a stable hash, so sketches saved by different runs can be added together. Estimates never undercount, the
+// overcount stays below total * e / Width with probability 1 - e^-Depth
+class PLogCountMin {
+  public:
+  static constexpr size_t Width = 2048;
+  static constexpr size_t Depth = 4;
+
+  void add(std::string_view key, uint64_t count = 1);
+
+  uint64_t estimate(std::string_view key) const;
+
+  uint64_t total() const { return m_total; }
+
+  // Upper bound of the overcount, see above
+  uint64_t errorBound() const;
+
+  void merge(PLogCountMin const& other);
+
+  nlohmann::json save() const;
+  bool           load(nlohmann::json const& state);
+
+  static uint64_t hashOf(std::string_view key);
+
+  private:
+  std::array<std::array<uint32_t, Width>, Depth> m_table = {};
+
+  uint64_t m_total = 0;
+};
+
+// Fleet wide summary of analyser reports. Counters and sketches merge associatively and commutatively, so shards summarised on different
+// threads or machines can be combined in any order and give the same counts as summarising all the reports at once. Firmware names are
+// candidates for the top list: every shard keeps the ones the sketch counts most often, a name that is rare in every shard can be missed
+class PLogCorpus {
+  public:
+  static constexpr size_t MaxFirmwareNames = 1024; // Names the sketches are queried for, the most counted ones are kept
+
+  // Folds in one report, as returned by PLogAnalyzer::info()
+  void add(nlohmann::json const& report);
+
+  // Inputs that couldn't be analysed
+  void skip() { ++m_skipped; }
+
+  void merge(PLogCorpus const& other);
+
+  nlohmann::json report() const;
+
+  // Shard state, load() replaces the current one with it
+  nlohmann::json save() const;
+  bool           load(nlohmann::json const& state);
+
+  private:
+  using Counters = std::map<std::string, uint64_t, std::less<>>;
+
+  // Most counted firmware names first, ties by name so the order doesn't depend on the shards
+  std::vector<std::string const*> rankFirmware() const;
+
+  // Drops the least counted names once there are more than limit of them
+  void trimFirmware(size_t limit);
+
+  uint64_t m_logs    = 0;
+  uint64_t m_failing = 0; // Logs with the "exception" label
+  uint64_t m_skipped = 0;
+
+  Counters m_types;
+  Counters m_labels;
+  Counters m_hints;
+
+  std::map<std::string, Counters, std::less<>> m_labelPairs; // Logs having both labels, first one sorts before the second
+
+  PLogCountMin                       m_firmware;        // Logs loading the module
+  PLogCountMin                       m_failingFirmware; // Same for failing logs only
+  std::set<std::string, std::less<>> m_firmwareNames;   // Candidates for the top list, up to twice MaxFirmwareNames between trims
+};
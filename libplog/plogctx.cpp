@@ -0,0 +1,204 @@
+#include "plogctx.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+void PLogContext::push(uint64_t offset, uint32_t size, uint32_t threadId) {
+  Slot const slot = {.offset = offset, .line = ++m_lines, .size = size, .thread = threadId};
+  m_overall.push(slot);
+
+  ThreadRing* target = &m_threads[0];
+  for (auto& tr: m_threads) {
+    if (tr.lastSeen != 0 && tr.thread == threadId) {
+      target = &tr;
+      break;
+    }
+    if (tr.lastSeen < target->lastSeen) target = &tr;
+  }
+
+  if (target->lastSeen == 0 || target->thread != threadId) {
+    *target        = {};
+    target->thread = threadId;
+  }
+  target->lastSeen = m_lines;
+  target->ring.push(slot);
+}
+
+void PLogContext::push(uint64_t offset, std::string_view line, uint32_t threadId) {
+  push(offset, (uint32_t)line.size(), threadId);
+  if (!m_input.empty() || m_resolver) return;
+
+  // Streamed input, keep the tail of it. Only the last WindowSize bytes of an overlong line survive
+  if (line.size() > WindowSize) {
+    offset += line.size() - WindowSize;
+    line    = line.substr(line.size() - WindowSize);
+  }
+
+  auto const start = offset % WindowSize;
+  auto const first = std::min(line.size(), WindowSize - start);
+  std::memcpy(m_window.data() + start, line.data(), first);
+  std::memcpy(m_window.data(), line.data() + first, line.size() - first);
+  m_windowEnd = offset + line.size();
+}
+
+bool PLogContext::resolve(Slot const& slot, std::string& text) const {
+  if (!m_input.empty()) {
+    if (slot.offset + slot.size > m_input.size()) return false;
+    text = m_input.substr(slot.offset, slot.size);
+    return true;
+  }
+
+  // Already overwritten, an overlong line only kept its tail
+  if (slot.offset + WindowSize < m_windowEnd || slot.size > WindowSize) return false;
+
+  // A line that wraps around the end of the window comes in two pieces
+  auto const start = slot.offset % WindowSize;
+  auto const first = std::min<size_t>(slot.size, WindowSize - start);
+  text.assign(m_window.data() + start, first);
+  text.append(m_window.data(), slot.size - first);
+  return true;
+}
+
+template <size_t N>
+nlohmann::json PLogContext::dumpRing(Ring<N> const& ring) const {
+  auto lines = nlohmann::json::array();
+
+  for (auto i = ring.count > N ? ring.count - N : 0; i < ring.count; ++i) {
+    auto const& slot = ring.slots[i % N];
+
+    std::string text;
+    if (!(m_resolver ? m_resolver(slot.line - 1, text) : resolve(slot, text))) text = "<dropped>";
+
+    lines.push_back({
+        {"line", slot.line},
+        {"offset", slot.offset},
+        {"thread", slot.thread},
+        {"text", std::move(text)},
+    });
+  }
+
+  return lines;
+}
+
+nlohmann::json PLogContext::snapshot(uint32_t threadId) const {
+  nlohmann::json context = {
+      {"thread", threadId},
+      {"overall", dumpRing(m_overall)},
+      {
+          "thread_lines",
+          nlohmann::json::array(),
+      },
+  };
+
+  for (auto const& tr: m_threads) {
+    if (tr.lastSeen != 0 && tr.thread == threadId) {
+      context["thread_lines"] = dumpRing(tr.ring);
+      break;
+    }
+  }
+
+  return context;
+}
+
+template <size_t N>
+nlohmann::json PLogContext::saveRing(Ring<N> const& ring) {
+  auto slots = nlohmann::json::array();
+  for (auto i = ring.count > N ? ring.count - N : 0; i < ring.count; ++i) {
+    auto const& slot = ring.slots[i % N];
+    slots.push_back({slot.offset, slot.line, slot.size, slot.thread});
+  }
+
+  return {
+      {"count", ring.count},
+      {"slots", std::move(slots)},
+  };
+}
+
+template <size_t N>
+bool PLogContext::loadRing(nlohmann::json const& state, Ring<N>& ring) {
+  auto const  count = state.at("count").get<uint64_t>();
+  auto const& slots = state.at("slots");
+  if (slots.size() != std::min<uint64_t>(count, N)) return false;
+
+  ring       = {};
+  ring.count = count - slots.size();
+  for (auto const& fields: slots) {
+    ring.push({.offset = fields.at(0).get<uint64_t>(),
+               .line   = fields.at(1).get<uint64_t>(),
+               .size   = fields.at(2).get<uint32_t>(),
+               .thread = fields.at(3).get<uint32_t>()});
+  }
+  return true;
+}
+
+nlohmann::json PLogContext::save() const {
+  auto threads = nlohmann::json::array();
+  for (auto const& tr: m_threads) {
+    if (tr.lastSeen == 0) continue;
+    threads.push_back({
+        {"thread", tr.thread},
+        {"last_seen", tr.lastSeen},
+        {"ring", saveRing(tr.ring)},
+    });
+  }
+
+  nlohmann::json state = {
+      {"lines", m_lines},
+      {"overall", saveRing(m_overall)},
+      {"threads", std::move(threads)},
+  };
+
+  // Only the bytes the rings can still resolve, a window that wrapped keeps its whole size
+  if (m_windowEnd > 0) {
+    auto const start = m_windowEnd - std::min<uint64_t>(m_windowEnd, WindowSize);
+
+    std::vector<uint8_t> window;
+    window.reserve(m_windowEnd - start);
+    for (auto offset = start; offset < m_windowEnd; ++offset)
+      window.push_back((uint8_t)m_window[offset % WindowSize]);
+
+    state["window_end"] = m_windowEnd;
+    state["window"]     = nlohmann::json::binary(std::move(window));
+  }
+
+  return state;
+}
+
+bool PLogContext::load(nlohmann::json const& state) {
+  Ring<OverallLines>              overall;
+  std::array<ThreadRing, Threads> threads;
+  uint64_t                        lines, windowEnd = 0;
+
+  try {
+    lines = state.at("lines").get<uint64_t>();
+    if (!loadRing(state.at("overall"), overall)) return false;
+
+    auto const& saved = state.at("threads");
+    if (saved.size() > Threads) return false;
+    for (size_t i = 0; i < saved.size(); ++i) {
+      threads[i].thread   = saved[i].at("thread").get<uint32_t>();
+      threads[i].lastSeen = saved[i].at("last_seen").get<uint64_t>();
+      if (!loadRing(saved[i].at("ring"), threads[i].ring)) return false;
+    }
+
+    if (state.contains("window_end")) {
+      windowEnd          = state.at("window_end").get<uint64_t>();
+      auto const& window = state.at("window").get_binary();
+      if (window.size() != std::min<uint64_t>(windowEnd, WindowSize)) return false;
+
+      for (size_t i = 0; i < window.size(); ++i)
+        m_window[(windowEnd - window.size() + i) % WindowSize] = (char)window[i];
+    }
+  } catch (nlohmann::json::exception const&) {
+    return false;
+  }
+
+  m_lines     = lines;
+  m_overall   = overall;
+  m_threads   = threads;
+  m_windowEnd = windowEnd;
+  return true;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "third_party/json.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// Remembers the last lines of the log, overall and per thread, so the lead-up to a crash can go into the report. Lines are kept as
+// (offset, size) pairs into the input and resolved only when a snapshot is taken, memory stays the same whatever the log size
+class PLogContext {
+  public:
+  static constexpr size_t OverallLines = 32;
+  static constexpr size_t ThreadLines  = 8;
+  static constexpr size_t Threads      = 64;        // Least recently seen thread gets evicted once all slots are taken
+  static constexpr size_t WindowSize   = 64 * 1024; // Tail of a streamed input, memory inputs are sliced directly
+
+  // Gives back the text of a line by its zero based number, false if it can't be read anymore
+  using Resolver = std::function<bool(uint64_t line, std::string& text)>;
+
+  // Inputs held in memory as a whole don't need the window
+  void setInput(std::string_view input) { m_input = input; }
+
+  // Neither do inputs that can read a line again later, the archives
+  void setResolver(Resolver resolver) { m_resolver = std::move(resolver); }
+
+  void push(uint64_t offset, std::string_view line, uint32_t threadId);
+
+  // Line text is left to the input or the resolver
+  void push(uint64_t offset, uint32_t size, uint32_t threadId);
+
+  // Overall lines and the lines of threadId, oldest first
+  nlohmann::json snapshot(uint32_t threadId) const;
+
+  // Checkpoint of the rings and the window of a streamed input, load() replaces them with it. The input and the resolver stay
+  nlohmann::json save() const;
+  bool           load(nlohmann::json const& state);
+
+  private:
+  struct Slot {
+    uint64_t offset = 0;
+    uint64_t line   = 0;
+    uint32_t size   = 0;
+    uint32_t thread = 0;
+  };
+
+  template <size_t N>
+  struct Ring {
+    std::array<Slot, N> slots;
+    uint64_t            count = 0;
+
+    void push(Slot const& slot) { slots[count++ % N] = slot; }
+  };
+
+  struct ThreadRing {
+    uint32_t          thread   = 0;
+    uint64_t          lastSeen = 0; // 0 marks an unused slot
+    Ring<ThreadLines> ring;
+  };
+
+  template <size_t N>
+  nlohmann::json dumpRing(Ring<N> const& ring) const;
+
+  template <size_t N>
+  static nlohmann::json saveRing(Ring<N> const& ring);
+
+  template <size_t N>
+  static bool loadRing(nlohmann::json const& state, Ring<N>& ring);
+
+  bool resolve(Slot const& slot, std::string& text) const;
+
+  std::string_view m_input;
+  Resolver         m_resolver;
+  uint64_t         m_lines = 0;
+
+  Ring<OverallLines>              m_overall;
+  std::array<ThreadRing, Threads> m_threads;
+
+  std::array<char, WindowSize> m_window;
+  uint64_t                     m_windowEnd = 0; // Input offset right after the last byte stored in m_window
+};
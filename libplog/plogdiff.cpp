@@ -0,0 +1,263 @@
+#include "plogdiff.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace {
+constexpr uint64_t Wildcard     = 0x2a2a2a2a2a2a2a2aull;
+constexpr size_t   TopTemplates = 50;
+constexpr double   MinRatio     = 1.5; // Rate changes smaller than that aren't reported
+constexpr double   MinChange    = 10;  // Neither are changes by fewer lines, whatever the ratio
+
+bool isVariable(std::string_view token) {
+  return token.size() > PLogDrain<char>::MaxTokenSize || std::any_of(token.begin(), token.end(), [](char ch) { return ch >= '0' && ch <= '9'; });
+}
+
+template <typename Func>
+void forEachToken(std::string_view message, Func&& func) {
+  for (size_t pos = 0; pos < message.size();) {
+    if (message[pos] == ' ') {
+      ++pos;
+      continue;
+    }
+
+    auto const end = std::min(message.find(' ', pos), message.size());
+    func(message.substr(pos, end - pos));
+    pos = end;
+  }
+}
+
+uint64_t mix(uint64_t hash, uint64_t value) {
+  hash = (hash ^ value) * 0x9e3779b97f4a7c15ull;
+  return hash ^ (hash >> 29);
+}
+
+uint64_t hashOf(std::string_view str) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (auto ch: str)
+    hash = (hash ^ (uint8_t)ch) * 0x100000001b3ull;
+  return hash;
+}
+
+uint64_t templateHash(std::string_view module, std::string_view message) {
+  uint64_t hash = hashOf(module);
+  forEachToken(message, [&hash](std::string_view token) { hash = mix(hash, isVariable(token) ? Wildcard : hashOf(token)); });
+  return hash;
+}
+
+std::string templateText(std::string_view message) {
+  std::string text;
+  forEachToken(message, [&text](std::string_view token) {
+    if (!text.empty()) text.push_back(' ');
+    if (isVariable(token))
+      text += "<*>";
+    else
+      text += token;
+  });
+  return text;
+}
+
+// Items of a report array that only one side has
+nlohmann::json diffSets(nlohmann::json const& before, nlohmann::json const& after) {
+  auto collect = [](nlohmann::json const& items) {
+    std::set<std::string> result;
+    if (items.is_array()) {
+      for (auto const& item: items) {
+        if (item.is_string()) result.insert(item.get<std::string>());
+      }
+    }
+    return result;
+  };
+
+  auto const a = collect(before), b = collect(after);
+
+  auto added = nlohmann::json::array(), removed = nlohmann::json::array();
+  for (auto const& item: b) {
+    if (!a.contains(item)) added.push_back(item);
+  }
+  for (auto const& item: a) {
+    if (!b.contains(item)) removed.push_back(item);
+  }
+
+  return {
+      {"added", std::move(added)},
+      {"removed", std::move(removed)},
+  };
+}
+
+nlohmann::json field(nlohmann::json const& report, std::string const& key) {
+  auto const it = report.find(key);
+  return it != report.end() ? *it : nlohmann::json();
+}
+} // namespace
+
+bool PLogProfile::feed(std::string_view line) {
+  auto const offset = m_offset;
+  m_offset += line.size() + 1;
+
+  PLogAnalyzer::LineInfo info = {};
+
+  auto const out = PLogAnalyzer::parseLine(line, info);
+  if (!m_analyser.feed(line, info, out)) return false;
+  if (out.empty()) return true;
+  ++m_lines;
+
+  auto const hash = templateHash(info.module, out);
+  if (auto it = m_templates.find(hash); it != m_templates.end()) {
+    ++it->second.count;
+    return true;
+  }
+
+  if (m_templates.size() < MaxTemplates) {
+    auto       text = templateText(out);
+    auto const cost = text.size() + info.module.size() + 96; // Map node and string headers
+    if (cost <= m_templateBytes) {
+      m_templateBytes -= cost;
+      m_templates.emplace(hash, Template {.count = 1, .first = offset, .module = std::string(info.module), .text = std::move(text)});
+      return true;
+    }
+  }
+
+  ++m_untracked;
+  return true;
+}
+
+void PLogProfile::readstream(std::istream& stream) {
+  if (m_lineBytes == SIZE_MAX) {
+    std::string line;
+    while (std::getline(stream, line)) {
+      if (!feed(line)) break;
+    }
+  } else {
+    std::vector<char> buffer(m_lineBytes + 1);
+    std::string_view  line;
+    size_t            skipped;
+    while (PLogAnalyzer::readLine(stream, buffer, line, skipped)) {
+      bool const keepGoing = feed(line);
+      if (skipped > 0) {
+        m_offset += skipped;
+        m_analyser.skip(skipped);
+      }
+      if (!keepGoing) break;
+    }
+  }
+
+  finish();
+}
+
+nlohmann::json diffProfiles(PLogProfile const& before, PLogProfile const& after) {
+  struct Change {
+    PLogProfile::Template const* tpl;
+    uint64_t                     before;
+    uint64_t                     after;
+    double                       score;
+  };
+
+  // Counts of the earlier log are scaled to the length of the later one, a longer session alone isn't a change
+  double const scale = before.lines() > 0 ? (double)after.lines() / before.lines() : 1.0;
+
+  std::vector<Change> appeared, disappeared, changed;
+  for (auto const& [hash, tpl]: after.templates()) {
+    auto const it = before.templates().find(hash);
+    if (it == before.templates().end()) {
+      appeared.push_back({.tpl = &tpl, .before = 0, .after = tpl.count, .score = (double)tpl.count});
+      continue;
+    }
+
+    auto const expected = it->second.count * scale;
+    auto const ratio    = (tpl.count + 1.0) / (expected + 1.0);
+    if ((ratio >= MinRatio || ratio <= 1.0 / MinRatio) && std::abs(tpl.count - expected) >= MinChange)
+      changed.push_back({.tpl = &tpl, .before = it->second.count, .after = tpl.count, .score = std::abs(tpl.count - expected)});
+  }
+
+  for (auto const& [hash, tpl]: before.templates()) {
+    if (!after.templates().contains(hash)) disappeared.push_back({.tpl = &tpl, .before = tpl.count, .after = 0, .score = (double)tpl.count});
+  }
+
+  auto dump = [](std::vector<Change>& changes) {
+    auto const n = std::min(TopTemplates, changes.size());
+    std::partial_sort(changes.begin(), changes.begin() + n, changes.end(), [](Change const& a, Change const& b) {
+      return a.score != b.score ? a.score > b.score : a.tpl->first < b.tpl->first;
+    });
+
+    auto top = nlohmann::json::array();
+    for (size_t i = 0; i < n; ++i) {
+      top.push_back({
+          {"module", changes[i].tpl->module},
+          {"template", changes[i].tpl->text},
+          {"before", changes[i].before},
+          {"after", changes[i].after},
+          {"first", changes[i].tpl->first}, // In the log the template was taken from, the later one unless it disappeared
+      });
+    }
+
+    return nlohmann::json {
+        {"total", changes.size()},
+        {"top", std::move(top)},
+    };
+  };
+
+  auto summary = [](PLogProfile const& profile) {
+    return nlohmann::json {
+        {"lines", profile.lines()},
+        {"templates", profile.templates().size()},
+        {"untracked", profile.untracked()},
+    };
+  };
+
+  // Scalar report fields are the configuration (emulator options, title, GPU, language), arrays are compared as sets
+  auto const& a = before.info();
+  auto const& b = after.info();
+
+  std::set<std::string> keys;
+  for (auto const* report: {&a, &b}) {
+    if (!report->is_object()) continue;
+    for (auto const& [key, value]: report->items())
+      keys.insert(key);
+  }
+
+  auto config = nlohmann::json::object();
+  for (auto const& key: keys) {
+    auto const va = field(a, key), vb = field(b, key);
+    if (va.is_structured() || vb.is_structured() || va == vb) continue;
+    config[key] = {
+        {"before", va},
+        {"after", vb},
+    };
+  }
+
+  return {
+      {"before", summary(before)},
+      {"after", summary(after)},
+      {"config", std::move(config)},
+      {"firmware", diffSets(field(a, "firmware"), field(b, "firmware"))},
+      {"labels", diffSets(field(a, "labels"), field(b, "labels"))},
+      {"hints", diffSets(field(a, "hints"), field(b, "hints"))},
+      {"appeared", dump(appeared)},
+      {"disappeared", dump(disappeared)},
+      {"changed", dump(changed)},
+  };
+}
+
+std::string diffLogs(std::filesystem::path const& before, std::filesystem::path const& after, PLogOptions const& options) {
+  auto const half = options.share(2); // Both profiles are alive at the same time
+
+  PLogProfile profileBefore(half), profileAfter(half);
+
+  std::thread worker([&after, &profileAfter] {
+    std::ifstream file(after, std::ios::in | std::ios::binary);
+    profileAfter.readstream(file);
+  });
+
+  {
+    std::ifstream file(before, std::ios::in | std::ios::binary);
+    profileBefore.readstream(file);
+  }
+  worker.join();
+
+  return diffProfiles(profileBefore, profileAfter).dump(2, ' ', true);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "ploga.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Report of one log plus how often every message template showed up in it. Templates follow the PLogDrain rule without the clustering:
+// tokens with digits in them are wildcards, so a message hashes to its template in one pass and two logs line up by hash alone
+class PLogProfile {
+  public:
+  static constexpr size_t MaxTemplates = 64 * 1024; // Past that (or the memory budget), lines of new templates are only counted as untracked
+
+  struct Template {
+    uint64_t    count;
+    uint64_t    first; // Byte offset of the first line
+    std::string module;
+    std::string text; // Wildcards rendered as "<*>"
+  };
+
+  PLogProfile(PLogOptions const& options = {})
+      : m_analyser(options), m_lineBytes(PLogBudget(options.memoryBudget).lineBytes), m_templateBytes(PLogBudget(options.memoryBudget).templateBytes) {}
+
+  // Returns false once the rest of the log is of no interest, same as the analyser
+  bool feed(std::string_view line);
+  void finish() { m_analyser.finish(); }
+
+  void readstream(std::istream& stream);
+
+  nlohmann::json const& info() const { return m_analyser.info(); }
+
+  std::unordered_map<uint64_t, Template> const& templates() const { return m_templates; }
+
+  uint64_t lines() const { return m_lines; }
+
+  uint64_t untracked() const { return m_untracked; }
+
+  private:
+  PLogAnalyzer m_analyser;
+
+  std::unordered_map<uint64_t, Template> m_templates;
+
+  size_t m_lineBytes;
+  size_t m_templateBytes; // Left for new templates, see PLogBudget
+
+  uint64_t m_lines     = 0; // Lines with a message, the ones templates are counted for
+  uint64_t m_offset    = 0;
+  uint64_t m_untracked = 0;
+};
+
+// Templates that appeared, disappeared or changed their rate (per line, so logs of different length compare), plus the report
+// fields, firmware, labels and hints that differ
+EXPORT nlohmann::json diffProfiles(PLogProfile const& before, PLogProfile const& after);
+
+// Both logs are profiled at the same time, one thread each
+EXPORT std::string diffLogs(std::filesystem::path const& before, std::filesystem::path const& after, PLogOptions const& options = {});
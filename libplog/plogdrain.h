@@ -0,0 +1,286 @@
+#pragma once
+
+#include "third_party/json.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Online template miner after Drain: a message is routed through a fixed depth tree (module, token count, first token) to a handful of
+// candidate templates, the most similar one absorbs it and turns the tokens they disagree on into wildcards. Tokens with digits in them
+// (numbers, addresses, handles) are wildcards from the start. Everything is capped, once MaxTemplates is reached or the templates outgrow
+// maxBytes, messages of a new shape only bump the unclustered counter
+template <typename CharT>
+class PLogDrain {
+  public:
+  using string_view = std::basic_string_view<CharT>;
+  using string      = std::basic_string<CharT>;
+
+  static constexpr size_t MaxTemplates = 2048;
+  static constexpr size_t MaxTokens    = 48; // Longer messages get their tail folded into one wildcard
+  static constexpr size_t MaxTokenSize = 64; // Longer tokens are wildcards
+  static constexpr size_t MaxChildren  = 64; // First tokens per (module, token count), the rest share the wildcard leaf
+  static constexpr double Similarity   = 0.5;
+
+  PLogDrain(size_t maxBytes = SIZE_MAX): m_maxBytes(maxBytes) {}
+
+  void add(std::string_view module, string_view message, uint64_t position);
+
+  uint64_t unclustered() const { return m_unclustered; }
+
+  // Top n templates of every module by count, wildcards are rendered as "<*>". A chatty module doesn't push the others out
+  template <typename Conv>
+  nlohmann::json dump(size_t n, Conv&& toUTF8) const;
+
+  // Checkpoint of the templates and the tree routing to them, load() replaces both with it
+  nlohmann::json save() const;
+  bool           load(nlohmann::json const& state);
+
+  private:
+  template <typename C>
+  struct Hash {
+    using is_transparent = void;
+
+    size_t operator()(std::basic_string_view<C> str) const { return std::hash<std::basic_string_view<C>>{}(str); }
+  };
+
+  struct Template {
+    std::string         module;
+    std::vector<string> tokens = {}; // Empty token is a wildcard
+    uint64_t            count  = 0;
+    uint64_t            first  = 0;
+  };
+
+  using Leaf       = std::vector<uint32_t>; // Indices into m_templates
+  using LengthNode = std::unordered_map<string, Leaf, Hash<CharT>, std::equal_to<>>;
+  using ModuleNode = std::unordered_map<size_t, LengthNode>;
+
+  static bool isWildcard(string_view token) { return token.data() == nullptr; }
+
+  // Tokens are saved as raw bytes, neither char16_t strings nor cut UTF-8 fit a json string
+  static nlohmann::json saveToken(string_view token) {
+    auto const* bytes = (uint8_t const*)token.data();
+    return nlohmann::json::binary(std::vector<uint8_t>(bytes, bytes + token.size() * sizeof(CharT)));
+  }
+
+  static string loadToken(nlohmann::json const& state) {
+    auto const& bytes = state.get_binary();
+    string      token(bytes.size() / sizeof(CharT), CharT(0));
+    if (!token.empty()) std::memcpy(token.data(), bytes.data(), token.size() * sizeof(CharT));
+    return token;
+  }
+
+  void tokenize(string_view message);
+
+  std::unordered_map<std::string, ModuleNode, Hash<char>, std::equal_to<>> m_tree;
+
+  std::vector<Template>    m_templates;
+  std::vector<string_view> m_tokens; // Scratch for the current message, a null view is a wildcard
+
+  size_t   m_maxBytes;
+  size_t   m_bytes       = 0; // Rough size of m_templates and the tree above them
+  uint64_t m_total       = 0;
+  uint64_t m_unclustered = 0;
+};
+
+template <typename CharT>
+void PLogDrain<CharT>::tokenize(string_view message) {
+  m_tokens.clear();
+
+  for (size_t pos = 0; pos < message.size();) {
+    if (message[pos] == ' ') {
+      ++pos;
+      continue;
+    }
+
+    size_t end = pos;
+    bool   var = false;
+    for (; end < message.size() && message[end] != ' '; ++end)
+      var = var || (message[end] >= '0' && message[end] <= '9');
+
+    if (m_tokens.size() == MaxTokens - 1) { // Fold the rest
+      m_tokens.emplace_back();
+      return;
+    }
+
+    m_tokens.push_back((var || (end - pos) > MaxTokenSize) ? string_view() : message.substr(pos, end - pos));
+    pos = end;
+  }
+}
+
+template <typename CharT>
+void PLogDrain<CharT>::add(std::string_view module, string_view message, uint64_t position) {
+  tokenize(message);
+  if (m_tokens.empty()) return;
+  ++m_total;
+
+  auto modIt = m_tree.find(module);
+  if (modIt == m_tree.end()) modIt = m_tree.emplace(std::string(module), ModuleNode()).first;
+
+  auto& lengthNode = modIt->second[m_tokens.size()];
+  auto  firstKey   = isWildcard(m_tokens.front()) ? string_view() : m_tokens.front();
+
+  auto leafIt = lengthNode.find(firstKey);
+  if (leafIt == lengthNode.end()) {
+    if (lengthNode.size() >= MaxChildren) firstKey = string_view();
+    leafIt = lengthNode.find(firstKey);
+    if (leafIt == lengthNode.end()) leafIt = lengthNode.emplace(string(firstKey), Leaf()).first;
+  }
+
+  Template* best       = nullptr;
+  size_t    bestSame   = 0;
+  size_t    bestParams = 0;
+  for (auto index: leafIt->second) {
+    auto&  tpl    = m_templates[index];
+    size_t same   = 0;
+    size_t params = 0;
+    for (size_t i = 0; i < m_tokens.size(); ++i) {
+      if (tpl.tokens[i].empty()) {
+        ++params;
+        if (isWildcard(m_tokens[i])) ++same;
+      } else if (!isWildcard(m_tokens[i]) && tpl.tokens[i] == m_tokens[i]) {
+        ++same;
+      }
+    }
+
+    if (best == nullptr || same > bestSame || (same == bestSame && params > bestParams)) {
+      best       = &tpl;
+      bestSame   = same;
+      bestParams = params;
+    }
+  }
+
+  if (best != nullptr && bestSame >= Similarity * m_tokens.size()) {
+    for (size_t i = 0; i < m_tokens.size(); ++i) {
+      if (!best->tokens[i].empty() && (isWildcard(m_tokens[i]) || best->tokens[i] != m_tokens[i])) best->tokens[i].clear();
+    }
+    ++best->count;
+    return;
+  }
+
+  if (m_templates.size() >= MaxTemplates || m_bytes >= m_maxBytes) {
+    ++m_unclustered;
+    return;
+  }
+
+  leafIt->second.push_back((uint32_t)m_templates.size());
+  auto& tpl = m_templates.emplace_back(Template {.module = std::string(module), .count = 1, .first = position});
+  tpl.tokens.reserve(m_tokens.size());
+  for (auto token: m_tokens)
+    tpl.tokens.emplace_back(isWildcard(token) ? string() : string(token));
+
+  m_bytes += sizeof(Template) + module.size() + 64; // 64 for the leaf entry and whatever tree nodes the template added
+  for (auto const& token: tpl.tokens)
+    m_bytes += sizeof(string) + token.size() * sizeof(CharT);
+}
+
+template <typename CharT>
+template <typename Conv>
+nlohmann::json PLogDrain<CharT>::dump(size_t n, Conv&& toUTF8) const {
+  std::unordered_map<std::string_view, std::vector<Template const*>> byModule;
+  for (auto const& tpl: m_templates)
+    byModule[tpl.module].push_back(&tpl);
+
+  auto modules = nlohmann::json::object();
+  for (auto& [module, order]: byModule) {
+    auto const count = std::min(n, order.size());
+    std::partial_sort(order.begin(), order.begin() + count, order.end(), [](Template const* a, Template const* b) { return a->count > b->count; });
+
+    auto& top = modules[std::string(module)] = nlohmann::json::array();
+    for (size_t i = 0; i < count; ++i) {
+      std::string text;
+      for (auto const& token: order[i]->tokens) {
+        if (!text.empty()) text.push_back(' ');
+        text += token.empty() ? std::string("<*>") : toUTF8(token);
+      }
+
+      top.push_back({
+          {"template", std::move(text)},
+          {"count", order[i]->count},
+          {"first", order[i]->first},
+      });
+    }
+  }
+
+  return {
+      {"total", m_total},
+      {"distinct", m_templates.size()},
+      {"unclustered", m_unclustered},
+      {"modules", std::move(modules)},
+  };
+}
+
+template <typename CharT>
+nlohmann::json PLogDrain<CharT>::save() const {
+  auto templates = nlohmann::json::array();
+  for (auto const& tpl: m_templates) {
+    auto tokens = nlohmann::json::array();
+    for (auto const& token: tpl.tokens)
+      tokens.push_back(saveToken(token));
+    templates.push_back({
+        {"module", tpl.module},
+        {"tokens", std::move(tokens)},
+        {"count", tpl.count},
+        {"first", tpl.first},
+    });
+  }
+
+  // Which leaf a template sits in depends on the order messages came in (the first token can turn into a wildcard later, leaves past
+  // MaxChildren share one), so the tree is saved as is rather than rebuilt from the templates
+  auto leaves = nlohmann::json::array();
+  for (auto const& [module, lengths]: m_tree) {
+    for (auto const& [length, firsts]: lengths) {
+      for (auto const& [first, leaf]: firsts)
+        leaves.push_back({module, length, saveToken(first), leaf});
+    }
+  }
+
+  return {
+      {"templates", std::move(templates)},
+      {"leaves", std::move(leaves)},
+      {"bytes", m_bytes},
+      {"total", m_total},
+      {"unclustered", m_unclustered},
+  };
+}
+
+template <typename CharT>
+bool PLogDrain<CharT>::load(nlohmann::json const& state) {
+  PLogDrain loaded(m_maxBytes);
+
+  try {
+    auto const& templates = state.at("templates");
+    if (templates.size() > MaxTemplates) return false;
+    for (auto const& fields: templates) {
+      auto& tpl = loaded.m_templates.emplace_back(Template {
+          .module = fields.at("module").get<std::string>(), .count = fields.at("count").get<uint64_t>(), .first = fields.at("first").get<uint64_t>()});
+      for (auto const& token: fields.at("tokens"))
+        tpl.tokens.push_back(loadToken(token));
+    }
+
+    for (auto const& fields: state.at("leaves")) {
+      auto const length = fields.at(1).get<size_t>();
+      auto&      leaf   = loaded.m_tree[fields.at(0).get<std::string>()][length][loadToken(fields.at(2))];
+      leaf              = fields.at(3).get<Leaf>();
+
+      // add() compares a message against the templates of its leaf token by token
+      for (auto index: leaf)
+        if (index >= loaded.m_templates.size() || loaded.m_templates[index].tokens.size() != length) return false;
+    }
+
+    loaded.m_bytes       = state.at("bytes").get<size_t>();
+    loaded.m_total       = state.at("total").get<uint64_t>();
+    loaded.m_unclustered = state.at("unclustered").get<uint64_t>();
+  } catch (nlohmann::json::exception const&) {
+    return false;
+  }
+
+  *this = std::move(loaded);
+  return true;
+}
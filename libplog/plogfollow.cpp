@@ -0,0 +1,79 @@
+#include "plogfollow.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+
+PLogFollower::PLogFollower(std::filesystem::path const& path, PLogOptions const& options)
+    : m_path(path), m_options(options), m_analyser(std::make_unique<PLogAnalyzer>(options)) {}
+
+bool PLogFollower::poll() {
+  std::error_code ec;
+  auto const      size = std::filesystem::file_size(m_path, ec);
+  if (ec) return true; // Gone for the moment, the emulator is about to write it anew
+
+  if (m_analyser != nullptr && size == m_size) return true; // Nothing new, the usual case
+  if (m_analyser == nullptr || size < m_size) m_analyser = std::make_unique<PLogAnalyzer>(m_options);
+  m_size = size;
+
+  std::ifstream file(m_path, std::ios::in | std::ios::binary); // Offsets have to be the file's own, text mode would eat the \r's
+  if (!file) return true;
+
+  file.seekg((std::streamoff)m_analyser->offset());
+  bool const keepGoing = m_analyser->readLines(file, true); // The last line is left for the next poll until its newline is there
+  publish(m_analyser->current());
+  return keepGoing;
+}
+
+void PLogFollower::publish(nlohmann::json const& report) {
+  auto array = [&report](char const* key) {
+    auto const it = report.find(key);
+    return it != report.end() && it->is_array() ? *it : nlohmann::json::array(); // Verdicts without any leave it null
+  };
+
+  auto config = nlohmann::json::object();
+  for (auto const& [key, value]: report.items())
+    if (!value.is_structured() && !value.is_null()) config[key] = value;
+
+  nlohmann::json values[std::size(m_topics)] = {array("labels"), array("hints"), std::move(config)};
+
+  bool changed = false;
+  {
+    std::lock_guard guard(m_lock);
+    for (size_t i = 0; i < std::size(m_topics); ++i) {
+      if (m_topics[i].id != 0 && m_topics[i].value == values[i]) continue;
+      m_topics[i].value = std::move(values[i]);
+      m_topics[i].id    = ++m_lastId;
+      changed           = true;
+    }
+  }
+  if (changed) m_changed.notify_all();
+}
+
+bool PLogFollower::wait(uint64_t after, std::chrono::milliseconds timeout, std::vector<Update>& updates) const {
+  std::unique_lock guard(m_lock);
+
+  bool const any = m_changed.wait_for(guard, timeout, [this, &after] {
+    if (after > m_lastId) after = 0; // An id of an earlier run, the viewer gets everything
+    return m_lastId > after;
+  });
+  if (!any) return false;
+
+  auto const first = updates.size();
+  for (auto const& topic: m_topics) {
+    if (topic.id <= after) continue;
+    updates.push_back({
+        .id    = topic.id,
+        .topic = topic.name,
+        .data  = topic.value.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace),
+    });
+  }
+  std::sort(updates.begin() + first, updates.end(), [](Update const& a, Update const& b) { return a.id < b.id; });
+  return true;
+}
+
+std::unique_ptr<PLogAnalyzer> PLogFollower::finish() {
+  m_analyser->finish();
+  return std::move(m_analyser);
+}
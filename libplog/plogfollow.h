@@ -0,0 +1,60 @@
+#pragma once
+
+#include "ploga.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Live analysis of a plog the emulator is still writing. poll() feeds the whole lines appended since the last call into the analyser
+// and compares the report as it stands with the one before, the parts viewers care about are kept as topics:
+//   labels, hints: the report's arrays
+//   config:        its plain values, title, emulator settings, user language and GPU
+// Every topic holds its latest value only, tagged with the update id it changed at. A viewer that passes the last id it has gets the
+// topics that changed since, a new one (id 0) gets all of them, so nothing piles up for viewers that are slow or gone.
+// A file that got shorter was started over (the emulator was run again), its analysis starts over as well
+
+class PLogFollower {
+  public:
+  struct Update {
+    uint64_t    id;
+    std::string topic;
+    std::string data; // JSON on one line
+  };
+
+  PLogFollower(std::filesystem::path const& path, PLogOptions const& options = {});
+
+  // Reads what was appended. Returns false once the rest of the log is of no interest, the emulator was stopped
+  bool poll();
+
+  // Waits up to timeout for topics that changed after the update id after. They are appended to updates ordered by id, returns false if
+  // there were none
+  bool wait(uint64_t after, std::chrono::milliseconds timeout, std::vector<Update>& updates) const;
+
+  // Finishes the analysis, the follower is done with it
+  std::unique_ptr<PLogAnalyzer> finish();
+
+  private:
+  struct Topic {
+    char const*    name;
+    nlohmann::json value;
+    uint64_t       id = 0; // Update it changed at, 0 while there is no value yet
+  };
+
+  void publish(nlohmann::json const& report);
+
+  std::filesystem::path         m_path;
+  PLogOptions                   m_options;
+  std::unique_ptr<PLogAnalyzer> m_analyser;
+  uint64_t                      m_size = 0; // Of the file when it was last read
+
+  mutable std::mutex              m_lock; // Viewers wait() on other threads
+  mutable std::condition_variable m_changed;
+  Topic                           m_topics[3] = {{"labels"}, {"hints"}, {"config"}};
+  uint64_t                        m_lastId    = 0;
+};
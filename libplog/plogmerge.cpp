@@ -0,0 +1,154 @@
+#include "plogmerge.h"
+
+#include <algorithm>
+#include <chrono>
+#include <istream>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace {
+// Timestamp is the 4th field of "channel;module;level;timestamp;..."
+std::string_view timestampField(std::string_view line) {
+  size_t start = 0;
+  for (int32_t i = 0; i < 3; ++i) {
+    start = line.find(';', start);
+    if (start == std::string_view::npos) return {};
+    ++start;
+  }
+
+  auto const end = line.find(';', start);
+  if (end == std::string_view::npos) return {};
+  return line.substr(start, end - start);
+}
+} // namespace
+
+PLogMerger::PLogMerger(std::vector<std::istream*> const& inputs): m_inputs(inputs), m_pending(inputs.size()) {
+  for (size_t i = 0; i < m_inputs.size(); ++i) {
+    if (fill(i)) m_heap.emplace(m_pending[i].time, i);
+  }
+}
+
+bool PLogMerger::decodeTimestamp(std::string_view timestamp, int64_t& time) {
+  uint64_t groups[8];
+  size_t   digits[8];
+  size_t   count = 0;
+
+  for (size_t i = 0; i < timestamp.size() && count < 8;) {
+    if (timestamp[i] < '0' || timestamp[i] > '9') {
+      ++i;
+      continue;
+    }
+
+    groups[count] = 0;
+    digits[count] = 0;
+    for (; i < timestamp.size() && timestamp[i] >= '0' && timestamp[i] <= '9'; ++i) {
+      if (digits[count]++ < 18) groups[count] = groups[count] * 10 + (timestamp[i] - '0');
+    }
+    ++count;
+  }
+
+  if (count < 3) return false;
+
+  // Either "YYYY-MM-DD HH:MM:SS[.frac]" or "HH:MM:SS[.frac]"
+  int64_t      days = 0;
+  size_t const tpos = count >= 6 ? 3 : 0;
+  if (tpos == 3) {
+    using namespace std::chrono;
+    days = sys_days(year((int32_t)groups[0]) / month((uint32_t)groups[1]) / day((uint32_t)groups[2])).time_since_epoch().count();
+  }
+
+  int64_t frac = 0;
+  if (count > tpos + 3) {
+    frac = (int64_t)groups[tpos + 3];
+    for (auto d = std::min<size_t>(digits[tpos + 3], 18); d < 6; ++d)
+      frac *= 10;
+    for (auto d = std::min<size_t>(digits[tpos + 3], 18); d > 6; --d)
+      frac /= 10;
+  }
+
+  time = (((days * 24 + (int64_t)groups[tpos]) * 60 + (int64_t)groups[tpos + 1]) * 60 + (int64_t)groups[tpos + 2]) * 1'000'000 + frac;
+  return true;
+}
+
+bool PLogMerger::fill(size_t source) {
+  auto& pending = m_pending[source];
+  if (!std::getline(*m_inputs[source], pending.line)) {
+    pending.line = std::string(); // Drop the capacity, the input is done
+    return false;
+  }
+
+  // Lines without a stamp (wrapped messages) stick to the line before them
+  int64_t time;
+  pending.continuation = !decodeTimestamp(timestampField(pending.line), time);
+  if (!pending.continuation) pending.time = time;
+  return true;
+}
+
+bool PLogMerger::next(size_t& source, std::string_view& line) {
+  if (m_current != SIZE_MAX && fill(m_current)) {
+    // Another input may have a line of the same time, a continuation must not wait behind it
+    if (m_pending[m_current].continuation) {
+      source = m_current;
+      line   = m_pending[m_current].line;
+      return true;
+    }
+    m_heap.emplace(m_pending[m_current].time, m_current);
+  }
+
+  if (m_heap.empty()) {
+    m_current = SIZE_MAX;
+    return false;
+  }
+
+  m_current = m_heap.top().second;
+  m_heap.pop();
+
+  source = m_current;
+  line   = m_pending[m_current].line;
+  return true;
+}
+
+std::string spitJoint(std::vector<std::unique_ptr<PLogAnalyzer>> const& analysers, std::function<void(size_t, nlohmann::json&)> const& link) {
+  nlohmann::json joint = {
+      {"type", "joint"},
+      {
+          "labels",
+          nlohmann::json::array(),
+      },
+      {
+          "hints",
+          nlohmann::json::array(),
+      },
+      {
+          "processes",
+          nlohmann::json::array(),
+      },
+  };
+
+  auto mergeUnique = [](nlohmann::json& dst, nlohmann::json const& src) {
+    for (auto const& item: src) {
+      if (std::find(dst.begin(), dst.end(), item) == dst.end()) dst.push_back(item);
+    }
+  };
+
+  for (size_t i = 0; i < analysers.size(); ++i) {
+    if (analysers[i] == nullptr) continue;
+
+    auto info = analysers[i]->info();
+    if (!info.contains("type")) continue; // Empty log, the process type was never guessed
+    if (link) link(i, info);
+
+    // The first process to report a field wins, sessions with several child processes run the same title anyway
+    for (auto const& [key, value]: info.items()) {
+      if (key == "type" || key == "labels" || key == "hints") continue;
+      if (!joint.contains(key)) joint[key] = value;
+    }
+
+    mergeUnique(joint["labels"], info["labels"]);
+    mergeUnique(joint["hints"], info["hints"]);
+    joint["processes"].push_back(std::move(info));
+  }
+
+  return joint.dump(2, ' ', true);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "ploga.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Interleaves the lines of several plogs by their timestamps. Only the next line of every input is kept in memory, inputs are
+// expected to be sorted by time on their own (which psOff's logger guarantees)
+class PLogMerger {
+  public:
+  PLogMerger(std::vector<std::istream*> const& inputs);
+
+  // line stays valid until the next call, returns false once all inputs are exhausted
+  bool next(size_t& source, std::string_view& line);
+
+  // Microseconds since the epoch (or since midnight for time-only stamps), false if there are no digits to decode
+  static bool decodeTimestamp(std::string_view timestamp, int64_t& time);
+
+  private:
+  struct Pending {
+    std::string line;
+    int64_t     time         = 0;
+    bool        continuation = false; // No stamp of its own, goes out right after the line before it
+  };
+
+  using HeapItem = std::pair<int64_t, size_t>; // (time, source), equal times keep the input order
+
+  bool fill(size_t source);
+
+  std::vector<std::istream*> m_inputs;
+  std::vector<Pending>       m_pending;
+
+  std::priority_queue<HeapItem, std::vector<HeapItem>, std::greater<HeapItem>> m_heap;
+
+  size_t m_current = SIZE_MAX; // Source of the line returned by the last next() call, refilled on the next one
+};
+
+// Folds the reports of one session's processes into a single one: main process fields (GPU, language) sit next to the child
+// process ones (title, firmware, emulator options), labels and hints are merged and every original report is kept under "processes".
+// link gets every report before it's folded in, with the index of its analyser
+EXPORT std::string spitJoint(std::vector<std::unique_ptr<PLogAnalyzer>> const& analysers,
+                             std::function<void(size_t, nlohmann::json&)> const& link = nullptr);
@@ -0,0 +1,575 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Regex subset for the rules: literals, '.', classes with ranges and negation, \d \w \s and their negations, \t \r \n (any other escaped
+// punctuation is taken literally), groups, alternation, ^ and $, and the ?, *, +, {n}, {n,}, {n,m} repeats. Patterns are ASCII and are
+// compared per code unit, wider code units only match '.' and negated classes.
+// There's no backtracking: the pattern is compiled into a Thompson NFA and sets of its states become DFA states as the text asks for them.
+// At most maxStates DFA states are cached, a full cache gets dropped and refilled from the current state on. Before the DFA runs, the text
+// is searched for the literals every match has to contain, so most lines are turned down by a plain find() and a pattern that is just
+// literal alternatives never gets to the DFA at all
+template <typename CharT>
+class PLogRegex {
+  public:
+  using string_view = std::basic_string_view<CharT>;
+
+  static constexpr size_t MaxStates    = 256;
+  static constexpr size_t MaxNfaStates = 4096; // Bounded repeats are unrolled, a pattern that grows past that is rejected
+  static constexpr size_t MaxRepeat    = 1000;
+
+  // Throws std::invalid_argument on a malformed pattern
+  explicit PLogRegex(std::string_view pattern, size_t maxStates = MaxStates);
+
+  // Whether the pattern matches anywhere in text
+  bool search(string_view text);
+
+  private:
+  // Code units up to 0xff are symbols of their own, wider ones share Other
+  static constexpr size_t Other   = 256;
+  static constexpr size_t Symbols = 257;
+
+  static constexpr size_t  Unbounded = SIZE_MAX;
+  static constexpr int32_t Unknown   = -1;
+
+  static constexpr uint8_t Accept    = 1; // DFA state flags, the search stops at either of the first two
+  static constexpr uint8_t Dead      = 2;
+  static constexpr uint8_t EndKnown  = 4; // Whether the state accepts at the end of the text was worked out, see endAccepts()
+  static constexpr uint8_t EndAccept = 8;
+
+  using SymbolSet = std::bitset<Symbols>;
+
+  struct Node {
+    enum Kind : uint8_t { Empty, Set, Cat, Alt, Repeat, Begin, End } kind = Empty;
+
+    SymbolSet         set   = {};
+    size_t            min   = 0, max = 0; // Repeat
+    std::vector<Node> items = {};
+  };
+
+  // Begin and End are the ^ and $ assertions. Begin is only passed at the start of the text, End stays in the DFA state until the text is
+  // over
+  struct NfaState {
+    enum Op : uint8_t { Match, Consume, Split, Begin, End } op;
+
+    uint32_t set  = 0; // Consume, index into m_sets
+    uint32_t out  = 0;
+    uint32_t out1 = 0; // Split
+  };
+
+  [[noreturn]] static void fail(std::string_view pattern, size_t pos, const char* what) {
+    throw std::invalid_argument("PLogRegex: " + std::string(what) + " at " + std::to_string(pos) + " in \"" + std::string(pattern) + "\"");
+  }
+
+  static SymbolSet units() {
+    SymbolSet set;
+    for (size_t i = 0; i <= Other; ++i)
+      set.set(i);
+    return set;
+  }
+
+  static Node parseAlt(std::string_view pattern, size_t& pos);
+  static Node parseCat(std::string_view pattern, size_t& pos);
+  static Node parseAtom(std::string_view pattern, size_t& pos);
+  static Node parseClass(std::string_view pattern, size_t& pos);
+  static int  parseEscape(std::string_view pattern, size_t& pos, SymbolSet& set); // The character, or -1 if it was a whole class
+  static bool parseRepeat(std::string_view pattern, size_t& pos, size_t& min, size_t& max);
+
+  void     prefilter(Node const& root);
+  uint32_t compile(Node const& node, uint32_t next);
+  uint32_t add(NfaState state);
+  void     splitClasses();
+
+  void     addClosure(uint32_t state, bool atBegin, bool atEnd);
+  uint32_t intern(std::vector<uint32_t> set);
+  uint32_t transition(uint32_t state, uint16_t cls);
+  bool     endAccepts(uint32_t state);
+
+  int32_t entry(uint32_t state) const {
+    return (int32_t)(state * m_classSymbol.size() * 2) | ((m_flags[state] & (Accept | Dead)) != 0 ? 1 : 0);
+  }
+
+  uint16_t classOf(CharT ch) const {
+    auto const unit = (std::make_unsigned_t<CharT>)ch;
+    return m_classOf[unit < Other ? unit : Other];
+  }
+
+  std::vector<std::basic_string<CharT>> m_literals;      // One of them is in every match, none means there's no prefilter
+  bool                                  m_exact = false; // The pattern is just the literals
+
+  std::vector<NfaState>  m_nfa;
+  std::vector<SymbolSet> m_sets;
+  uint32_t               m_nfaStart = 0;
+  bool                   m_anchored = false; // Every match starts with ^, the start states aren't added back at each position
+  bool                   m_empty    = false; // Matches the empty text, where ^ and $ both hold
+
+  std::array<uint16_t, Symbols> m_classOf = {}; // Symbols no consuming state tells apart share a class and a transition
+  std::vector<size_t>           m_classSymbol;  // One symbol of every class
+
+  // DFA cache, m_next has a row of m_classSymbol.size() transitions per state. A transition is the offset of the row of the state it leads
+  // to, times two, plus one if the search stops in that state. The scan then needs just one load per character
+  size_t                                    m_maxStates;
+  std::map<std::vector<uint32_t>, uint32_t> m_index;
+  std::vector<std::vector<uint32_t>>        m_states;
+  std::vector<uint8_t>                      m_flags;
+  std::vector<int32_t>                      m_next;
+  int32_t                                   m_initial = Unknown;
+  uint64_t                                  m_flushes = 0;
+
+  std::vector<uint32_t> m_marks; // Closure scratch, a state is visited when its mark is m_generation
+  std::vector<uint32_t> m_stack;
+  std::vector<uint32_t> m_closure;
+  uint32_t              m_generation = 0;
+};
+
+template <typename CharT>
+PLogRegex<CharT>::PLogRegex(std::string_view pattern, size_t maxStates): m_maxStates(std::max<size_t>(maxStates, 2)) {
+  size_t pos  = 0;
+  auto   root = parseAlt(pattern, pos);
+  if (pos != pattern.size()) fail(pattern, pos, "unbalanced ')'");
+
+  prefilter(root);
+
+  m_nfa.push_back({.op = NfaState::Match});
+  m_nfaStart = compile(root, 0);
+  m_marks.resize(m_nfa.size());
+
+  splitClasses();
+
+  ++m_generation;
+  m_closure.clear();
+  addClosure(m_nfaStart, false, false);
+  m_anchored = m_closure.empty();
+
+  ++m_generation;
+  m_closure.clear();
+  addClosure(m_nfaStart, true, true);
+  m_empty = std::find(m_closure.begin(), m_closure.end(), 0) != m_closure.end();
+}
+
+template <typename CharT>
+auto PLogRegex<CharT>::parseAlt(std::string_view pattern, size_t& pos) -> Node {
+  Node alt {.kind = Node::Alt};
+  alt.items.push_back(parseCat(pattern, pos));
+  while (pos < pattern.size() && pattern[pos] == '|') {
+    ++pos;
+    alt.items.push_back(parseCat(pattern, pos));
+  }
+
+  if (alt.items.size() == 1) return std::move(alt.items.front());
+  return alt;
+}
+
+template <typename CharT>
+auto PLogRegex<CharT>::parseCat(std::string_view pattern, size_t& pos) -> Node {
+  Node cat {.kind = Node::Cat};
+  while (pos < pattern.size() && pattern[pos] != '|' && pattern[pos] != ')') {
+    auto atom = parseAtom(pattern, pos);
+
+    for (size_t min, max; parseRepeat(pattern, pos, min, max);) {
+      Node repeat {.kind = Node::Repeat, .min = min, .max = max};
+      repeat.items.push_back(std::move(atom));
+      atom = std::move(repeat);
+    }
+
+    cat.items.push_back(std::move(atom));
+  }
+
+  if (cat.items.size() == 1) return std::move(cat.items.front());
+  return cat;
+}
+
+template <typename CharT>
+auto PLogRegex<CharT>::parseAtom(std::string_view pattern, size_t& pos) -> Node {
+  Node atom {.kind = Node::Set};
+
+  switch (auto const ch = pattern[pos++]) {
+    case '(': {
+      if (pattern.substr(pos).starts_with("?:")) pos += 2;
+      atom = parseAlt(pattern, pos);
+      if (pos >= pattern.size() || pattern[pos] != ')') fail(pattern, pos, "missing ')'");
+      ++pos;
+    } break;
+    case '[': {
+      atom = parseClass(pattern, pos);
+    } break;
+    case '.': {
+      atom.set = units();
+    } break;
+    case '^': {
+      atom.kind = Node::Begin;
+    } break;
+    case '$': {
+      atom.kind = Node::End;
+    } break;
+    case '\\': {
+      if (auto const single = parseEscape(pattern, pos, atom.set); single >= 0) atom.set.set(single);
+    } break;
+    case '?':
+    case '*':
+    case '+':
+    case '{': {
+      fail(pattern, pos - 1, "nothing to repeat");
+    } break;
+    default: {
+      atom.set.set((uint8_t)ch);
+    } break;
+  }
+
+  return atom;
+}
+
+template <typename CharT>
+auto PLogRegex<CharT>::parseClass(std::string_view pattern, size_t& pos) -> Node {
+  Node atom {.kind = Node::Set};
+
+  bool const negate = pos < pattern.size() && pattern[pos] == '^';
+  if (negate) ++pos;
+
+  // A ']' right after the opening bracket is a member, not the end
+  for (bool first = true; pos < pattern.size() && (first || pattern[pos] != ']'); first = false) {
+    auto item = [&]() -> int {
+      auto const ch = pattern[pos++];
+      return ch == '\\' ? parseEscape(pattern, pos, atom.set) : (uint8_t)ch;
+    };
+
+    auto const from = item();
+    if (from < 0) continue;
+
+    if (pos + 1 < pattern.size() && pattern[pos] == '-' && pattern[pos + 1] != ']') {
+      ++pos;
+      auto const to = item();
+      if (to < from) fail(pattern, pos - 1, "bad class range");
+      for (int ch = from; ch <= to; ++ch)
+        atom.set.set(ch);
+    } else {
+      atom.set.set(from);
+    }
+  }
+
+  if (pos >= pattern.size()) fail(pattern, pos, "missing ']'");
+  ++pos;
+
+  if (negate) atom.set = ~atom.set & units();
+  return atom;
+}
+
+template <typename CharT>
+int PLogRegex<CharT>::parseEscape(std::string_view pattern, size_t& pos, SymbolSet& set) {
+  if (pos >= pattern.size()) fail(pattern, pos, "trailing '\\'");
+
+  SymbolSet cls;
+  switch (auto const ch = pattern[pos++]) {
+    case 't': return '\t';
+    case 'r': return '\r';
+    case 'n': return '\n';
+    case 'd':
+    case 'D': {
+      for (int c = '0'; c <= '9'; ++c)
+        cls.set(c);
+      set |= ch == 'd' ? cls : ~cls & units();
+    } break;
+    case 'w':
+    case 'W': {
+      for (int c = 0; c < 0x80; ++c)
+        if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_') cls.set(c);
+      set |= ch == 'w' ? cls : ~cls & units();
+    } break;
+    case 's':
+    case 'S': {
+      for (int c: {' ', '\t', '\r', '\n', '\f', '\v'})
+        cls.set(c);
+      set |= ch == 's' ? cls : ~cls & units();
+    } break;
+    default: {
+      if ((ch >= '0' && ch <= '9') || (ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z')) fail(pattern, pos - 1, "unsupported escape");
+      return (uint8_t)ch;
+    }
+  }
+
+  return -1;
+}
+
+template <typename CharT>
+bool PLogRegex<CharT>::parseRepeat(std::string_view pattern, size_t& pos, size_t& min, size_t& max) {
+  if (pos >= pattern.size()) return false;
+
+  switch (pattern[pos]) {
+    case '?': min = 0, max = 1; break;
+    case '*': min = 0, max = Unbounded; break;
+    case '+': min = 1, max = Unbounded; break;
+    case '{': {
+      auto number = [&](size_t& value) {
+        auto const from = pos;
+        for (value = 0; pos < pattern.size() && pattern[pos] >= '0' && pattern[pos] <= '9'; ++pos) {
+          value = value * 10 + (pattern[pos] - '0');
+          if (value > MaxRepeat) fail(pattern, from, "repeat count is too big");
+        }
+        return pos > from;
+      };
+
+      ++pos;
+      if (!number(min)) fail(pattern, pos, "missing repeat count");
+      max = min;
+      if (pos < pattern.size() && pattern[pos] == ',') {
+        ++pos;
+        if (!number(max)) max = Unbounded;
+      }
+      if (pos >= pattern.size() || pattern[pos] != '}') fail(pattern, pos, "missing '}'");
+      if (max < min) fail(pattern, pos, "bad repeat range");
+    } break;
+    default: return false;
+  }
+
+  ++pos;
+  return true;
+}
+
+template <typename CharT>
+void PLogRegex<CharT>::prefilter(Node const& root) {
+  // The longest run of plain characters of every alternative, a match has to contain the one of its alternative
+  auto required = [](Node const& branch, bool& exact) {
+    std::basic_string<CharT> run, best;
+
+    auto flush = [&]() {
+      if (run.size() > best.size()) best = run;
+      run.clear();
+    };
+
+    auto const*  items = branch.kind == Node::Cat ? &branch.items : nullptr;
+    size_t const count = items != nullptr ? items->size() : 1;
+
+    exact = count > 0;
+    for (size_t i = 0; i < count; ++i) {
+      auto const& item = items != nullptr ? (*items)[i] : branch;
+      if (item.kind == Node::Set && item.set.count() == 1 && !item.set[Other]) {
+        for (size_t ch = 0; ch < Other; ++ch)
+          if (item.set[ch]) run.push_back((CharT)ch);
+      } else {
+        exact = false;
+        flush();
+      }
+    }
+
+    flush();
+    return best;
+  };
+
+  std::vector<Node> const single   = root.kind == Node::Alt ? std::vector<Node>() : std::vector<Node> {root};
+  auto const&             branches = root.kind == Node::Alt ? root.items : single;
+
+  m_exact = true;
+  for (auto const& branch: branches) {
+    bool exact;
+    auto literal = required(branch, exact);
+    if (literal.empty()) {
+      m_literals.clear();
+      m_exact = false;
+      return;
+    }
+
+    m_literals.push_back(std::move(literal));
+    m_exact = m_exact && exact;
+  }
+}
+
+template <typename CharT>
+uint32_t PLogRegex<CharT>::add(NfaState state) {
+  if (m_nfa.size() >= MaxNfaStates) throw std::invalid_argument("PLogRegex: pattern is too big");
+  m_nfa.push_back(state);
+  return (uint32_t)m_nfa.size() - 1;
+}
+
+template <typename CharT>
+uint32_t PLogRegex<CharT>::compile(Node const& node, uint32_t next) {
+  // Built back to front, every piece gets the state that follows it
+  switch (node.kind) {
+    case Node::Empty: return next;
+    case Node::Set: {
+      m_sets.push_back(node.set);
+      return add({.op = NfaState::Consume, .set = (uint32_t)m_sets.size() - 1, .out = next});
+    }
+    case Node::Begin: return add({.op = NfaState::Begin, .out = next});
+    case Node::End: return add({.op = NfaState::End, .out = next});
+    case Node::Cat: {
+      for (auto it = node.items.rbegin(); it != node.items.rend(); ++it)
+        next = compile(*it, next);
+      return next;
+    }
+    case Node::Alt: {
+      auto result = compile(node.items.back(), next);
+      for (size_t i = node.items.size() - 1; i-- > 0;)
+        result = add({.op = NfaState::Split, .out = compile(node.items[i], next), .out1 = result});
+      return result;
+    }
+    case Node::Repeat: {
+      auto const& item = node.items.front();
+
+      uint32_t tail = next;
+      if (node.max == Unbounded) {
+        tail            = add({.op = NfaState::Split, .out1 = next});
+        m_nfa[tail].out = compile(item, tail);
+      } else {
+        for (size_t i = node.min; i < node.max; ++i)
+          tail = add({.op = NfaState::Split, .out = compile(item, tail), .out1 = next});
+      }
+
+      for (size_t i = 0; i < node.min; ++i)
+        tail = compile(item, tail);
+      return tail;
+    }
+  }
+
+  return next;
+}
+
+template <typename CharT>
+void PLogRegex<CharT>::splitClasses() {
+  std::map<std::vector<bool>, uint16_t> classes;
+  for (size_t symbol = 0; symbol < Symbols; ++symbol) {
+    std::vector<bool> signature(m_sets.size());
+    for (size_t i = 0; i < m_sets.size(); ++i)
+      signature[i] = m_sets[i][symbol];
+
+    auto const [it, inserted] = classes.emplace(std::move(signature), (uint16_t)m_classSymbol.size());
+    if (inserted) m_classSymbol.push_back(symbol);
+    m_classOf[symbol] = it->second;
+  }
+}
+
+template <typename CharT>
+void PLogRegex<CharT>::addClosure(uint32_t state, bool atBegin, bool atEnd) {
+  m_stack.push_back(state);
+  while (!m_stack.empty()) {
+    auto const current = m_stack.back();
+    m_stack.pop_back();
+    if (m_marks[current] == m_generation) continue;
+    m_marks[current] = m_generation;
+
+    auto const& nfa = m_nfa[current];
+    switch (nfa.op) {
+      case NfaState::Split: {
+        m_stack.push_back(nfa.out1);
+        m_stack.push_back(nfa.out);
+      } break;
+      case NfaState::Begin: {
+        if (atBegin) m_stack.push_back(nfa.out);
+      } break;
+      case NfaState::End: {
+        m_closure.push_back(current);
+        if (atEnd) m_stack.push_back(nfa.out);
+      } break;
+      default: {
+        m_closure.push_back(current);
+      } break;
+    }
+  }
+}
+
+template <typename CharT>
+uint32_t PLogRegex<CharT>::intern(std::vector<uint32_t> set) {
+  std::sort(set.begin(), set.end());
+  if (auto const it = m_index.find(set); it != m_index.end()) return it->second;
+
+  if (m_states.size() >= m_maxStates) {
+    m_index.clear();
+    m_states.clear();
+    m_flags.clear();
+    m_next.clear();
+    m_initial = Unknown;
+    ++m_flushes;
+  }
+
+  uint8_t flags = set.empty() ? Dead : 0;
+  if (!set.empty() && set.front() == 0) flags |= Accept; // State 0 is the NFA match
+
+  auto const id = (uint32_t)m_states.size();
+  m_flags.push_back(flags);
+  m_next.resize(m_next.size() + m_classSymbol.size(), Unknown);
+  m_index.emplace(set, id);
+  m_states.push_back(std::move(set));
+  return id;
+}
+
+template <typename CharT>
+uint32_t PLogRegex<CharT>::transition(uint32_t state, uint16_t cls) {
+  auto const symbol = m_classSymbol[cls];
+
+  ++m_generation;
+  m_closure.clear();
+  for (auto nfa: m_states[state]) {
+    if (m_nfa[nfa].op == NfaState::Consume && m_sets[m_nfa[nfa].set][symbol]) addClosure(m_nfa[nfa].out, false, false);
+  }
+  if (!m_anchored) addClosure(m_nfaStart, false, false);
+
+  // A flush renumbers the states, the row of the old one is gone then
+  auto const flushes = m_flushes;
+  auto const next    = intern(m_closure);
+  if (m_flushes == flushes) m_next[state * m_classSymbol.size() + cls] = entry(next);
+  return next;
+}
+
+template <typename CharT>
+bool PLogRegex<CharT>::search(string_view text) {
+  if (!m_literals.empty()) {
+    if (std::none_of(m_literals.begin(), m_literals.end(), [text](auto const& literal) { return text.find(literal) != string_view::npos; }))
+      return false;
+    if (m_exact) return true;
+  }
+
+  if (text.empty()) return m_empty;
+
+  if (m_initial == Unknown) {
+    ++m_generation;
+    m_closure.clear();
+    addClosure(m_nfaStart, true, false);
+    m_initial = (int32_t)intern(m_closure);
+  }
+
+  auto const stride = m_classSymbol.size();
+  auto       state  = (uint32_t)m_initial;
+  if (m_flags[state] & (Accept | Dead)) return m_flags[state] & Accept;
+
+  auto const* next = m_next.data();
+  size_t      row  = state * stride;
+  for (auto ch: text) {
+    auto const cls = classOf(ch);
+    auto       to  = next[row + cls];
+    if (to == Unknown) {
+      to   = entry(transition((uint32_t)(row / stride), cls));
+      next = m_next.data();
+    }
+
+    row = (uint32_t)to >> 1;
+    if (to & 1) return m_flags[row / stride] & Accept;
+  }
+
+  return endAccepts((uint32_t)(row / stride));
+}
+
+template <typename CharT>
+bool PLogRegex<CharT>::endAccepts(uint32_t state) {
+  auto& flags = m_flags[state];
+  if (flags & EndKnown) return flags & EndAccept;
+
+  // The text is over, every $ holds now. The text isn't empty (search() knows the answer for that), so no ^ does
+  ++m_generation;
+  m_closure.clear();
+  for (auto nfa: m_states[state]) {
+    if (m_nfa[nfa].op == NfaState::End) addClosure(nfa, false, true);
+  }
+
+  flags |= EndKnown;
+  if (std::find(m_closure.begin(), m_closure.end(), 0) != m_closure.end()) flags |= EndAccept;
+  return flags & EndAccept;
+}
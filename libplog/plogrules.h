@@ -0,0 +1,786 @@
+#pragma once
+
+#include "plogdrain.h"
+#include "plogregex.h"
+#include "plogtally.h"
+#include "third_party/json.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_set>
+
+// ASCII literal that converts to a string_view of any character type, so one rule body serves both char and char16_t logs
+template <typename CharT, size_t N>
+struct PLogLiteral {
+  CharT data[N];
+
+  consteval PLogLiteral(const char (&str)[N]) {
+    for (size_t i = 0; i < N; ++i)
+      data[i] = (CharT)str[i];
+  }
+
+  constexpr operator std::basic_string_view<CharT>() const { return {data, N - 1}; }
+};
+
+// Opt-in passes on top of the labels and hints, the defaults keep the plain report
+struct PLogOptions {
+  bool   templates    = false; // Mine message templates (see PLogDrain), costs a tokenization per line
+  size_t memoryBudget = 0;     // Bytes the analysis may hold on to whatever the input size (see PLogBudget), 0 is unbounded
+
+  // Partial reports while the log is still being read, see PLogRules::tick(). They carry "partial": {"lines": n}, the final report
+  // is only returned the usual way. Called on the analysing thread
+  std::function<void(nlohmann::json const&)> progress;
+  uint64_t                                   progressLines = 1000000;
+
+  // Options for one of parts analyses alive at the same time, they split the budget between them
+  PLogOptions share(size_t parts) const {
+    auto part = *this;
+    if (memoryBudget != 0 && parts > 1) part.memoryBudget = std::max<size_t>(memoryBudget / parts, 1);
+    return part;
+  }
+};
+
+// How PLogOptions::memoryBudget is split between the parts of an analysis that grow with the input. Whatever doesn't fit is dropped and
+// counted in the "truncated" object of the report. The fixed costs (context rings, tallies, the report itself) take about a megabyte, so
+// budgets below Minimum are raised to it
+struct PLogBudget {
+  static constexpr size_t Minimum = 4 * 1024 * 1024;
+
+  size_t lineBytes        = SIZE_MAX; // Longer lines are cut, the rest of them is skipped
+  size_t firmwareBytes    = SIZE_MAX; // Names in the firmware list
+  size_t templateBytes    = SIZE_MAX; // Mined templates, see PLogDrain and PLogProfile
+  size_t batchBytes       = SIZE_MAX; // p7d chunks copied out of the input per batch
+  size_t descriptionBytes = SIZE_MAX; // p7d line descriptions, per channel
+
+  constexpr PLogBudget(size_t budget) {
+    if (budget == 0) return;
+    budget = std::max(budget, Minimum);
+
+    lineBytes        = budget / 16;
+    firmwareBytes    = budget / 32;
+    templateBytes    = budget / 4;
+    batchBytes       = budget / 8;
+    descriptionBytes = budget / 8;
+  }
+};
+
+// What the rules found out, PLogRules inherits the bits so the rule bodies name them directly
+struct PLogFlags {
+  // psOff specific
+  bool _processTypeGuessed : 1 = false;
+  bool _isChildprocess     : 1 = false;
+  bool _isGpuPicked        : 1 = false;
+
+  // Hints
+  bool _inputNotFoundHint  : 1 = false;
+  bool _nvidiaHint         : 1 = false;
+  bool _hintTrophyKey      : 1 = false;
+  bool _hintAndnPatched    : 1 = false;
+  bool _hintInsertqPatched : 1 = false;
+  bool _hintExtrqPatched   : 1 = false;
+  bool _hintAjmFound       : 1 = false;
+
+  // Game engines
+  bool _unityEngineDetected    : 1 = false;
+  bool _cryEngineDetected      : 1 = false;
+  bool _unrealEngineDetected   : 1 = false;
+  bool _phyreEngineDetected    : 1 = false;
+  bool _gmakerEngineDetected   : 1 = false;
+  bool _naughtyEngineDetected  : 1 = false;
+  bool _irrlichtEngineDetected : 1 = false;
+
+  // SDKs
+  bool _fmodSdkDetected   : 1 = false;
+  bool _monoSdkDetected   : 1 = false;
+  bool _criSdkDetected    : 1 = false;
+  bool _havokSdkDetected  : 1 = false;
+  bool _wwiseSdkDetected  : 1 = false;
+  bool _dialogSdkDetected : 1 = false;
+
+  // Problems
+  bool _shaderGenTodo         : 1 = false;
+  bool _vkValidation          : 1 = false;
+  bool _exceptionDetected     : 1 = false;
+  bool _netStuffDetected      : 1 = false;
+  bool _vkNoDevices           : 1 = false;
+  bool _missingSymbolDetected : 1 = false;
+
+  // Progress
+  bool _titleIdSeen        : 1 = false;
+  bool _titleNameSeen      : 1 = false;
+  bool _gpuSeen            : 1 = false;
+  bool _headerPublished    : 1 = false;
+  bool _exceptionPublished : 1 = false;
+};
+
+// Where a label or hint was decided, line is 0 while it wasn't
+struct PLogEvidence {
+  uint64_t offset = 0;
+  uint64_t line   = 0;
+};
+
+// Flags that end up as labels or hints, in the report under the label name or a hint-* name
+struct PLogEvidenceFlag {
+  const char* name;
+  bool (*isSet)(PLogFlags const& flags);
+};
+
+inline constexpr PLogEvidenceFlag PLogEvidenceFlags[] = {
+    {"engine-unity", [](PLogFlags const& f) -> bool { return f._unityEngineDetected; }},
+    {"engine-unreal", [](PLogFlags const& f) -> bool { return f._unrealEngineDetected; }},
+    {"engine-cry", [](PLogFlags const& f) -> bool { return f._cryEngineDetected; }},
+    {"engine-phyre", [](PLogFlags const& f) -> bool { return f._phyreEngineDetected; }},
+    {"engine-gamemaker", [](PLogFlags const& f) -> bool { return f._gmakerEngineDetected; }},
+    {"engine-naughty", [](PLogFlags const& f) -> bool { return f._naughtyEngineDetected; }},
+    {"engine-irrlicht", [](PLogFlags const& f) -> bool { return f._irrlichtEngineDetected; }},
+    {"exception", [](PLogFlags const& f) -> bool { return f._exceptionDetected; }},
+    {"sdk-fmod", [](PLogFlags const& f) -> bool { return f._fmodSdkDetected; }},
+    {"sdk-mono", [](PLogFlags const& f) -> bool { return f._monoSdkDetected; }},
+    {"sdk-criware", [](PLogFlags const& f) -> bool { return f._criSdkDetected; }},
+    {"sdk-havok", [](PLogFlags const& f) -> bool { return f._havokSdkDetected; }},
+    {"sdk-wwise", [](PLogFlags const& f) -> bool { return f._wwiseSdkDetected; }},
+    {"missing-symbol", [](PLogFlags const& f) -> bool { return f._missingSymbolDetected; }},
+    {"graphics", [](PLogFlags const& f) -> bool { return f._vkValidation; }},
+    {"shader-gen", [](PLogFlags const& f) -> bool { return f._shaderGenTodo; }},
+    {"badgpu", [](PLogFlags const& f) -> bool { return f._vkNoDevices; }},
+    {"hint-input-device", [](PLogFlags const& f) -> bool { return f._inputNotFoundHint; }},
+    {"hint-nvidia", [](PLogFlags const& f) -> bool { return f._nvidiaHint; }},
+    {"hint-trophy-key", [](PLogFlags const& f) -> bool { return f._hintTrophyKey; }},
+    {"hint-andn-patched", [](PLogFlags const& f) -> bool { return f._hintAndnPatched; }},
+    {"hint-insertq-patched", [](PLogFlags const& f) -> bool { return f._hintInsertqPatched; }},
+    {"hint-extrq-patched", [](PLogFlags const& f) -> bool { return f._hintExtrqPatched; }},
+    {"hint-ajm", [](PLogFlags const& f) -> bool { return f._hintAjmFound; }},
+};
+
+// Detection rules shared by the plog (char) and p7d (char16_t) analysers. The process type is known after the first line, from then on
+// render() jumps straight into the rule set compiled for that process type
+template <typename CharT>
+class PLogRules: public PLogFlags {
+  public:
+  using string_view = std::basic_string_view<CharT>;
+
+
+  PLogRules(PLogOptions const& options = {})
+      : m_bounded(options.memoryBudget != 0), m_firmwareLeft(PLogBudget(options.memoryBudget).firmwareBytes), m_progress(options.progress),
+        m_progressLines(std::max<uint64_t>(options.progressLines, 1)), m_nextSnapshot(m_progressLines) {
+    if (options.templates) m_templates = std::make_unique<PLogDrain<CharT>>(PLogBudget(options.memoryBudget).templateBytes);
+  }
+
+  void setProcessType(bool isChild);
+
+  // Where the next rendered line is: byte offset and number for plogs, trace index and number for p7d dumps
+  void setLinePosition(uint64_t offset, uint64_t line) {
+    m_lineOffset = offset;
+    m_lineNumber = line;
+  }
+
+  // module is "TTY" for the game's own output. Returns false once the rest of the log is unrelated to the game
+  bool render(std::string_view module, string_view out) {
+    if (m_templates != nullptr) m_templates->add(module, out, m_lineOffset);
+
+    // Flags are rarely set, a changed word is all it takes to know the line is evidence for one of them
+    auto const before    = flagBits();
+    bool const keepGoing = (this->*m_render)(module, out);
+    if (flagBits() != before) recordEvidence();
+    return keepGoing;
+  }
+
+  // Turns the collected flags into labels and hints
+  void finalize();
+
+  nlohmann::json const& info() const { return m_jsonInfo; }
+
+  // Report with the labels and hints as they stand, for analyses that aren't finalize()d yet
+  nlohmann::json current() const;
+
+  // Report fields the analysers collect on their own, outside of the rules
+  void attach(std::string_view key, nlohmann::json value) { m_jsonInfo[std::string(key)] = std::move(value); }
+
+  // Things the memory budget made the analysis drop, reported as "truncated": {what: count}
+  void markTruncated(std::string_view what, uint64_t count) { markTruncated(m_jsonInfo, what, count); }
+
+  // Analysers call it after every rendered line. Publishes a partial report to PLogOptions::progress once the title (or the GPU, for
+  // main process logs) is known, on the first exception, and every progressLines lines in between
+  void tick() {
+    if (!m_progress) return;
+
+    bool const header = !_headerPublished && (_isChildprocess ? _titleIdSeen && _titleNameSeen : _gpuSeen);
+    bool const crash  = !_exceptionPublished && _exceptionDetected;
+    if (++m_ticks < m_nextSnapshot && !header && !crash) return;
+
+    _headerPublished |= header;
+    _exceptionPublished |= crash;
+    publish();
+  }
+
+  static std::string toUTF8(string_view str);
+
+  // Problem lines, exports that mark them (see PLogTraceWriter) match them the same way. Child process logs: a crash and a missing
+  // symbol, what follows "Missing Symbol|"
+  static bool isException(std::string_view module, string_view out) { return module == "ExceptionHandler" && out.starts_with(lit("Faulty instruction:")); }
+
+  static std::optional<string_view> missingSymbol(std::string_view module, string_view out) {
+    if (module != "runtime") return std::nullopt;
+    auto const pos = out.find(lit("Missing Symbol|"));
+    return pos != string_view::npos ? std::optional(out.substr(pos + 15)) : std::nullopt;
+  }
+
+  // Main process logs: what follows "Validation Error: "
+  static std::optional<string_view> validationError(std::string_view module, string_view out) {
+    if (module != "videoout") return std::nullopt;
+    auto const pos = out.find(lit("Validation Error: "));
+    return pos != string_view::npos ? std::optional(out.substr(pos + 18)) : std::nullopt;
+  }
+
+  // Checkpoint of an analysis that wasn't finalize()d yet, load() replaces the state with it. Options aren't part of it, but a
+  // checkpoint without templates can't continue an analysis that mines them
+  nlohmann::json save() const;
+  bool           load(nlohmann::json const& state);
+
+  private:
+  using RenderFunc = bool (PLogRules::*)(std::string_view, string_view);
+
+  template <size_t N>
+  static consteval PLogLiteral<CharT, N> lit(const char (&str)[N]) {
+    return str;
+  }
+
+  // Plog files have no header, their first line tells the process type
+  bool renderFirstLine(std::string_view module, string_view out) {
+    setProcessType(out == lit("child process"));
+    return true;
+  }
+
+  template <bool IsChild>
+  bool renderProcess(std::string_view module, string_view out);
+
+  bool renderNothing(std::string_view module, string_view out) { return false; }
+
+  // "[ VUID-... ]" or "MessageID = 0x..." of a validation message
+  static string_view validationId(string_view message);
+
+  void addFirmware(std::string name);
+
+  uint64_t flagBits() const {
+    static_assert(sizeof(PLogFlags) <= sizeof(uint64_t));
+
+    uint64_t bits = 0;
+    std::memcpy(&bits, static_cast<PLogFlags const*>(this), sizeof(PLogFlags));
+    return bits;
+  }
+
+  void recordEvidence();
+
+  // Labels, hints and the tallies as they stand, the part of the report finalize() adds
+  void addVerdict(nlohmann::json& report) const;
+
+  void publish();
+
+  static void markTruncated(nlohmann::json& report, std::string_view what, uint64_t count) {
+    if (count > 0) report["truncated"][std::string(what)] = count;
+  }
+
+  nlohmann::json m_jsonInfo;
+  RenderFunc     m_render     = &PLogRules::renderFirstLine;
+  uint64_t       m_lineOffset = 0;
+  uint64_t       m_lineNumber = 0;
+  bool           m_bounded;
+
+  std::unordered_set<std::string> m_firmware; // Libraries get loaded more than once, the report lists them once
+  size_t                          m_firmwareLeft;
+  uint64_t                        m_firmwareDropped = 0;
+
+  std::array<PLogEvidence, std::size(PLogEvidenceFlags)> m_evidence;
+
+  PLogTally<CharT, 1024> m_missingSymbols;
+  PLogTally<CharT, 1024> m_todoCalls; // Can be spammed millions of times, past 1024 names only the heavy hitters matter
+  PLogTally<CharT, 1024> m_vkValidationIds;
+
+  std::unique_ptr<PLogDrain<CharT>> m_templates;
+
+  // Signatures with alternatives in them, see PLogRegex
+  PLogRegex<CharT> m_naughtyTty {"ND File Server|----- Switching world: from"};
+  PLogRegex<CharT> m_unrealProject {R"(^Additional.*\.uproject)"};
+  PLogRegex<CharT> m_unityThread {"Unity(Worker|Gfx)"};
+  PLogRegex<CharT> m_criThread {"CriThread|CRI FS"};
+  PLogRegex<CharT> m_wwiseThread {"Wwise|AK::LibAudioOut"};
+  PLogRegex<CharT> m_monoConfig {R"(\.mono[\\/]config)"};
+  PLogRegex<CharT> m_nvidiaGpu {"NVIDIA|nvidia"};
+  PLogRegex<CharT> m_shaderGenTodo {"todo|Instruction missing"};
+
+  std::function<void(nlohmann::json const&)> m_progress;
+  uint64_t                                   m_progressLines;
+  uint64_t                                   m_nextSnapshot;
+  uint64_t                                   m_ticks = 0;
+};
+
+template <typename CharT>
+std::string PLogRules<CharT>::toUTF8(string_view str) {
+  if constexpr (std::is_same_v<CharT, char>) {
+    return std::string(str);
+  } else {
+    std::string result;
+    result.reserve(str.size());
+
+    for (size_t i = 0; i < str.size(); ++i) {
+      uint32_t cp = str[i];
+
+      if (cp >= 0xd800 && cp <= 0xdbff && (i + 1) < str.size() && str[i + 1] >= 0xdc00 && str[i + 1] <= 0xdfff) {
+        cp = 0x10000 + ((cp - 0xd800) << 10) + (str[++i] - 0xdc00);
+      }
+
+      if (cp < 0x80) {
+        result.push_back((char)cp);
+      } else if (cp < 0x800) {
+        result.push_back((char)(0xc0 | (cp >> 6)));
+        result.push_back((char)(0x80 | (cp & 0x3f)));
+      } else if (cp < 0x10000) {
+        result.push_back((char)(0xe0 | (cp >> 12)));
+        result.push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+        result.push_back((char)(0x80 | (cp & 0x3f)));
+      } else {
+        result.push_back((char)(0xf0 | (cp >> 18)));
+        result.push_back((char)(0x80 | ((cp >> 12) & 0x3f)));
+        result.push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+        result.push_back((char)(0x80 | (cp & 0x3f)));
+      }
+    }
+
+    return result;
+  }
+}
+
+template <typename CharT>
+auto PLogRules<CharT>::validationId(string_view message) -> string_view {
+  auto trim = [](string_view id) {
+    while (!id.empty() && id.front() == ' ')
+      id.remove_prefix(1);
+    while (!id.empty() && id.back() == ' ')
+      id.remove_suffix(1);
+    return id;
+  };
+
+  if (message.starts_with(lit("["))) {
+    if (auto const end = message.find(']'); end != string_view::npos) {
+      if (auto const id = trim(message.substr(1, end - 1)); !id.empty()) return id;
+    }
+  }
+
+  if (auto const pos = message.find(lit("MessageID = ")); pos != string_view::npos) {
+    auto const id = message.substr(pos + 12);
+    return id.substr(0, id.find_first_of(lit(" |")));
+  }
+
+  static constexpr auto unknown = lit("unknown"); // Returning a temporary literal would dangle
+  return unknown;
+}
+
+template <typename CharT>
+void PLogRules<CharT>::addFirmware(std::string name) {
+  auto const cost = name.size() * 2 + 64; // Set node plus the copy in the report
+  if (m_firmware.contains(name)) return;
+  if (cost > m_firmwareLeft) {
+    ++m_firmwareDropped;
+    return;
+  }
+
+  m_firmwareLeft -= cost;
+  m_jsonInfo["firmware"].push_back(name);
+  m_firmware.insert(std::move(name));
+}
+
+template <typename CharT>
+void PLogRules<CharT>::recordEvidence() {
+  for (size_t i = 0; i < m_evidence.size(); ++i) {
+    if (m_evidence[i].line == 0 && PLogEvidenceFlags[i].isSet(*this)) m_evidence[i] = {.offset = m_lineOffset, .line = m_lineNumber};
+  }
+}
+
+template <typename CharT>
+void PLogRules<CharT>::setProcessType(bool isChild) {
+  _processTypeGuessed = true;
+
+  if ((_isChildprocess = isChild) == true) { // Prepare child process things
+    m_jsonInfo = {
+        {"type", "child-process"},
+        {
+            "labels",
+            nlohmann::json::array(),
+        },
+        {
+            "firmware",
+            nlohmann::json::array(),
+        },
+        {
+            "hints",
+            nlohmann::json::array(),
+        },
+        {"emu_neo", false},
+        {"emu_skipAjm", false},
+        {"emu_skipMovies", false},
+        {"emu_networking", false},
+        {"emu_noElfCheck", false},
+        {"title_name", "Unnamed"},
+        {"title_id", "CUSA00000"},
+        {"title_neo", false},
+    };
+    m_render = &PLogRules::renderProcess<true>;
+  } else { // Prepare main process things
+    m_jsonInfo = {
+        {"type", "main-process"},
+        {
+            "labels",
+            nlohmann::json::array(),
+        },
+        {
+            "hints",
+            nlohmann::json::array(),
+        },
+        {"user-gpu", "UNDETECTED"},
+        {"user-lang", "UNDETECTED"},
+    };
+    m_render = &PLogRules::renderProcess<false>;
+  }
+}
+
+template <typename CharT>
+template <bool IsChild>
+bool PLogRules<CharT>::renderProcess(std::string_view module, string_view out) {
+  if constexpr (IsChild) { // Handle child logs
+    if (module == "TTY") {
+      if (!_gmakerEngineDetected && out.contains(lit("YoYo Games PS4 Runner"))) _gmakerEngineDetected = true;
+      if (!_irrlichtEngineDetected && out.contains(lit("Irrlicht Engine"))) _irrlichtEngineDetected = true;
+      if (!_unrealEngineDetected && m_unrealProject.search(out)) _unrealEngineDetected = true;
+      if (!_unrealEngineDetected && out.contains(lit("uecommandline.txt"))) _unrealEngineDetected = true;
+      if (!_naughtyEngineDetected && m_naughtyTty.search(out)) _naughtyEngineDetected = true;
+    } else {
+      if (out.starts_with(lit("todo "))) {
+        if (!_netStuffDetected && out.starts_with(lit("todo sceNp"))) _netStuffDetected = true;
+
+        size_t nameEnd = 5;
+        while (nameEnd < out.size() && out[nameEnd] != ' ' && out[nameEnd] != '(' && out[nameEnd] != ':')
+          ++nameEnd;
+        if (nameEnd > 5) m_todoCalls.add(out.substr(5, nameEnd - 5), m_lineOffset);
+        return true;
+      }
+
+      if (module == "pthread") {
+        if (out.starts_with(lit("--> thread"))) { // Thread run log
+          if (!_unityEngineDetected) {
+            if (m_unityThread.search(out)) _unityEngineDetected = true;
+          }
+          if (!_criSdkDetected) {
+            if (m_criThread.search(out)) _criSdkDetected = true;
+          }
+          if (!_wwiseSdkDetected) {
+            if (m_wwiseThread.search(out)) _wwiseSdkDetected = true;
+          }
+          if (!_phyreEngineDetected) {
+            if (out.contains(lit("PhyreEngine"))) _phyreEngineDetected = true;
+          }
+          if (!_fmodSdkDetected) {
+            if (out.contains(lit("FMOD mixer"))) _fmodSdkDetected = true;
+          }
+          if (!_havokSdkDetected) {
+            if (out.contains(lit("HavokWorkerThread"))) _havokSdkDetected = true;
+          }
+        }
+      } else if (module == "libSceKernel") {
+        if (!_monoSdkDetected) {
+          if (m_monoConfig.search(out)) _monoSdkDetected = true;
+        }
+        if (!_unityEngineDetected) {
+          if (out.contains(lit("unity default resources"))) _unityEngineDetected = true;
+        }
+        if (!_unrealEngineDetected) {
+          if (out.contains(lit("UE3_logo."))) _unrealEngineDetected = true;
+        }
+      } else if (module == "runtime") {
+        if (auto const symbol = missingSymbol(module, out)) {
+          _missingSymbolDetected = true;
+          m_missingSymbols.add(*symbol, m_lineOffset);
+        }
+      } else if (module == "Kernel") {
+        if (out == lit("-> client shutdown request")) {
+          // Stop processing log lines after the Stop button press
+          // the rest is unrelated to the game itself.
+          m_render = &PLogRules::renderNothing;
+          return false;
+        }
+        if (out.starts_with(lit("psOff."))) {
+          auto value = out.substr(out.find_first_of('=') + 2);
+
+          if (out.contains(lit(".isNeo = ")))
+            m_jsonInfo["emu_neo"] = value == lit("1");
+          else if (out.contains(lit(".skipAJM = ")))
+            m_jsonInfo["emu_skipAjm"] = value == lit("1");
+          else if (out.contains(lit(".skipMovies = ")))
+            m_jsonInfo["emu_skipMovies"] = value == lit("1");
+          else if (out.contains(lit(".networking = ")))
+            m_jsonInfo["emu_networking"] = value == lit("1");
+          else if (out.contains(lit(".noElfCheck = ")))
+            m_jsonInfo["emu_noElfCheck"] = value == lit("1");
+          else if (out.contains(lit(".app.neoSupport = ")))
+            m_jsonInfo["title_neo"] = value == lit("1");
+          else if (out.contains(lit(".app.id = "))) {
+            m_jsonInfo["title_id"] = toUTF8(value);
+            _titleIdSeen           = true;
+          } else if (out.contains(lit(".app.title = "))) {
+            m_jsonInfo["title_name"] = toUTF8(value);
+            _titleNameSeen           = true;
+          }
+        }
+      } else if (module == "ExceptionHandler") {
+        if (!_exceptionDetected && isException(module, out)) _exceptionDetected = true;
+      } else if (module == "libSceSysmodule") {
+        if (out.starts_with(lit("loading id = "))) {
+          if (!_dialogSdkDetected && out.contains(lit("Dialog"))) _dialogSdkDetected = true;
+        }
+      } else if (module == "libSceNpTrophy") {
+        if (out == lit("Missing trophy key!")) _hintTrophyKey = true;
+      } else if (module == "elf_loader") {
+        if (!_unityEngineDetected && out.contains(lit("Il2CppUserAssemblies"))) _unityEngineDetected = true;
+        if (out.starts_with(lit("load library[")) && out.ends_with(lit(".sprx"))) {
+          auto start = out.find_last_of(lit("\\/"));
+          if (start == string_view::npos) {
+            start = 0;
+          } else {
+            start += 1;
+          }
+          addFirmware(toUTF8(out.substr(start)));
+        }
+      } else if (module == "patcher") {
+        if (out.starts_with(lit("Applying ")) && out.ends_with(lit(" patch"))) {
+          if (!_hintInsertqPatched && out.contains(lit("ANDN"))) _hintAndnPatched = true;
+          if (!_hintInsertqPatched && out.contains(lit("INSERTQ"))) _hintInsertqPatched = true;
+          if (!_hintInsertqPatched && out.contains(lit("EXTRQ"))) _hintExtrqPatched = true;
+        }
+      } else if (!_hintAjmFound && module == "Ajm::Instance") {
+        _hintAjmFound = true;
+      }
+    }
+  } else { // Handle main logs
+    if (out.contains(lit("Language switched to "))) m_jsonInfo["user-lang"] = toUTF8(out.substr(out.find(lit(" to ")) + 4));
+    if (!_isGpuPicked && out.contains(lit("Selected GPU:"))) {
+      _nvidiaHint            = m_nvidiaGpu.search(out);
+      m_jsonInfo["user-gpu"] = toUTF8(out.substr(out.find_first_of(':') + 1));
+      _gpuSeen               = true;
+    }
+    if (!_inputNotFoundHint && out.contains(lit("No pad with specified name was found"))) _inputNotFoundHint = true;
+    if (module == "sb2spirv") {
+      if (!_shaderGenTodo && m_shaderGenTodo.search(out)) _shaderGenTodo = true;
+    } else if (module == "videoout") {
+      if (auto const message = validationError(module, out)) {
+        _vkValidation = true;
+        m_vkValidationIds.add(validationId(*message), m_lineOffset);
+      }
+      if (!_vkNoDevices && out == lit("Failed to find any suitable Vulkan device")) _vkNoDevices = true;
+    }
+  }
+
+  return true;
+}
+
+template <typename CharT>
+nlohmann::json PLogRules<CharT>::save() const {
+  auto evidence = nlohmann::json::array();
+  for (auto const& item: m_evidence)
+    evidence.push_back({item.offset, item.line});
+
+  // Where render() jumps to, by name since member pointers can't be saved
+  char const* stage = "first";
+  if (m_render == &PLogRules::renderProcess<true>) stage = "child";
+  if (m_render == &PLogRules::renderProcess<false>) stage = "main";
+  if (m_render == &PLogRules::renderNothing) stage = "done";
+
+  nlohmann::json state = {
+      {"flags", flagBits()},
+      {"stage", stage},
+      {"report", m_jsonInfo},
+      {"firmware_left", (uint64_t)m_firmwareLeft},
+      {"firmware_dropped", m_firmwareDropped},
+      {"evidence", std::move(evidence)},
+      {"missing_symbols", m_missingSymbols.save()},
+      {"todo_calls", m_todoCalls.save()},
+      {"vk_validation", m_vkValidationIds.save()},
+      {"ticks", m_ticks},
+      {"next_snapshot", m_nextSnapshot},
+  };
+  if (m_templates != nullptr) state["templates"] = m_templates->save();
+  return state;
+}
+
+template <typename CharT>
+bool PLogRules<CharT>::load(nlohmann::json const& state) {
+  PLogFlags                         flags;
+  RenderFunc                        render;
+  decltype(m_evidence)              evidence;
+  decltype(m_missingSymbols)        missingSymbols;
+  decltype(m_todoCalls)             todoCalls;
+  decltype(m_vkValidationIds)       vkValidationIds;
+  std::unique_ptr<PLogDrain<CharT>> templates;
+  std::unordered_set<std::string>   firmware;
+  uint64_t                          firmwareLeft, firmwareDropped, ticks, nextSnapshot;
+
+  try {
+    auto const bits = state.at("flags").get<uint64_t>();
+    std::memcpy(&flags, &bits, sizeof(PLogFlags));
+
+    auto const stage = state.at("stage").get<std::string>();
+    if (stage == "first") {
+      render = &PLogRules::renderFirstLine;
+    } else if (stage == "child") {
+      render = &PLogRules::renderProcess<true>;
+    } else if (stage == "main") {
+      render = &PLogRules::renderProcess<false>;
+    } else if (stage == "done") {
+      render = &PLogRules::renderNothing;
+    } else {
+      return false;
+    }
+
+    auto const& savedEvidence = state.at("evidence");
+    if (savedEvidence.size() != evidence.size()) return false;
+    for (size_t i = 0; i < evidence.size(); ++i)
+      evidence[i] = {.offset = savedEvidence[i].at(0).get<uint64_t>(), .line = savedEvidence[i].at(1).get<uint64_t>()};
+
+    if (!missingSymbols.load(state.at("missing_symbols")) || !todoCalls.load(state.at("todo_calls")) ||
+        !vkValidationIds.load(state.at("vk_validation")))
+      return false;
+
+    if (m_templates != nullptr) {
+      templates = std::make_unique<PLogDrain<CharT>>(*m_templates); // Keeps the budget
+      if (!state.contains("templates") || !templates->load(state.at("templates"))) return false;
+    }
+
+    // The names the report lists already are the set that keeps them unique
+    auto const& report = state.at("report");
+    if (!report.is_null() && !report.is_object()) return false;
+    if (report.contains("firmware")) {
+      for (auto const& name: report.at("firmware"))
+        firmware.insert(name.get<std::string>());
+    }
+
+    firmwareLeft    = state.at("firmware_left").get<uint64_t>();
+    firmwareDropped = state.at("firmware_dropped").get<uint64_t>();
+    ticks           = state.at("ticks").get<uint64_t>();
+    nextSnapshot    = state.at("next_snapshot").get<uint64_t>();
+  } catch (nlohmann::json::exception const&) {
+    return false;
+  }
+
+  static_cast<PLogFlags&>(*this) = flags;
+
+  m_render          = render;
+  m_jsonInfo        = state.at("report");
+  m_firmware        = std::move(firmware);
+  m_firmwareLeft    = (size_t)std::min<uint64_t>(firmwareLeft, SIZE_MAX);
+  m_firmwareDropped = firmwareDropped;
+  m_evidence        = evidence;
+  m_missingSymbols  = std::move(missingSymbols);
+  m_todoCalls       = std::move(todoCalls);
+  m_vkValidationIds = std::move(vkValidationIds);
+  if (templates != nullptr) m_templates = std::move(templates);
+  m_ticks        = ticks;
+  m_nextSnapshot = nextSnapshot;
+  return true;
+}
+
+template <typename CharT>
+void PLogRules<CharT>::publish() {
+  m_nextSnapshot = m_ticks + m_progressLines;
+
+  auto snapshot       = current();
+  snapshot["partial"] = {
+      {"lines", m_ticks},
+  };
+  m_progress(snapshot);
+}
+
+template <typename CharT>
+nlohmann::json PLogRules<CharT>::current() const {
+  auto report = m_jsonInfo;
+  addVerdict(report);
+  return report;
+}
+
+template <typename CharT>
+void PLogRules<CharT>::finalize() {
+  addVerdict(m_jsonInfo);
+}
+
+template <typename CharT>
+void PLogRules<CharT>::addVerdict(nlohmann::json& report) const {
+  auto& labels = report["labels"];
+  auto& hints  = report["hints"];
+
+  if (_isChildprocess) {
+    if (_unityEngineDetected) labels.push_back("engine-unity");
+    if (_unrealEngineDetected) labels.push_back("engine-unreal");
+    if (_cryEngineDetected) labels.push_back("engine-cry");
+    if (_phyreEngineDetected) labels.push_back("engine-phyre");
+    if (_gmakerEngineDetected) labels.push_back("engine-gamemaker");
+    if (_naughtyEngineDetected) labels.push_back("engine-naughty");
+    if (_irrlichtEngineDetected) labels.push_back("engine-irrlicht");
+    if (_exceptionDetected) labels.push_back("exception");
+    if (_fmodSdkDetected) labels.push_back("sdk-fmod");
+    if (_monoSdkDetected) labels.push_back("sdk-mono");
+    if (_criSdkDetected) labels.push_back("sdk-criware");
+    if (_havokSdkDetected) labels.push_back("sdk-havok");
+    if (_wwiseSdkDetected) labels.push_back("sdk-wwise");
+    if (_missingSymbolDetected) labels.push_back("missing-symbol");
+
+    if (!m_missingSymbols.empty()) report["missing_symbols"] = m_missingSymbols.dump(20, toUTF8);
+    if (!m_todoCalls.empty()) report["todo_calls"] = m_todoCalls.dump(20, toUTF8);
+  } else {
+    if (_inputNotFoundHint)
+      hints.push_back("One of your users has the input device set incorrectly, if you can't control the PS4 app, this could be the cause.");
+    if (_nvidiaHint)
+      hints.push_back("You are using an NVIDIA graphics card, these cards have many issues on our emulator that may not be present on AMD cards.");
+    if (_hintAndnPatched || _hintExtrqPatched || _hintInsertqPatched) {
+      std::string unsupported = "Your CPU does not support some instructions (";
+      if (_hintAndnPatched) unsupported += "ANDN, ";
+      if (_hintExtrqPatched) unsupported += "EXTRQ, ";
+      if (_hintInsertqPatched) unsupported += "INSERTQ, ";
+      hints.push_back(unsupported + ") and they have been patched");
+    }
+    if (_hintAjmFound) hints.push_back("This game uses hardware audio encoding/decoding");
+    if (_vkValidation) labels.push_back("graphics");
+    if (!m_vkValidationIds.empty()) report["vk_validation"] = m_vkValidationIds.dump(50, toUTF8);
+    if (_shaderGenTodo) labels.push_back("shader-gen");
+    if (_vkNoDevices) {
+      hints.push_back("Your GPU is not supported at the moment");
+      labels.push_back("badgpu");
+    }
+  }
+
+  if (m_templates != nullptr) {
+    report["templates"] = m_templates->dump(20, toUTF8);
+    if (m_bounded) markTruncated(report, "templates", m_templates->unclustered());
+  }
+
+  markTruncated(report, "firmware", m_firmwareDropped);
+
+  if (_hintTrophyKey)
+    hints.push_back("You don't have the trophy key installed, this can cause problems in games, also you won't be able to see the list of trophies you have "
+                    "received. To solve this problem, check #faq channel in on Discord Server.");
+
+  auto evidence = nlohmann::json::object();
+  for (size_t i = 0; i < m_evidence.size(); ++i) {
+    if (m_evidence[i].line == 0) continue;
+    evidence[PLogEvidenceFlags[i].name] = {
+        {"offset", m_evidence[i].offset},
+        {"line", m_evidence[i].line},
+    };
+  }
+  if (!evidence.empty()) report["evidence"] = std::move(evidence);
+}
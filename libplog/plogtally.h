@@ -0,0 +1,379 @@
+#pragma once
+
+#include "third_party/json.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+// Counts distinct strings in bounded memory. Exact while there are no more than Capacity distinct keys, past that it turns into a
+// Space-Saving heavy hitter sketch: a new key takes over the least counted slot, so the real top offenders stay while the long tail
+// gets folded away. Keys are interned into one arena, lookups go through an open addressing index. Slots with the same count share a
+// bucket and the buckets are linked by count (Space-Saving's stream summary), so a bump and finding the slot to evict are a few link
+// updates each
+template <typename CharT, size_t Capacity, size_t ArenaSize = Capacity * 64>
+class PLogTally {
+  static_assert(Capacity < 0xffff, "Slot indices are stored as uint16_t");
+
+  public:
+  using string_view = std::basic_string_view<CharT>;
+
+  PLogTally() { m_index.fill(Empty); }
+
+  // position is where the key was seen, the first one is kept
+  void add(string_view key, uint64_t position);
+
+  // Top n keys, "error" is how much of a count could belong to keys that were evicted before it
+  template <typename Conv>
+  nlohmann::json dump(size_t n, Conv&& toUTF8) const;
+
+  bool empty() const { return m_total == 0; }
+
+  // Checkpoint of the counts, load() replaces them with it. Keys go as raw bytes, they don't have to be valid UTF-8
+  nlohmann::json save() const;
+  bool           load(nlohmann::json const& state);
+
+  private:
+  static constexpr size_t   IndexSize = std::bit_ceil(Capacity * 2);
+  static constexpr uint16_t Empty     = 0xffff;
+
+  struct Slot {
+    uint64_t count    = 0;
+    uint64_t error    = 0;
+    uint64_t first    = 0;
+    uint32_t hash     = 0;
+    uint32_t offset   = 0;
+    uint32_t length   = 0;
+    uint32_t capacity = 0; // Arena span owned by the slot, reused when the slot gets evicted
+    uint16_t bucket   = Empty;
+    uint16_t prev     = Empty; // Neighbours in the bucket, oldest first
+    uint16_t next     = Empty;
+  };
+
+  struct Bucket {
+    uint64_t count = 0;
+    uint16_t head  = Empty; // Slot that got this count first, evicted first
+    uint16_t tail  = Empty;
+    uint16_t prev  = Empty; // Buckets of the neighbouring counts, lower and higher
+    uint16_t next  = Empty; // Links the free buckets too
+  };
+
+  // Eats the key eight bytes at a time, per character hashing was the hot spot on todo spam. The tail goes in byte by byte, a memcpy()
+  // of a variable size ends up as a call
+  static uint32_t hashOf(string_view key) {
+    auto const* data = (const char*)key.data();
+    size_t      left = key.size() * sizeof(CharT);
+    uint64_t    hash = left * 0x9e3779b97f4a7c15ull;
+
+    auto const mix = [&hash](uint64_t word) {
+      hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+      hash ^= hash >> 32;
+    };
+
+    uint64_t word;
+    for (; left >= sizeof(word); data += sizeof(word), left -= sizeof(word)) {
+      std::memcpy(&word, data, sizeof(word));
+      mix(word);
+    }
+
+    if (left > 0) {
+      word = 0;
+      for (size_t i = 0; i < left; ++i)
+        word |= (uint64_t)(uint8_t)data[i] << (i * 8);
+      mix(word);
+    }
+
+    return (uint32_t)hash;
+  }
+
+  string_view keyOf(Slot const& slot) const { return string_view(m_arena.data() + slot.offset, slot.length); }
+
+  // Index position holding key, or the empty position it would go to
+  size_t locate(string_view key, uint32_t hash, bool& found) const {
+    for (size_t pos = hash & (IndexSize - 1);; pos = (pos + 1) & (IndexSize - 1)) {
+      if (m_index[pos] == Empty) {
+        found = false;
+        return pos;
+      }
+
+      auto const& slot = m_slots[m_index[pos]];
+      if (slot.hash == hash && keyOf(slot) == key) {
+        found = true;
+        return pos;
+      }
+    }
+  }
+
+  // Backward shift deletion, keeps the probe chains intact without tombstones
+  void erase(uint16_t slotIndex) {
+    size_t hole = m_slots[slotIndex].hash & (IndexSize - 1);
+    while (m_index[hole] != slotIndex)
+      hole = (hole + 1) & (IndexSize - 1);
+
+    for (size_t next = (hole + 1) & (IndexSize - 1); m_index[next] != Empty; next = (next + 1) & (IndexSize - 1)) {
+      size_t const home = m_slots[m_index[next]].hash & (IndexSize - 1);
+      if (((next - home) & (IndexSize - 1)) >= ((next - hole) & (IndexSize - 1))) {
+        m_index[hole] = m_index[next];
+        hole          = next;
+      }
+    }
+
+    m_index[hole] = Empty;
+  }
+
+  uint16_t newBucket(uint64_t count, uint16_t prev, uint16_t next) {
+    uint16_t index = m_free;
+    if (index != Empty)
+      m_free = m_buckets[index].next;
+    else
+      index = (uint16_t)m_buckets.size(), m_buckets.emplace_back();
+
+    m_buckets[index]                                = {.count = count, .head = Empty, .tail = Empty, .prev = prev, .next = next};
+    (prev != Empty ? m_buckets[prev].next : m_least) = index;
+    if (next != Empty) m_buckets[next].prev = index;
+    return index;
+  }
+
+  // Takes the slot out of its bucket, a bucket left empty goes to the free list
+  void unlink(uint16_t slotIndex) {
+    auto const& slot   = m_slots[slotIndex];
+    auto&       bucket = m_buckets[slot.bucket];
+    (slot.prev != Empty ? m_slots[slot.prev].next : bucket.head) = slot.next;
+    (slot.next != Empty ? m_slots[slot.next].prev : bucket.tail) = slot.prev;
+    if (bucket.head != Empty) return;
+
+    (bucket.prev != Empty ? m_buckets[bucket.prev].next : m_least) = bucket.next;
+    if (bucket.next != Empty) m_buckets[bucket.next].prev = bucket.prev;
+    bucket.next = m_free;
+    m_free      = slot.bucket;
+  }
+
+  void append(uint16_t slotIndex, uint16_t bucketIndex) {
+    auto& slot   = m_slots[slotIndex];
+    auto& bucket = m_buckets[bucketIndex];
+    slot.bucket  = bucketIndex;
+    slot.prev    = bucket.tail;
+    slot.next    = Empty;
+    (bucket.tail != Empty ? m_slots[bucket.tail].next : bucket.head) = slotIndex;
+    bucket.tail = slotIndex;
+  }
+
+  // Counts the key once more, moving its slot on to the next bucket
+  void bump(uint16_t slotIndex) {
+    auto const from  = m_slots[slotIndex].bucket;
+    auto const count = ++m_slots[slotIndex].count;
+    auto const next  = m_buckets[from].next;
+    if (next == Empty || m_buckets[next].count != count) {
+      // Alone in its bucket, as the heavy hitters usually are
+      if (m_buckets[from].head == m_buckets[from].tail) {
+        m_buckets[from].count = count;
+        return;
+      }
+
+      auto const to = newBucket(count, from, next);
+      unlink(slotIndex);
+      append(slotIndex, to);
+      return;
+    }
+
+    unlink(slotIndex);
+    append(slotIndex, next);
+  }
+
+  bool intern(string_view key, uint32_t& offset) {
+    if (m_arena.size() + key.size() > ArenaSize) return false;
+    offset = (uint32_t)m_arena.size();
+    m_arena.insert(m_arena.end(), key.begin(), key.end());
+    return true;
+  }
+
+  std::vector<CharT>              m_arena;
+  std::vector<Slot>               m_slots;
+  std::vector<Bucket>             m_buckets;
+  std::array<uint16_t, IndexSize> m_index;
+  uint16_t                        m_least = Empty; // Bucket of the lowest count
+  uint16_t                        m_free  = Empty;
+  uint16_t                        m_last  = Empty; // Slot of the previous key, spam tends to repeat the same line
+
+  uint64_t m_total   = 0;
+  uint64_t m_dropped = 0; // Keys that found no room in the arena
+  bool     m_evicted = false;
+};
+
+template <typename CharT, size_t Capacity, size_t ArenaSize>
+void PLogTally<CharT, Capacity, ArenaSize>::add(string_view key, uint64_t position) {
+  ++m_total;
+
+  if (m_last != Empty && m_slots[m_last].length == key.size() && keyOf(m_slots[m_last]) == key) {
+    bump(m_last);
+    return;
+  }
+
+  bool       found;
+  auto const hash = hashOf(key);
+  auto const pos  = locate(key, hash, found);
+  if (found) {
+    m_last = m_index[pos];
+    bump(m_last);
+    return;
+  }
+
+  if (m_slots.size() < Capacity) {
+    uint32_t offset;
+    if (!intern(key, offset)) {
+      ++m_dropped;
+      return;
+    }
+
+    auto const slotIndex = (uint16_t)m_slots.size();
+    m_slots.push_back(
+        {.count = 1, .error = 0, .first = position, .hash = hash, .offset = offset, .length = (uint32_t)key.size(), .capacity = (uint32_t)key.size()});
+    m_index[pos] = slotIndex;
+    append(slotIndex, m_least != Empty && m_buckets[m_least].count == 1 ? m_least : newBucket(1, Empty, m_least));
+    m_last = slotIndex;
+    return;
+  }
+
+  // Every slot is taken, the least counted one goes
+  auto const victim = m_buckets[m_least].head;
+
+  auto& slot     = m_slots[victim];
+  auto  offset   = slot.offset;
+  auto  capacity = slot.capacity;
+  if (key.size() > capacity) {
+    if (!intern(key, offset)) {
+      ++m_dropped;
+      return;
+    }
+    capacity = (uint32_t)key.size();
+  } else {
+    std::copy(key.begin(), key.end(), m_arena.begin() + offset);
+  }
+
+  erase(victim);
+  slot.error    = slot.count;
+  slot.first    = position; // Where the key took the slot over, it could have been seen before
+  slot.hash     = hash;
+  slot.offset   = offset;
+  slot.length   = (uint32_t)key.size();
+  slot.capacity = capacity;
+  bump(victim);
+
+  m_index[locate(key, hash, found)] = victim;
+  m_last                            = victim;
+  m_evicted                         = true;
+}
+
+template <typename CharT, size_t Capacity, size_t ArenaSize>
+template <typename Conv>
+nlohmann::json PLogTally<CharT, Capacity, ArenaSize>::dump(size_t n, Conv&& toUTF8) const {
+  std::vector<Slot const*> order;
+  order.reserve(m_slots.size());
+  for (auto const& slot: m_slots)
+    order.push_back(&slot);
+
+  n = std::min(n, order.size());
+  std::partial_sort(order.begin(), order.begin() + n, order.end(), [](Slot const* a, Slot const* b) { return a->count > b->count; });
+
+  auto top = nlohmann::json::array();
+  for (size_t i = 0; i < n; ++i) {
+    top.push_back({
+        {"name", toUTF8(keyOf(*order[i]))},
+        {"count", order[i]->count},
+        {"error", order[i]->error},
+        {"first", order[i]->first},
+    });
+  }
+
+  return {
+      {"total", m_total},
+      {"distinct", m_slots.size()},
+      {"exact", !m_evicted && m_dropped == 0},
+      {"top", std::move(top)},
+  };
+}
+
+template <typename CharT, size_t Capacity, size_t ArenaSize>
+nlohmann::json PLogTally<CharT, Capacity, ArenaSize>::save() const {
+  auto slots = nlohmann::json::array();
+  for (auto const& slot: m_slots)
+    slots.push_back({slot.count, slot.error, slot.first, slot.offset, slot.length, slot.capacity});
+
+  auto order = nlohmann::json::array();
+  for (auto bucket = m_least; bucket != Empty; bucket = m_buckets[bucket].next) {
+    for (auto slot = m_buckets[bucket].head; slot != Empty; slot = m_slots[slot].next)
+      order.push_back(slot);
+  }
+
+  auto const* arena = (uint8_t const*)m_arena.data();
+  return {
+      {"arena", nlohmann::json::binary(std::vector<uint8_t>(arena, arena + m_arena.size() * sizeof(CharT)))},
+      {"slots", std::move(slots)},
+      {"order", std::move(order)},
+      {"total", m_total},
+      {"dropped", m_dropped},
+      {"evicted", m_evicted},
+  };
+}
+
+template <typename CharT, size_t Capacity, size_t ArenaSize>
+bool PLogTally<CharT, Capacity, ArenaSize>::load(nlohmann::json const& state) {
+  PLogTally loaded;
+
+  try {
+    auto const& arena = state.at("arena").get_binary();
+    auto const& slots = state.at("slots");
+    auto const  order = state.at("order").get<std::vector<uint16_t>>();
+    if (arena.size() % sizeof(CharT) != 0 || arena.size() / sizeof(CharT) > ArenaSize || slots.size() > Capacity || order.size() != slots.size())
+      return false;
+
+    loaded.m_arena.resize(arena.size() / sizeof(CharT));
+    if (!arena.empty()) std::memcpy(loaded.m_arena.data(), arena.data(), arena.size());
+
+    // The index is rebuilt, the buckets keep their saved order so evictions go on exactly as without the checkpoint
+    for (auto const& fields: slots) {
+      Slot slot = {.count    = fields.at(0).get<uint64_t>(),
+                   .error    = fields.at(1).get<uint64_t>(),
+                   .first    = fields.at(2).get<uint64_t>(),
+                   .offset   = fields.at(3).get<uint32_t>(),
+                   .length   = fields.at(4).get<uint32_t>(),
+                   .capacity = fields.at(5).get<uint32_t>()};
+      if (slot.length > slot.capacity || (uint64_t)slot.offset + slot.capacity > loaded.m_arena.size()) return false;
+
+      bool found;
+      slot.hash      = hashOf(loaded.keyOf(slot));
+      auto const pos = loaded.locate(loaded.keyOf(slot), slot.hash, found);
+      if (found) return false;
+
+      loaded.m_index[pos] = (uint16_t)loaded.m_slots.size();
+      loaded.m_slots.push_back(slot);
+    }
+
+    // Buckets are rebuilt in the saved order, the least counted first
+    std::vector<bool> placed(order.size());
+    uint16_t          last = Empty;
+    for (auto const slot: order) {
+      if (slot >= order.size() || placed[slot]) return false;
+      placed[slot] = true;
+
+      auto const count = loaded.m_slots[slot].count;
+      if (count == 0 || (last != Empty && count < loaded.m_buckets[last].count)) return false;
+      if (last == Empty || count != loaded.m_buckets[last].count) last = loaded.newBucket(count, last, Empty);
+      loaded.append(slot, last);
+    }
+
+    loaded.m_total   = state.at("total").get<uint64_t>();
+    loaded.m_dropped = state.at("dropped").get<uint64_t>();
+    loaded.m_evicted = state.at("evicted").get<bool>();
+  } catch (nlohmann::json::exception const&) {
+    return false;
+  }
+
+  *this = std::move(loaded);
+  return true;
+}
@@ -0,0 +1,226 @@
+#include "plogtrace.h"
+#include "plogmerge.h"
+
+#include <algorithm>
+#include <charconv>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+namespace {
+constexpr size_t MaxMessage = 256; // Of an instant event, the log has the rest
+
+constexpr std::string_view LevelChars    = "TDIWEC";
+constexpr char const*      LevelNames[6] = {"trace", "debug", "info", "warn", "error", "critical"};
+constexpr char const*      KindNames[]   = {"exception", "missing symbol", "validation error"};
+
+// Events are formatted by hand, a json object per slice would cost more than the parsing. Only strings that need escaping
+// (or aren't plain ASCII, and might not be valid UTF-8 either) go through nlohmann
+void appendQuoted(std::string& out, std::string_view str) {
+  if (std::all_of(str.begin(), str.end(), [](char c) { return c >= 0x20 && c < 0x7f && c != '"' && c != '\\'; })) {
+    out += '"';
+    out += str;
+    out += '"';
+    return;
+  }
+  out += nlohmann::json(str).dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+}
+
+void appendPart(std::string& out, std::string_view str) {
+  out += str;
+}
+
+void appendPart(std::string& out, int64_t value) {
+  char buf[24];
+  out.append(buf, std::to_chars(buf, buf + sizeof(buf), value).ptr);
+}
+
+// Pieces of JSON as they are and numbers
+template <typename... Parts>
+void append(std::string& out, Parts const&... parts) {
+  (appendPart(out, parts), ...);
+}
+} // namespace
+
+PLogTraceWriter::PLogTraceWriter(std::ostream& out, int64_t binMicros)
+    : m_out(out), m_binMicros(std::max<int64_t>(binMicros, 1)), m_counterMicros(m_binMicros * CounterBins) {
+  static constexpr std::string_view header = "{\"traceEvents\":[\n";
+  m_out.write(header.data(), header.size());
+  m_written += header.size();
+}
+
+void PLogTraceWriter::write(std::string_view line) {
+  PLogAnalyzer::LineInfo info = {};
+
+  auto const out = PLogAnalyzer::parseLine(line, info);
+  write(line, info, out);
+}
+
+void PLogTraceWriter::write(std::string_view line, PLogAnalyzer::LineInfo const& info, std::string_view out) {
+  ++m_lines;
+  m_bytesIn += line.size() + 1;
+  if (m_bytesIn - m_windowIn >= AdaptBytes) adapt();
+
+  if (out.data() == nullptr) return;
+  if (m_child < 0 && !out.empty()) m_child = out == "child process"; // As PLogRules takes it from the first line it renders
+
+  int64_t time;
+  if (!PLogMerger::decodeTimestamp(info.timestamp, time)) return;
+
+  if (m_start < 0) {
+    m_start = time;
+    m_startStamp.assign(info.timestamp);
+  }
+  time = std::max<int64_t>(time - m_start, 0);
+
+  auto* thread = m_lastThread;
+  if (thread == nullptr || thread->pid != info.processId || thread->tid != info.threadId) {
+    auto [it, added] = m_threads.try_emplace(uint64_t(info.processId) << 32 | info.threadId);
+    thread           = &it->second;
+    if (added) {
+      thread->pid     = info.processId;
+      thread->tid     = info.threadId;
+      thread->process = &m_processes[info.processId];
+    }
+    m_lastThread = thread;
+  }
+
+  // Activity of the thread
+  if (thread->lines > 0 && time - thread->end > m_binMicros) closeBurst(*thread);
+  if (thread->lines++ == 0) {
+    thread->start = thread->end = time;
+    thread->module.assign(info.module);
+    thread->mixed = false;
+  } else {
+    thread->end = std::max(thread->end, time);
+    if (!thread->mixed && thread->module != info.module) thread->mixed = true;
+  }
+
+  if (info.module == "pthread" && out.starts_with("--> thread")) {
+    auto name = out.substr(10);
+    name.remove_prefix(std::min(name.find_first_not_of(' '), name.size()));
+    if (name != thread->name) {
+      thread->name.assign(name);
+
+      m_event.clear();
+      append(m_event, R"({"ph":"M","name":"thread_name","pid":)", thread->pid, R"(,"tid":)", thread->tid, R"(,"args":{"name":)");
+      appendQuoted(m_event, name);
+      m_event += "}}";
+      event();
+    }
+  }
+
+  // Problems worth a marker, the lines the rules take for them
+  using Rules = PLogRules<char>;
+
+  auto             kind = KindCount;
+  std::string_view detail;
+  if (m_child > 0) {
+    if (Rules::isException(info.module, out)) {
+      kind   = KindException;
+      detail = out;
+    } else if (auto const symbol = Rules::missingSymbol(info.module, out)) {
+      kind   = KindMissingSymbol;
+      detail = *symbol;
+    }
+  } else if (auto const message = Rules::validationError(info.module, out)) {
+    kind   = KindValidation;
+    detail = *message;
+  }
+
+  if (kind != KindCount) {
+    auto& instant = thread->instants[kind];
+    if (instant.count > 0 && time / m_binMicros != instant.time / m_binMicros) closeInstant(*thread, kind);
+    if (instant.count++ == 0) {
+      instant.time = time;
+      instant.message.assign(detail.substr(0, MaxMessage));
+    }
+  }
+
+  // Lines of the process, the ones going back in time count to the current sample
+  auto&      process = *thread->process;
+  auto const bin     = time / m_counterMicros;
+  if (bin > process.bin) closeBin(thread->pid, process, bin);
+  if (auto const level = LevelChars.find(info.level.empty() ? '\0' : info.level[0]); level != std::string_view::npos) {
+    ++process.levels[level];
+    process.seen |= uint8_t(1 << level);
+  }
+}
+
+bool PLogTraceWriter::finish() {
+  for (auto& [key, thread]: m_threads) {
+    if (thread.lines > 0) closeBurst(thread);
+    for (uint8_t kind = 0; kind < KindCount; ++kind)
+      if (thread.instants[kind].count > 0) closeInstant(thread, Kind(kind));
+  }
+  for (auto& [pid, process]: m_processes)
+    if (process.bin >= 0) closeBin(pid, process, process.bin + 2); // Drops the counters back to zero after the last sample
+
+  m_event = "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"start\":";
+  appendQuoted(m_event, m_startStamp);
+  append(m_event, R"(,"bin_us":)", m_binMicros, "}}\n");
+  m_out.write(m_event.data(), (std::streamsize)m_event.size());
+  m_written += m_event.size();
+
+  m_out.flush();
+  return m_out.good();
+}
+
+void PLogTraceWriter::event() {
+  if (m_events++ > 0) {
+    m_out.write(",\n", 2);
+    m_written += 2;
+  }
+  m_out.write(m_event.data(), (std::streamsize)m_event.size());
+  m_written += m_event.size();
+}
+
+void PLogTraceWriter::closeBurst(Thread& thread) {
+  m_event = R"({"ph":"X","name":)";
+  appendQuoted(m_event, thread.mixed ? std::string_view("mixed") : thread.module);
+  append(m_event, R"(,"pid":)", thread.pid, R"(,"tid":)", thread.tid, R"(,"ts":)", thread.start, R"(,"dur":)",
+         std::max<int64_t>(thread.end - thread.start, 1), R"(,"args":{"lines":)", thread.lines, "}}"); // Single lines still get a visible slice
+  event();
+  thread.lines = 0;
+}
+
+void PLogTraceWriter::closeInstant(Thread& thread, Kind kind) {
+  auto& instant = thread.instants[kind];
+  m_event.clear();
+  append(m_event, R"({"ph":"i","s":"t","name":")", KindNames[kind], R"(","pid":)", thread.pid, R"(,"tid":)", thread.tid, R"(,"ts":)", instant.time,
+         R"(,"args":{"count":)", instant.count, R"(,"message":)");
+  appendQuoted(m_event, instant.message);
+  m_event += "}}";
+  event();
+  instant.count = 0;
+}
+
+void PLogTraceWriter::closeBin(uint32_t pid, Process& process, int64_t next) {
+  auto counter = [&](int64_t bin, bool zero) {
+    m_event.clear();
+    append(m_event, R"({"ph":"C","name":"lines","pid":)", pid, R"(,"ts":)", bin * m_counterMicros, R"(,"args":{)");
+    char const* sep = "";
+    for (size_t level = 0; level < LevelChars.size(); ++level) {
+      if ((process.seen & (1 << level)) == 0) continue;
+      append(m_event, sep, "\"", LevelNames[level], "\":", zero ? 0 : process.levels[level]);
+      sep = ",";
+    }
+    m_event += "}}";
+    event();
+  };
+
+  if (process.bin >= 0) {
+    counter(process.bin, false);
+    if (next > process.bin + 1) counter(process.bin + 1, true); // Flat line through the silence
+  }
+
+  std::fill(std::begin(process.levels), std::end(process.levels), 0);
+  process.bin = next;
+}
+
+void PLogTraceWriter::adapt() {
+  if ((m_written - m_windowOut) * InputPerOutput > m_bytesIn - m_windowIn && m_binMicros < MaxBinMicros)
+    m_binMicros = std::min(m_binMicros * 2, MaxBinMicros);
+  m_windowIn  = m_bytesIn;
+  m_windowOut = m_written;
+}
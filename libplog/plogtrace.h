@@ -0,0 +1,111 @@
+#pragma once
+
+#include "ploga.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Thread activity timeline in the Chrome trace event format (JSON), loads in ui.perfetto.dev and chrome://tracing. Events are
+// written while the log streams through, what is kept in memory is one pending burst per thread and one counter sample per process:
+//   - every thread is a track named after its "--> thread" line, lines that follow each other closer than the bin are one slice,
+//     so a gap in the track is the thread being silent for longer than that
+//   - exceptions, missing symbols and validation errors (as PLogRules matches them) are instant events on the thread's track, the
+//     ones of the same kind within one bin are one event with a count
+//   - every process has a counter track of its lines by level, sampled every CounterBins of the first bin
+// The bin starts at binMicros. Threads that log a line every few bins would still get a slice per line, so whenever the last AdaptBytes
+// of input made more than 1/InputPerOutput of their size in events the bin doubles, up to MaxBinMicros: the trace stays a fraction of
+// the log and grows with the time it spans rather than with its size. otherData.bin_us is the bin it ended with.
+// Times are relative to the first line, its timestamp goes to otherData.start. Lines without a decodable timestamp only count to lines()
+
+class PLogTraceWriter {
+  public:
+  static constexpr int64_t  DefaultBinMicros = 10'000;
+  static constexpr int64_t  MaxBinMicros     = 1'000'000;
+  static constexpr int64_t  CounterBins      = 10;
+  static constexpr uint64_t AdaptBytes       = 1024 * 1024;
+  static constexpr uint64_t InputPerOutput   = 4;
+
+  PLogTraceWriter(std::ostream& out, int64_t binMicros = DefaultBinMicros);
+
+  void write(std::string_view line);
+
+  // Same for a line that was split already, out is what parseLine() returned for it
+  void write(std::string_view line, PLogAnalyzer::LineInfo const& info, std::string_view out);
+
+  // Flushes the pending bursts and counters and closes the JSON
+  bool finish();
+
+  uint64_t lines() const { return m_lines; }
+
+  uint64_t events() const { return m_events; }
+
+  int64_t binMicros() const { return m_binMicros; }
+
+  uint64_t bytesIn() const { return m_bytesIn; }
+
+  uint64_t bytesOut() const { return m_written; }
+
+  private:
+  enum Kind : uint8_t {
+    KindException,
+    KindMissingSymbol,
+    KindValidation,
+
+    KindCount,
+  };
+
+  struct Instant {
+    int64_t     time  = 0;
+    uint32_t    count = 0;
+    std::string message; // Of the first one in the bin
+  };
+
+  struct Process {
+    int64_t  bin       = -1;
+    uint32_t levels[6] = {}; // T, D, I, W, E, C lines in the bin
+    uint8_t  seen      = 0;  // Levels the counter track has series for
+  };
+
+  struct Thread {
+    uint32_t    pid = 0, tid = 0;
+    Process*    process = nullptr;
+    int64_t     start = 0, end = 0;
+    uint32_t    lines = 0; // Of the current burst, 0 if there is none
+    std::string module;    // Of the burst's first line
+    bool        mixed = false;
+    std::string name;
+    Instant     instants[KindCount];
+  };
+
+  void event();
+  void closeBurst(Thread& thread);
+  void closeInstant(Thread& thread, Kind kind);
+  void closeBin(uint32_t pid, Process& process, int64_t next);
+  void adapt();
+
+  std::ostream& m_out;
+  int64_t       m_binMicros;
+  int64_t       m_counterMicros; // Stays put, the counter samples are numbered by it
+  int8_t        m_child = -1;    // Process type as the first line tells it, -1 before that line
+
+  std::unordered_map<uint64_t, Thread>  m_threads; // By pid << 32 | tid
+  std::unordered_map<uint32_t, Process> m_processes;
+  Thread*                               m_lastThread = nullptr; // Lines of one thread tend to come in runs
+
+  int64_t     m_start = -1; // Of the first timed line
+  std::string m_startStamp;
+  std::string m_event; // Scratch for the one being written
+
+  uint64_t m_lines   = 0;
+  uint64_t m_events  = 0;
+  uint64_t m_bytesIn = 0;
+  uint64_t m_written = 0;
+
+  // Where the input and output stood when the bin was last looked at
+  uint64_t m_windowIn  = 0;
+  uint64_t m_windowOut = 0;
+};
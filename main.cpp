@@ -1,21 +1,33 @@
 #include "libplog/ploga.h"
+#include "libplog/plogarc.h"
+#include "libplog/plogarrow.h"
+#include "libplog/plogcorpus.h"
+#include "libplog/plogdiff.h"
+#include "libplog/plogfollow.h"
+#include "libplog/plogmerge.h"
+#include "libplog/plogtrace.h"
 #include "third_party/httplib.h"
 #include "zipconf.h"
 
 #include <Windows.h>
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <filesystem>
 #include <format>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <iterator>
 #include <memory>
-#include <sstream>
+#include <mutex>
+#include <optional>
+#include <streambuf>
 #include <string>
 #include <string_view>
 #include <thread>
@@ -52,29 +64,507 @@ enum LogAnExitCodes : int32_t {
   _ZipErrorsEnd = 300,
 };
 
-std::thread createHttpServer(std::string const&& loglines) {
+using ServeProvider = std::function<void(httplib::DataSink& sink)>;
+using EntryProvider = std::function<void(zip_uint64_t entry, httplib::DataSink& sink)>; // Single entries of a zip, by their index
+
+// Passes on lines from..to (counted from 1) of what the provider writes, and stops it once they're through
+void serveLines(ServeProvider const& provider, uint64_t from, uint64_t to, httplib::DataSink& sink) {
+  httplib::DataSink lines;
+  uint64_t          line = 1;
+
+  lines.write = [&sink, &line, from, to](const char* data, size_t size) {
+    for (size_t pos = 0; pos < size && line <= to;) {
+      auto const newline = std::find(data + pos, data + size, '\n');
+      auto const end     = newline != data + size ? (size_t)(newline - data) + 1 : size;
+      if (line >= from && !sink.write(data + pos, end - pos)) return false;
+      if (newline != data + size) ++line;
+      pos = end;
+    }
+    return line <= to;
+  };
+
+  provider(lines);
+}
+
+// Zips with several logs serve their merged view, ?entry=<index> picks a single one of them instead
+std::thread createHttpServer(ServeProvider&& provider, std::shared_ptr<PLogFollower const> follower = nullptr, EntryProvider&& entries = nullptr) {
   return std::thread(
-      [](std::string const&& lines) {
+      [](ServeProvider const&& provider, std::shared_ptr<PLogFollower const> const follower, EntryProvider const&& entries) {
         httplib::Server svr;
 
-        svr.Get("/", [&lines](httplib::Request const& req, httplib::Response& resp) { resp.set_content(lines, "text/plain"); });
+        auto const select = [&provider, &entries](httplib::Request const& req) -> ServeProvider {
+          if (entries == nullptr || !req.has_param("entry")) return provider;
+          return [&entries, entry = (zip_uint64_t)std::strtoull(req.get_param_value("entry").c_str(), nullptr, 10)](httplib::DataSink& sink) {
+            entries(entry, sink);
+          };
+        };
+
+        svr.Get("/", [&select](httplib::Request const& req, httplib::Response& resp) {
+          resp.set_chunked_content_provider("text/plain", [source = select(req)](size_t offset, httplib::DataSink& sink) {
+            source(sink);
+            sink.done();
+            return true;
+          });
+        });
+
+        // Evidence links of the report point here, /lines?from=120&to=130
+        svr.Get("/lines", [&select](httplib::Request const& req, httplib::Response& resp) {
+          uint64_t const from = std::max<uint64_t>(std::strtoull(req.get_param_value("from").c_str(), nullptr, 10), 1);
+          uint64_t const to   = req.has_param("to") ? std::strtoull(req.get_param_value("to").c_str(), nullptr, 10) : from + 99;
+
+          resp.set_chunked_content_provider("text/plain", [source = select(req), from, to](size_t offset, httplib::DataSink& sink) {
+            serveLines(source, from, to, sink);
+            sink.done();
+            return true;
+          });
+        });
+
+        // Follow mode pushes the labels, hints and config here as server-sent events, whenever they change
+        if (follower != nullptr) {
+          svr.Get("/events", [&follower](httplib::Request const& req, httplib::Response& resp) {
+            uint64_t const after = std::strtoull(req.get_header_value("Last-Event-ID").c_str(), nullptr, 10); // Set by reconnecting browsers
+
+            resp.set_header("Cache-Control", "no-cache");
+            resp.set_chunked_content_provider("text/event-stream", [&follower, last = after, updates = std::vector<PLogFollower::Update>(),
+                                                                    events = std::string()](size_t offset, httplib::DataSink& sink) mutable {
+              updates.clear();
+              if (!follower->wait(last, std::chrono::seconds(15), updates)) return sink.write(":\n\n", 3); // Comment, keeps the connection alive
+
+              events.clear();
+              for (auto const& update: updates)
+                events += std::format("id: {}\nevent: {}\ndata: {}\n\n", update.id, update.topic, update.data);
+              last = updates.back().id;
+              return sink.write(events.data(), events.size());
+            });
+          });
+        }
 
         svr.listen("0.0.0.0", 13370);
       },
-      std::move(loglines));
+      std::move(provider), std::move(follower), std::move(entries));
+}
+
+// Reads a zip entry in small blocks, so merging several entries only keeps one block per entry in memory
+class ZipEntryBuf: public std::streambuf {
+  public:
+  ZipEntryBuf(zip_t* zarc, zip_uint64_t index): m_file(zip_fopen_index(zarc, index, 0)) {}
+
+  ~ZipEntryBuf() {
+    if (m_file != nullptr) zip_fclose(m_file);
+  }
+
+  bool is_open() const { return m_file != nullptr; }
+
+  protected:
+  int_type underflow() override {
+    if (m_file == nullptr) return traits_type::eof();
+
+    auto const got = zip_fread(m_file, m_block, sizeof(m_block));
+    if (got <= 0) return traits_type::eof();
+
+    setg(m_block, m_block, m_block + got);
+    return traits_type::to_int_type(m_block[0]);
+  }
+
+  private:
+  zip_file_t* m_file;
+  char        m_block[64 * 1024];
+};
+
+// A zip_t can't be read from several threads at once, so every reader opens the in-memory archive on its own
+zip_t* openMemoryZip(const char* archive, size_t size) {
+  zip_error_t zerr;
+  zip_error_init(&zerr);
+
+  zip_source_t* zsrc = zip_source_buffer_create(archive, size, 0, &zerr);
+  zip_t*        zarc = zsrc != nullptr ? zip_open_from_source(zsrc, ZIP_RDONLY, &zerr) : nullptr;
+  zip_error_fini(&zerr);
+  if (zarc == nullptr && zsrc != nullptr) zip_source_free(zsrc);
+
+  return zarc;
+}
+
+// The entry is inflated exactly once, straight into the analyser
+std::unique_ptr<PLogAnalyzer> analyseZipEntry(const char* archive, size_t size, zip_uint64_t index, PLogOptions const& options) {
+  zip_t* zarc = openMemoryZip(archive, size);
+  if (zarc == nullptr) {
+    fprintf(stderr, "Failed to open zip for file#%llu\n", (unsigned long long)index);
+    return nullptr;
+  }
+
+  std::unique_ptr<PLogAnalyzer> analyser;
+  {
+    ZipEntryBuf buffer(zarc, index);
+    if (buffer.is_open()) {
+      std::istream stream(&buffer);
+      analyser = createStreamAnalyser(stream, options);
+    } else {
+      fprintf(stderr, "Failed to open zip file#%llu: %s\n", (unsigned long long)index, zip_strerror(zarc));
+    }
+  }
+
+  zip_discard(zarc);
+  return analyser;
+}
+
+// Streams the time ordered merge of the given plog entries, every request inflates them again instead of keeping the result around
+void serveMergedEntries(std::vector<char> const& archive, std::vector<zip_uint64_t> const& entries, httplib::DataSink& sink) {
+  zip_t* zarc = openMemoryZip(archive.data(), archive.size());
+  if (zarc == nullptr) return;
+
+  std::vector<std::unique_ptr<ZipEntryBuf>>  buffers;
+  std::vector<std::unique_ptr<std::istream>> streams;
+  std::vector<std::istream*>                 inputs;
+  for (auto index: entries) {
+    buffers.emplace_back(std::make_unique<ZipEntryBuf>(zarc, index));
+    streams.emplace_back(std::make_unique<std::istream>(buffers.back().get()));
+    inputs.push_back(streams.back().get());
+  }
+
+  PLogMerger       merger(inputs);
+  std::string      block;
+  size_t           source;
+  std::string_view line;
+  while (merger.next(source, line)) {
+    block.append(line).push_back('\n');
+    if (block.size() >= 64 * 1024) {
+      if (!sink.write(block.data(), block.size())) break;
+      block.clear();
+    }
+  }
+  if (!block.empty()) sink.write(block.data(), block.size());
+
+  streams.clear();
+  buffers.clear();
+  zip_discard(zarc);
+}
+
+// One entry as it is, for the evidence lines of its own report
+void serveEntry(std::vector<char> const& archive, zip_uint64_t entry, httplib::DataSink& sink) {
+  zip_t* zarc = openMemoryZip(archive.data(), archive.size());
+  if (zarc == nullptr) return;
+
+  {
+    ZipEntryBuf       buffer(zarc, entry);
+    std::vector<char> block(64 * 1024);
+    for (std::streamsize got; (got = buffer.sgetn(block.data(), (std::streamsize)block.size())) > 0;) {
+      if (!sink.write(block.data(), (size_t)got)) break;
+    }
+  }
+
+  zip_discard(zarc);
+}
+
+// Local logs are read again for every request instead of being kept around, they can be far bigger than the memory
+void serveFile(std::filesystem::path const& fpath, httplib::DataSink& sink) {
+  std::ifstream file(fpath, std::ios::in | std::ios::binary);
+
+  std::vector<char> block(64 * 1024);
+  while (file.read(block.data(), block.size()) || file.gcount() > 0) {
+    if (!sink.write(block.data(), (size_t)file.gcount())) return;
+  }
+}
+
+// Keeps the analysis up with a plog the emulator is still writing, until it logs being stopped. Change notifications of the directory
+// wake it up, but NTFS holds them back for a while when the writer keeps the file open, so it looks on its own every FollowMillis too
+std::unique_ptr<PLogAnalyzer> followFile(std::filesystem::path const& fpath, PLogFollower& follower) {
+  constexpr DWORD FollowMillis = 500;
+
+  auto const   dir    = std::filesystem::absolute(fpath).parent_path();
+  DWORD const  filter = FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME; // Renames for a log started anew
+  HANDLE const change = FindFirstChangeNotificationW(dir.c_str(), FALSE, filter);
+
+  fprintf(stderr, "Following %s until the emulator is stopped\n", fpath.string().c_str());
+  while (follower.poll()) {
+    if (change == INVALID_HANDLE_VALUE)
+      Sleep(FollowMillis);
+    else if (WaitForSingleObject(change, FollowMillis) == WAIT_OBJECT_0)
+      FindNextChangeNotification(change);
+  }
+
+  if (change != INVALID_HANDLE_VALUE) FindCloseChangeNotification(change);
+  return follower.finish();
+}
+
+// Archives are served as the plain text they were made from
+void serveArchive(std::filesystem::path const& fpath, httplib::DataSink& sink) {
+  std::ifstream     file(fpath, std::ios::in | std::ios::binary);
+  PLogArchiveReader reader(file);
+
+  PLogAnalyzer::LineInfo info;
+  std::string_view       out;
+  bool                   parsed;
+  std::string            block;
+  while (reader.next(info, out, parsed)) {
+    block.append(reader.line()).push_back('\n');
+    if (block.size() >= 64 * 1024) {
+      if (!sink.write(block.data(), block.size())) return;
+      block.clear();
+    }
+  }
+  if (!block.empty()) sink.write(block.data(), block.size());
+}
+
+bool writeArchive(std::filesystem::path const& from, std::filesystem::path const& to) {
+  std::ifstream in(from, std::ios::in | std::ios::binary);
+  std::ofstream out(to, std::ios::out | std::ios::binary);
+  if (!in || !out) return false;
+
+  PLogArchiveWriter writer(out);
+  std::string       line;
+  while (std::getline(in, line))
+    writer.write(line);
+  if (!writer.finish()) return false;
+
+  fprintf(stderr, "Archived %llu lines, %llu -> %llu bytes (%.1fx)\n", (unsigned long long)writer.lines(), (unsigned long long)writer.bytesIn(),
+          (unsigned long long)writer.bytesOut(), writer.bytesOut() > 0 ? (double)writer.bytesIn() / writer.bytesOut() : 0.0);
+  return true;
+}
+
+bool finishArrow(PLogArrowWriter& writer) {
+  if (!writer.finish()) return false;
+
+  fprintf(stderr, "Exported %llu lines, %llu -> %llu bytes\n", (unsigned long long)writer.lines(), (unsigned long long)writer.bytesIn(),
+          (unsigned long long)writer.bytesOut());
+  return true;
+}
+
+bool writeArrow(std::filesystem::path const& from, std::filesystem::path const& to) {
+  std::ifstream in(from, std::ios::in | std::ios::binary);
+  std::ofstream out(to, std::ios::out | std::ios::binary);
+  if (!in || !out) return false;
+
+  PLogArrowWriter writer(out);
+  std::string     line;
+  while (std::getline(in, line))
+    writer.write(line);
+  return finishArrow(writer);
+}
+
+bool finishTrace(PLogTraceWriter& writer) {
+  if (!writer.finish()) return false;
+
+  fprintf(stderr, "Traced %llu lines into %llu events, %llu bytes (%lld us bins)\n", (unsigned long long)writer.lines(),
+          (unsigned long long)writer.events(), (unsigned long long)writer.bytesOut(), (long long)writer.binMicros());
+  return true;
+}
+
+bool writeTrace(std::filesystem::path const& from, std::filesystem::path const& to) {
+  std::ifstream in(from, std::ios::in | std::ios::binary);
+  std::ofstream out(to, std::ios::out | std::ios::binary);
+  if (!in || !out) return false;
+
+  PLogTraceWriter writer(out);
+  std::string     line;
+  while (std::getline(in, line))
+    writer.write(line);
+  return finishTrace(writer);
+}
+
+// A log the analysis reads whole feeds the exports on the way, it's read and split once for all of them
+std::unique_ptr<PLogAnalyzer> analyseWithExports(std::filesystem::path const& fpath, std::filesystem::path const& arrowPath,
+                                                 std::filesystem::path const& tracePath, PLogOptions const& options) {
+  std::ifstream in(fpath, std::ios::in | std::ios::binary); // Offsets have to be the file's own, text mode would eat the \r's
+  auto          analyser = std::make_unique<PLogAnalyzer>(options);
+
+  std::ofstream                  arrowOut, traceOut;
+  std::optional<PLogArrowWriter> arrow;
+  std::optional<PLogTraceWriter> trace;
+  if (!arrowPath.empty()) {
+    if (arrowOut.open(arrowPath, std::ios::out | std::ios::binary); arrowOut)
+      arrow.emplace(arrowOut);
+    else
+      fprintf(stderr, "Failed to write arrow stream %s\n", arrowPath.string().c_str());
+  }
+  if (!tracePath.empty()) {
+    if (traceOut.open(tracePath, std::ios::out | std::ios::binary); traceOut)
+      trace.emplace(traceOut);
+    else
+      fprintf(stderr, "Failed to write trace %s\n", tracePath.string().c_str());
+  }
+
+  analyser->setTap([&arrow, &trace](std::string_view line, PLogAnalyzer::LineInfo const& info, std::string_view message) {
+    if (arrow) arrow->write(line, info, message);
+    if (trace) trace->write(line, info, message);
+  });
+  analyser->readstream(in);
+  analyser->setTap(nullptr);
+
+  if (arrow && !finishArrow(*arrow)) fprintf(stderr, "Failed to write arrow stream %s\n", arrowPath.string().c_str());
+  if (trace && !finishTrace(*trace)) fprintf(stderr, "Failed to write trace %s\n", tracePath.string().c_str());
+  return analyser;
+}
+
+// Kept as msgpack, the report parts in a checkpoint are log text that doesn't have to be valid UTF-8
+std::unique_ptr<PLogAnalyzer> createCheckpointedAnalyser(std::filesystem::path const& fpath, std::filesystem::path const& checkpointPath,
+                                                         PLogOptions const& options) {
+  nlohmann::json checkpoint;
+  if (std::ifstream in(checkpointPath, std::ios::in | std::ios::binary); in) checkpoint = nlohmann::json::from_msgpack(in, true, false);
+  if (checkpoint.is_discarded()) checkpoint = nullptr; // Starts over
+
+  auto analyser = createResumedAnalyser(fpath, checkpoint, options);
+
+  auto const    bytes = nlohmann::json::to_msgpack(checkpoint);
+  std::ofstream out(checkpointPath, std::ios::out | std::ios::binary);
+  if (!out.write((const char*)bytes.data(), (std::streamsize)bytes.size())) fprintf(stderr, "Failed to write checkpoint %s\n", checkpointPath.string().c_str());
+  return analyser;
+}
+
+// One corpus input: plain and archived plogs, zips with plogs inside, or a shard summary saved by an earlier run
+void summariseInput(std::filesystem::path const& fpath, PLogOptions const& options, PLogCorpus& corpus) {
+  auto const ext = fpath.extension();
+
+  if (ext == ".plog" || ext == ".plogz") {
+    auto analyser = ext == ".plog" ? createFileAnalyser(fpath, options) : createArchiveAnalyser(fpath, options);
+    if (analyser != nullptr)
+      corpus.add(analyser->info());
+    else
+      corpus.skip();
+  } else if (ext == ".zip") {
+    std::ifstream     file(fpath, std::ios::in | std::ios::binary);
+    std::vector<char> archive((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    zip_t* zarc = openMemoryZip(archive.data(), archive.size());
+    if (zarc == nullptr) {
+      corpus.skip();
+      return;
+    }
+
+    zip_int64_t entries = zip_get_num_entries(zarc, 0);
+    for (zip_int64_t i = 0; i < entries; ++i) {
+      zip_stat_t sb;
+      if (zip_stat_index(zarc, i, 0, &sb) < 0 || sb.size == 0 || !std::string_view(sb.name).ends_with(".plog")) continue;
+
+      if (auto analyser = analyseZipEntry(archive.data(), archive.size(), i, options); analyser != nullptr)
+        corpus.add(analyser->info());
+      else
+        corpus.skip();
+    }
+
+    zip_discard(zarc);
+  } else if (ext == ".plogcorpus") {
+    PLogCorpus    shard;
+    std::ifstream file(fpath);
+    if (auto state = nlohmann::json::parse(file, nullptr, false); shard.load(state))
+      corpus.merge(shard);
+    else
+      corpus.skip();
+  }
+}
+
+// Every worker fills a summary of its own, they get merged at the end. Workers analyse one input at a time and split the budget, there
+// are no more of them than budgets of PLogBudget::Minimum fit in it
+std::string analyseCorpus(std::filesystem::path const& dir, PLogOptions const& options, std::filesystem::path const& shardPath) {
+  std::vector<std::filesystem::path> inputs;
+  for (auto const& entry: std::filesystem::recursive_directory_iterator(dir, std::filesystem::directory_options::skip_permission_denied)) {
+    if (!entry.is_regular_file()) continue;
+    if (auto const ext = entry.path().extension(); ext == ".plog" || ext == ".plogz" || ext == ".zip" || ext == ".plogcorpus") inputs.push_back(entry.path());
+  }
+
+  size_t count = std::min<size_t>(std::thread::hardware_concurrency(), inputs.size());
+  if (options.memoryBudget != 0) count = std::min(count, options.memoryBudget / PLogBudget::Minimum);
+
+  std::atomic<size_t>      nextInput = 0;
+  std::vector<PLogCorpus>  shards(std::max<size_t>(count, 1));
+  std::vector<std::thread> workers;
+  auto const               shared = options.share(shards.size());
+  for (auto& shard: shards) {
+    workers.emplace_back([&inputs, &nextInput, &shared, &shard] {
+      for (size_t i; (i = nextInput++) < inputs.size();)
+        summariseInput(inputs[i], shared, shard);
+    });
+  }
+
+  PLogCorpus corpus;
+  for (size_t i = 0; i < workers.size(); ++i) {
+    workers[i].join();
+    corpus.merge(shards[i]);
+  }
+
+  if (!shardPath.empty()) {
+    std::ofstream out(shardPath);
+    if (!(out << corpus.save().dump())) fprintf(stderr, "Failed to write corpus shard %s\n", shardPath.string().c_str());
+  }
+
+  fprintf(stderr, "Summarised %zu inputs\n", inputs.size());
+  return corpus.report().dump(2, ' ', true);
+}
+
+// Links to the lines around every piece of evidence, served by createHttpServer(). Reports of a zip entry link to the entry alone
+void linkEvidence(nlohmann::json& report, std::optional<zip_uint64_t> entry = std::nullopt) {
+  auto const evidence = report.find("evidence");
+  if (evidence == report.end()) return;
+
+  auto const select = entry.has_value() ? std::format("entry={}&", *entry) : std::string();
+  for (auto& item: *evidence) {
+    auto const line = item["line"].get<uint64_t>();
+    item["link"]    = std::format("/lines?{}from={}&to={}", select, line > 5 ? line - 5 : 1, line + 5);
+  }
+}
+
+std::string spitLinked(PLogAnalyzer const& analyser, std::optional<zip_uint64_t> entry = std::nullopt) {
+  auto report = analyser.info();
+  linkEvidence(report, entry);
+  return report.dump(2, ' ', true);
 }
 
 int32_t main(int32_t argc, char* argv[]) {
   if (argc < 2) {
-    fprintf(stderr, "Usage: %s <p7d file path> [--noblock]", argv[0]);
+    fprintf(stderr,
+            "Usage: %s <p7d file path or corpus directory> [--noblock] [--templates] [--follow] [--archive <.plogz path>] [--arrow <.arrows path>]"
+            " [--trace <.json path>] [--checkpoint <path>] [--shard <.plogcorpus path>] [--diff <later plog path>] [--memory <budget in MiB>] [--progress] [--joint]",
+            argv[0]);
     return LogAnExitCodes::ArgumentFail;
   }
 
+  bool                  noBlock = false;
+  bool                  follow  = false; // Local plogs are analysed while the emulator writes them
+  bool                  joint   = false; // Zips with several plogs get one folded report instead of the menu
+  PLogOptions           options;
+  std::filesystem::path archivePath;    // Local plogs get archived there too
+  std::filesystem::path arrowPath;      // And exported there as Arrow record batches
+  std::filesystem::path tracePath;      // And as a thread timeline for Perfetto
+  std::filesystem::path checkpointPath; // A local plog that is still being written is analysed from where the last run left off
+  std::filesystem::path shardPath;      // Corpus summary state, the directory of another run can take it in as an input
+  std::filesystem::path diffPath;       // Later run of the same title, compared against the given log
+  for (int32_t i = 2; i < argc; ++i) {
+    auto const arg = std::string_view(argv[i]);
+    if (arg == "--noblock")
+      noBlock = true;
+    else if (arg == "--templates")
+      options.templates = true;
+    else if (arg == "--follow")
+      follow = true;
+    else if (arg == "--joint")
+      joint = true;
+    else if (arg == "--archive" && i + 1 < argc)
+      archivePath = argv[++i];
+    else if (arg == "--arrow" && i + 1 < argc)
+      arrowPath = argv[++i];
+    else if (arg == "--trace" && i + 1 < argc)
+      tracePath = argv[++i];
+    else if (arg == "--checkpoint" && i + 1 < argc)
+      checkpointPath = argv[++i];
+    else if (arg == "--shard" && i + 1 < argc)
+      shardPath = argv[++i];
+    else if (arg == "--diff" && i + 1 < argc)
+      diffPath = argv[++i];
+    else if (arg == "--memory" && i + 1 < argc)
+      options.memoryBudget = std::strtoull(argv[++i], nullptr, 10) * 1024 * 1024;
+    else if (arg == "--progress")
+      options.progress = [](nlohmann::json const& partial) { // One JSON object per line, the final report still goes to stdout
+        static std::mutex lock; // Zip entries are analysed on several threads
+        std::lock_guard   guard(lock);
+        fprintf(stderr, "%s\n", partial.dump(-1, ' ', true).c_str());
+      };
+  }
+
   std::thread httpServer;
 
   if (auto argLink = std::string_view(argv[1]); !argLink.empty()) {
     std::unique_ptr<PLogAnalyzer> analyser;
-    std::vector<char>             growingdata, unpdata;
+    std::string                   report;
+    auto                          growingdata = std::make_shared<std::vector<char>>(); // Downloads, the HTTP server shares them
 
     if (argLink.starts_with("http")) {
       int32_t need = MultiByteToWideChar(CP_UTF8, 0, argLink.data(), -1, nullptr, 0);
@@ -173,7 +663,12 @@ int32_t main(int32_t argc, char* argv[]) {
       DWORD  downloaded  = 0;
 
       if ((csize == 0) || (csize > sizeof(buffer))) { // Growing case
-        growingdata.reserve(csize);
+        if (options.memoryBudget != 0 && csize > options.memoryBudget / 2) {
+          fprintf(stderr, "Server wants to send more than half of the memory budget!\n");
+          return LogAnExitCodes::HttpTooMuch;
+        }
+
+        growingdata->reserve(csize);
 
         do {
           WinHttpQueryDataAvailable(hRequ, &availdata);
@@ -196,16 +691,22 @@ int32_t main(int32_t argc, char* argv[]) {
             }
           }
 
-          if ((csize > 0) && ((growingdata.size() + downloaded) > csize)) {
+          if ((csize > 0) && ((growingdata->size() + downloaded) > csize)) {
             fprintf(stderr, "Server sent way more data than it should!\n");
             return LogAnExitCodes::HttpTooMuch;
           }
 
-          growingdata.insert(growingdata.end(), std::begin(buffer), std::begin(buffer) + downloaded);
+          // The archive can't be analysed in parts, it has to fit next to the analysis
+          if (options.memoryBudget != 0 && growingdata->size() + downloaded > options.memoryBudget / 2) {
+            fprintf(stderr, "Server sent more than half of the memory budget!\n");
+            return LogAnExitCodes::HttpTooMuch;
+          }
+
+          growingdata->insert(growingdata->end(), std::begin(buffer), std::begin(buffer) + downloaded);
         } while (true);
 
-        outdata     = growingdata.data();
-        outdatasize = growingdata.size();
+        outdata     = growingdata->data();
+        outdatasize = growingdata->size();
       } else { // Static case
         char*  bufpos  = buffer;
         size_t bufleft = sizeof(buffer);
@@ -240,11 +741,15 @@ int32_t main(int32_t argc, char* argv[]) {
           }
         } while (bufleft > 0);
 
-        outdata     = buffer;
-        outdatasize = sizeof(buffer) - bufleft;
+        growingdata->assign(buffer, bufpos);
+        outdata     = growingdata->data();
+        outdatasize = growingdata->size();
       }
 
       if (outdata != nullptr && outdatasize > 0) {
+        // The download stays around for the HTTP server, the analysis gets what's left of the budget
+        if (options.memoryBudget != 0) options.memoryBudget -= std::min(outdatasize, options.memoryBudget / 2);
+
         if (std::memcmp(outdata, "PK", 2) == 0) { // Most likely Zip archive, handle it
           zip_error_t   zerr;
           zip_source_t* zsrc;
@@ -273,7 +778,6 @@ int32_t main(int32_t argc, char* argv[]) {
           };
 
           std::vector<MenuEntry> files;
-          std::string            serveData;
 
           zip_int64_t num_files = zip_get_num_entries(zarc, 0);
           for (zip_int64_t i = 0; i < num_files; ++i) {
@@ -305,7 +809,7 @@ int32_t main(int32_t argc, char* argv[]) {
               continue;
             }
 
-            std::string_view plogdatasv(plogdata);
+            std::string_view plogdatasv(plogdata, sizeof(plogdata));
 
             auto const plogend = plogdatasv.find(';');
             if (plogend == std::string_view::npos) {
@@ -315,19 +819,6 @@ int32_t main(int32_t argc, char* argv[]) {
             }
 
             files.emplace_back(i, sb.size, std::string(plogdatasv.substr(0, plogend)));
-
-            {
-              if (!serveData.empty() && serveData.back() != '\n') serveData.push_back('\n');
-              auto const prevSize = serveData.size();
-              serveData.resize(prevSize + sb.size);
-              std::memcpy(serveData.data() + prevSize, plogdata, sizeof(plogdata));
-              auto const restSize = sb.size - sizeof(plogdata);
-              if (zip_fread(zf, serveData.data() + prevSize + sizeof(plogdata), restSize) != restSize) {
-                fprintf(stderr, "Warning, failed to read %s for HTTP serving purposes\n", sb.name);
-                serveData.resize(prevSize);
-              }
-            }
-
             zip_fclose(zf);
           }
 
@@ -338,31 +829,22 @@ int32_t main(int32_t argc, char* argv[]) {
             return LogAnExitCodes::ZipNoFile;
           }
 
-          auto unpackZipFile = [&unpdata, zarc, zsrc](MenuEntry& lf) {
-            zip_file_t* zf = zip_fopen_index(zarc, lf.index, 0);
-
-            if (zf == nullptr) {
-              fprintf(stderr, "Failed to open zip file: %s\n", zip_strerror(zarc));
-              zip_close(zarc);
-              zip_source_close(zsrc);
-              return LogAnExitCodes::ZipUnexpected;
-            }
-
-            unpdata.resize(lf.size);
-            if (zip_fread(zf, unpdata.data(), unpdata.size()) != lf.size) {
-              fprintf(stderr, "Failed to read zip file: %s\n", zip_strerror(zarc));
-              zip_close(zarc);
-              zip_source_close(zsrc);
-              return LogAnExitCodes::ZipUnexpected;
-            }
+          zip_close(zarc);
+          zip_source_close(zsrc);
 
-            zip_fclose(zf);
-            return LogAnExitCodes::Success;
-          };
+          {
+            std::vector<zip_uint64_t> entries;
+            for (auto const& file: files)
+              entries.push_back(file.index);
 
-          httpServer = createHttpServer(std::move(serveData));
+            // The server keeps the (still compressed) archive alive after this block
+            httpServer = createHttpServer([archive = growingdata, entries](httplib::DataSink& sink) { serveMergedEntries(*archive, entries, sink); }, nullptr,
+                                          [archive = growingdata](zip_uint64_t entry, httplib::DataSink& sink) { serveEntry(*archive, entry, sink); });
+          }
 
-          if (files.size() > 1) { // Entering interactive mode
+          if (files.size() == 1) {
+            analyser = analyseZipEntry(outdata, outdatasize, files.front().index, options);
+          } else if (!joint) { // Entering interactive mode
             while (true) {
               std::cout << "\x1b[0;0H\x1b[2J0. [Exit]" << std::endl;
               for (auto it = files.begin(); it != files.end(); ++it) {
@@ -371,65 +853,89 @@ int32_t main(int32_t argc, char* argv[]) {
 
               std::cout << std::endl << "Enter index: ";
               int32_t index = 0;
-              std::cin >> index;
+              if (!(std::cin >> index)) break;
               getchar(); // Skip newline
               if (index == 0) break;
-              if (index > files.size()) continue;
-              if (unpackZipFile(files[index - 1]) != LogAnExitCodes::Success) {
-              }
+              if (index < 0 || (size_t)index > files.size()) continue;
               std::cout << "\x1b[0;0H\x1b[2J";
-              std::cout << createMemAnalyser(unpdata.data(), unpdata.size())->spit().c_str();
-              unpdata.clear();
+              if (auto entry = analyseZipEntry(outdata, outdatasize, files[index - 1].index, options); entry != nullptr)
+                std::cout << spitLinked(*entry, files[index - 1].index).c_str();
               std::cout << std::endl << "Press enter to go back...";
               while (getchar() != '\n')
                 ;
             }
 
-            zip_close(zarc);
-            zip_source_close(zsrc);
+            if (httpServer.joinable()) httpServer.detach();
             return LogAnExitCodes::Success;
           } else {
-            if (unpackZipFile(files.front()) != LogAnExitCodes::Success) {
-              zip_close(zarc);
-              zip_source_close(zsrc);
-              return LogAnExitCodes::ZipUnexpected;
+            // Main and child process logs are independent until the very end, analyse them side by side on a worker per core. All the
+            // analysers are alive for the joint report, they split the budget
+            std::vector<std::unique_ptr<PLogAnalyzer>> analysers(files.size());
+            std::atomic<size_t>                        nextEntry = 0;
+            std::vector<std::thread>                   workers(std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), files.size()));
+            auto const                                 shared = options.share(files.size());
+            for (auto& worker: workers) {
+              worker = std::thread([&analysers, &files, &nextEntry, &shared, outdata, outdatasize] {
+                for (size_t i; (i = nextEntry++) < files.size();)
+                  analysers[i] = analyseZipEntry(outdata, outdatasize, files[i].index, shared);
+              });
             }
-            outdata     = unpdata.data();
-            outdatasize = unpdata.size();
-            zip_close(zarc);
-            zip_source_close(zsrc);
+
+            for (auto& worker: workers)
+              worker.join();
+
+            report = spitJoint(analysers, [&files](size_t i, nlohmann::json& process) { linkEvidence(process, files[i].index); });
           }
         } else {
-          std::string buf(outdata, outdata + outdatasize);
-          httpServer = createHttpServer(std::move(buf));
+          httpServer = createHttpServer([lines = growingdata](httplib::DataSink& sink) { sink.write(lines->data(), lines->size()); });
+          analyser   = createMemAnalyser(outdata, outdatasize, options);
         }
-
-        analyser = createMemAnalyser(outdata, outdatasize);
       } else {
         fprintf(stderr, "Invalid output buffer!\n");
         return LogAnExitCodes::BufferFail;
       }
+    } else if (std::filesystem::is_directory(argLink)) {
+      report = analyseCorpus(argLink, options, shardPath);
+    } else if (!diffPath.empty()) {
+      if (std::filesystem::exists(argLink) && std::filesystem::exists(diffPath))
+        report = diffLogs(argLink, diffPath, options);
+      else
+        fprintf(stderr, "Both logs have to exist to be compared!\n");
     } else if (auto fpath = std::filesystem::path(argLink); std::filesystem::exists(fpath)) {
-      {
-        std::ifstream f(fpath);
-
-        std::stringstream ss;
-        ss << f.rdbuf();
-
-        httpServer = createHttpServer(ss.str());
+      if (fpath.extension() == ".plogz") {
+        httpServer = createHttpServer([fpath](httplib::DataSink& sink) { serveArchive(fpath, sink); });
+        analyser   = createArchiveAnalyser(fpath, options);
+        if (analyser == nullptr) fprintf(stderr, "Invalid plog archive!\n");
+      } else {
+        auto follower = follow ? std::make_shared<PLogFollower>(fpath, options) : nullptr;
+        httpServer    = createHttpServer([fpath](httplib::DataSink& sink) { serveFile(fpath, sink); }, follower);
+
+        bool const readWhole = follower == nullptr && checkpointPath.empty(); // Followed and checkpointed logs are read a part at a time
+        if (follower != nullptr)
+          analyser = followFile(fpath, *follower);
+        else if (!checkpointPath.empty())
+          analyser = createCheckpointedAnalyser(fpath, checkpointPath, options);
+        else
+          analyser = arrowPath.empty() && tracePath.empty() ? createFileAnalyser(fpath, options) : analyseWithExports(fpath, arrowPath, tracePath, options);
+
+        if (!archivePath.empty() && !writeArchive(fpath, archivePath)) fprintf(stderr, "Failed to write archive %s\n", archivePath.string().c_str());
+        if (!arrowPath.empty() && !readWhole && !writeArrow(fpath, arrowPath))
+          fprintf(stderr, "Failed to write arrow stream %s\n", arrowPath.string().c_str());
+        if (!tracePath.empty() && !readWhole && !writeTrace(fpath, tracePath)) fprintf(stderr, "Failed to write trace %s\n", tracePath.string().c_str());
       }
-      analyser = createFileAnalyser(fpath);
     }
 
-    if (analyser != nullptr) {
-      std::cout << analyser->spit().c_str();
+    if (analyser != nullptr) report = spitLinked(*analyser);
+
+    if (!report.empty()) {
+      std::cout << report.c_str();
     } else {
       fprintf(stderr, "P7Dump fail: No suitable analyser found for specified link\n");
       return LogAnExitCodes::NoAnalyser;
     }
   }
 
-  if (argc == 2 || std::string_view(argv[2]) != "--noblock") {
+  if (!noBlock) {
     while (true)
       std::this_thread::sleep_for(std::chrono::seconds(1));
   }
@@ -1,15 +1,25 @@
 import dotenv from 'dotenv';
 import bind from 'bindings';
 import { Client, GatewayIntentBits, REST, Routes, SlashCommandBuilder, EmbedBuilder, MessageFlags } from 'discord.js';
-import { unzip, HTTPRangeReader } from 'unzipit';
+import { createWriteStream } from 'node:fs';
+import { mkdtemp, rm } from 'node:fs/promises';
+import { tmpdir } from 'node:os';
+import { join } from 'node:path';
+import { Readable } from 'node:stream';
+import { pipeline } from 'node:stream/promises';
 
 dotenv.config();
 
 const FAILED_LOGS = ['exception', 'badgpu', 'graphics'];
-const MAX_LOG_SIZE = 10 * 1024 * 1024;
 const MAX_EMBEDS = 3;
+const ANALYSE_TIMEOUT = 60 * 1000;
+const PROGRESS_INTERVAL = 3 * 1000;
 
 const logan = bind('./Release/psOff_logan');
+if (process.env.LOGAN_THREADS) logan.setPoolSize(parseInt(process.env.LOGAN_THREADS));
+
+// MiB a single analysis may hold on to, unbounded if unset
+const ANALYSE_MEMORY = process.env.LOGAN_MEMORY ? parseInt(process.env.LOGAN_MEMORY) : undefined;
 
 const client = new Client({
 	intents: [
@@ -50,6 +60,21 @@ const rest = new REST({ version: '10' }).setToken(process.env.DISCORD_TOKEN);
 	}
 })();
 
+// Zips can be big, they are streamed to a temporary file the addon opens itself instead of being held in memory
+const withDownloadedFile = async (url, callback) => {
+	const dir = await mkdtemp(join(tmpdir(), 'logan-'));
+	try {
+		const response = await fetch(url);
+		if (!response.ok) throw new Error(`Download failed with status ${response.status}`);
+
+		const file = join(dir, 'attachment.zip');
+		await pipeline(Readable.fromWeb(response.body), createWriteStream(file));
+		return await callback(file);
+	} finally {
+		await rm(dir, { recursive: true, force: true });
+	}
+};
+
 const createEmbedWithError = (title, descr) => {
 	return new EmbedBuilder()
 		.setColor('#A00011')
@@ -64,14 +89,20 @@ const createEmbedFromLog = (interaction, logData) => {
 		(logData.labels.length > 0 ? `\n**Possible GitHub issue labels**:\n${logData.labels.map(item => `* ${item}`).join('\n')}\n` : '') +
 		(logData.hints.length > 0 ? `\n**Hints**:\n${logData.hints.map(item => `* ${item}`).join('\n')}\n` : '');
 
+	const topOffenders = (title, tally) =>
+		tally && tally.top.length > 0 ? `\n**${title}**:\n${tally.top.slice(0, 5).map(item => `* ${item.name} (${item.count})`).join('\n')}\n` : '';
+
 	const builders = {
 		'main-process': () =>
 			`**User's GPU**: ${logData['user-gpu']}\n` +
-			`**User's language**: ${logData['user-lang']}\n` + hintsAndLables,
+			`**User's language**: ${logData['user-lang']}\n` + hintsAndLables +
+			topOffenders('Vulkan validation errors', logData['vk_validation']),
 
 		'child-process': () =>
 			`**Title ID**: ${logData['title_id']}\n` +
 			`**PS4 Pro mode**: ${logData['title_neo'] ? 'Yes' : 'No'}\n` + hintsAndLables +
+			topOffenders('Missing symbols', logData['missing_symbols']) +
+			topOffenders('Unimplemented calls', logData['todo_calls']) +
 			(logData.firmware.length > 0 ? `\n**Loaded PS4 firmware libraries**:\n${logData.firmware.map(item => `* ${item}`).join('\n')}\n` : ''),
 	};
 
@@ -83,6 +114,30 @@ const createEmbedFromLog = (interaction, logData) => {
 	return embed;
 };
 
+// Shows the partial reports of a log still being analyzed. Discord rate limits the edits, so they are throttled and chained, the final
+// reply waits for them with settled()
+const createProgress = (interaction, filename) => {
+	let last = 0;
+	let edits = Promise.resolve();
+
+	return {
+		progress: (partial, entry) => {
+			const now = Date.now();
+			if (now - last < PROGRESS_INTERVAL) return;
+			last = now;
+
+			try {
+				partial.__filename = entry ?? filename;
+				const embed = createEmbedFromLog(interaction, partial).setFooter({ text: `Still analyzing, ${partial.partial.lines} lines read so far...` });
+				edits = edits.then(() => interaction.editReply({ content: '', embeds: [embed] })).catch(console.error);
+			} catch (error) { // Partial reports are a nicety, they must not take the bot down
+				console.error(error);
+			}
+		},
+		settled: () => edits,
+	};
+};
+
 client.on('interactionCreate', async (interaction) => {
 	if (!interaction.isCommand()) return;
 	if (interaction.channelId !== process.env.CHANNEL_ID) {
@@ -110,48 +165,35 @@ client.on('interactionCreate', async (interaction) => {
 			return;
 		}
 
+		const { progress, settled } = createProgress(interaction, attachment.name);
+
 		try {
 			if (isZip) {
-				const reader = new HTTPRangeReader(attachment.url)
-				const zip = await unzip(reader);
-
-				const embeds = [];
-				let text = '';
-
-				for (const [filename, file] of Object.entries(zip.entries)) {
-					try {
-						if (embeds.length >= MAX_EMBEDS) {
-							text = `Too many log files inside zip archive, we\'re processed only first ${embeds.length} of them.`;
-							break;
-						}
-						if (file.dir) continue;
-						if (!filename.endsWith('.p7d')) continue;
-						if (file.encrypted) {
-							embeds.push(createEmbedWithError(filename, 'This file is encrypted, we can\'t process it'));
-							continue;
-						}
-						if (file.size > MAX_LOG_SIZE) {
-							embeds.push(createEmbedWithError(filename, 'This file is too big, we can\'t process it'));
-							continue;
-						}
-						const logdata = logan.meman(await file.arrayBuffer());
-						logdata.__filename = filename;
-						embeds.push(createEmbedFromLog(interaction, logdata));
-					} catch (error) { }
-				}
+				const entries = await withDownloadedFile(attachment.url, (file) =>
+					logan.analyzeZip(file, { signal: AbortSignal.timeout(ANALYSE_TIMEOUT), memory: ANALYSE_MEMORY, progress }),
+				);
+				await settled();
 
-				if (embeds.length === 0) {
+				if (entries.length === 0) {
 					await interaction.editReply('No log files found in the provided zip archive.');
 					return;
 				}
 
+				const embeds = entries.slice(0, MAX_EMBEDS).map(({ name, result, error }) => {
+					if (error !== undefined) return createEmbedWithError(name, `We can\'t process this file: ${error}`);
+					result.__filename = name;
+					return createEmbedFromLog(interaction, result);
+				});
+
+				const text = entries.length > MAX_EMBEDS ? `Too many log files inside zip archive, we\'re showing only first ${MAX_EMBEDS} of ${entries.length}.` : '';
 				await interaction.editReply({ content: text, embeds });
 			} else {
 				await interaction.editReply('Downloading your log file...');
 				await fetch(attachment.url).then(async (response) => {
 					await interaction.editReply('Log file downloaded! Analyzing...');
 					const abuffer = await response.arrayBuffer();
-					const logdata = logan.meman(abuffer);
+					const logdata = await logan.memanAsync(abuffer, { signal: AbortSignal.timeout(ANALYSE_TIMEOUT), memory: ANALYSE_MEMORY, progress });
+					await settled();
 					logdata.__filename = attachment.name;
 					await interaction.editReply({ content: '', embeds: [createEmbedFromLog(interaction, logdata)] });
 
@@ -159,6 +201,7 @@ client.on('interactionCreate', async (interaction) => {
 			}
 		} catch (error) {
 			console.error(error);
+			await settled();
 			await interaction.editReply('Error processing the log file! Your log file might be empty or corrupted.');
 		}
 	}
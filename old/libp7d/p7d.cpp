@@ -2,25 +2,396 @@
 
 #include "p7exceptions.h"
 
-#include <any>
+#include <algorithm>
 #include <bit>
 #include <cstdarg>
 #include <cstdint>
 #include <cstdio>
-#include <exception>
+#include <cstring>
+#include <condition_variable>
 #include <limits>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <type_traits>
 #include <vector>
 
 bool P7Dump::validate() {
-  return !m_streams.empty() && !m_processName.empty() && !m_hostName.empty() && m_processId != std::numeric_limits<uint32_t>::max() &&
+  auto const hasStreams = std::any_of(m_streams.begin(), m_streams.end(), [](auto const& stream) { return stream != nullptr; });
+  return hasStreams && !m_processName.empty() && !m_hostName.empty() && m_processId != std::numeric_limits<uint32_t>::max() &&
          m_createTime != std::numeric_limits<uint64_t>::max();
 }
 
+void P7Dump::ChunkReader::fail(size_t nbytes, bool isSkip) {
+  if (!m_failed) {
+    m_failed       = true;
+    m_failAvail    = (uint32_t)available();
+    m_failRequired = (uint32_t)nbytes;
+    m_failSkip     = isSkip;
+  }
+
+  m_pos = m_size;
+}
+
+void P7Dump::ChunkReader::read(void* buffer, size_t nread) {
+  if (nread > available()) {
+    std::memset(buffer, 0, nread);
+    return fail(nread, false);
+  }
+
+  std::memcpy(buffer, m_data + m_pos, nread);
+  m_pos += nread;
+}
+
+void P7Dump::ChunkReader::skip(size_t nbytes) {
+  if (nbytes > available()) return fail(nbytes, true);
+  m_pos += nbytes;
+}
+
+size_t P7Dump::descriptionSize(P7Line const& line) {
+  return line.formatInfos.size() * sizeof(p7argument) + line.formatString.size() * sizeof(char16_t) + line.fileName.size() + line.funcName.size();
+}
+
+void P7Dump::limitDescription(StreamStorage& stream, P7Line& line) const {
+  if (stream.descriptionBytes + descriptionSize(line) > m_descriptionLimit) {
+    ++stream.truncatedDescriptions;
+    line.fileName = {}, line.funcName = {}; // Only conversion shows them
+
+    auto const room = m_descriptionLimit - std::min(m_descriptionLimit, stream.descriptionBytes + line.formatInfos.size() * sizeof(p7argument));
+    if (auto cut = room / sizeof(char16_t); cut < line.formatString.size()) {
+      // Arguments without a specifier are ignored by vswprintf(), half a specifier isn't. None is longer than 16 characters
+      if (auto const spec = cut > 0 ? line.formatString.rfind(u'%', cut - 1) : p7string::npos; spec != p7string::npos && cut - spec < 16) cut = spec;
+
+      size_t percents = 0; // An odd run of them before the cut would leave a lone one
+      while (percents < cut && line.formatString[cut - percents - 1] == u'%')
+        ++percents;
+      if (percents % 2 != 0) --cut;
+
+      line.formatString = line.formatString.substr(0, cut); // Not resize(), that would keep the capacity
+    }
+  }
+
+  stream.descriptionBytes += descriptionSize(line);
+}
+
+size_t P7Dump::truncatedDescriptions() const {
+  size_t total = 0;
+  for (auto const& stream: m_streams) {
+    if (stream != nullptr) total += stream->truncatedDescriptions;
+  }
+  return total;
+}
+
+bool P7Dump::plausibleChunk(StreamInfo si, const char* body, size_t checkable, size_t dumpLeft, bool knownChannel) const {
+  if (si.size <= sizeof(StreamInfo) + sizeof(StreamItem) || (si.size - sizeof(StreamInfo)) > dumpLeft) return false;
+  if (knownChannel && m_streams[si.channel] == nullptr) return false;
+
+  size_t const bodySize = si.size - sizeof(StreamInfo);
+  checkable             = std::min(checkable, bodySize);
+
+  // psOff only writes trace streams, so every item header in the chunk must look like one and the sizes have to add up
+  size_t   pos   = 0;
+  uint32_t items = 0;
+  while (pos + sizeof(StreamItem) <= checkable) {
+    uint32_t raw;
+    std::memcpy(&raw, body + pos, sizeof(raw));
+    if (m_endian != std::endian::native) raw = swap_endian(raw);
+
+    auto const item = std::bit_cast<StreamItem>(raw);
+    if (item.size < sizeof(StreamItem) || item.type != 0x00) return false;
+    switch (item.subtype) {
+      case 0x00:
+      case 0x01:
+      case 0x02:
+      case 0x03:
+      case 0x04:
+      case 0x07:
+      case 0x09: break;
+      default: return false;
+    }
+
+    pos += item.size, ++items;
+  }
+
+  if (pos == bodySize) return true;
+  return pos < bodySize && checkable < bodySize && items >= 4; // Chunk is bigger than what we could check, trust it if the start is sane
+}
+
+bool P7Dump::resync(size_t from) {
+  size_t pos = from;
+
+  while (io_seek(pos) && io_available() >= sizeof(StreamInfo) + sizeof(StreamItem)) {
+    size_t const wsize = std::min(P7D_SCAN_WINDOW, io_available());
+    m_scanWindow.resize(wsize);
+    if (!io_read(m_scanWindow.data(), wsize)) return false;
+
+    for (size_t off = 0; off + sizeof(StreamInfo) + sizeof(StreamItem) <= wsize; ++off) {
+      StreamInfo si;
+      std::memcpy(&si._raw, m_scanWindow.data() + off, sizeof(si._raw));
+      if (m_endian != std::endian::native) si._raw = swap_endian(si._raw);
+
+      auto const body     = m_scanWindow.data() + off + sizeof(StreamInfo);
+      auto const dumpLeft = io_available() + wsize - off - sizeof(StreamInfo);
+      if (plausibleChunk(si, body, wsize - off - sizeof(StreamInfo), dumpLeft, true)) {
+        fprintf(stderr, "P7Dump: Resynchronized at offset %zu after skipping %zu bytes\n", pos + off, pos + off - from + 1);
+        m_skippedBytes += pos + off - from + 1;
+        ++m_recoveredChunks;
+        return io_seek(pos + off);
+      }
+    }
+
+    if (wsize < P7D_SCAN_WINDOW) break; // Reached the end of the dump
+    pos += wsize - sizeof(StreamInfo) - sizeof(StreamItem) + 1;
+  }
+
+  return false;
+}
+
+bool P7Dump::readBatch(P7Error& error) {
+  m_chunks.clear();
+  m_chunkData.clear();
+
+  size_t     batchBytes = 0;
+  StreamInfo si;
+
+  while (m_chunks.size() < P7D_BATCH_CHUNKS && batchBytes < m_batchBytes && io_available() >= sizeof(si)) {
+    auto const chunkStart = io_tell();
+
+    if (!io_read(&si._raw, sizeof(si._raw))) break;
+    if (m_endian != std::endian::native) si._raw = swap_endian(si._raw);
+    if (si.size <= sizeof(StreamInfo)) continue;
+
+    ChunkRef chunk = {
+        .channel  = (uint8_t)si.channel,
+        .data     = nullptr,
+        .offset   = 0,
+        .size     = std::min<size_t>(si.size - sizeof(StreamInfo), io_available()),
+        .fullSize = si.size - sizeof(StreamInfo),
+    };
+
+    if ((chunk.data = io_view(chunk.size)) == nullptr) {
+      chunk.offset = m_chunkData.size();
+      m_chunkData.resize(chunk.offset + chunk.size);
+      if (!io_read(m_chunkData.data() + chunk.offset, chunk.size)) {
+        error = {.status = P7Status::NotEnoughData, .args = {0, (uint32_t)chunk.size, 0}};
+        break;
+      }
+    }
+
+    if (m_recovery && chunk.size == chunk.fullSize) {
+      auto const body = chunk.data != nullptr ? chunk.data : m_chunkData.data() + chunk.offset;
+      if (!plausibleChunk(si, body, chunk.size, chunk.size, false)) {
+        if (chunk.data == nullptr) m_chunkData.resize(chunk.offset);
+        if (!resync(chunkStart + 1)) break;
+        continue;
+      }
+    }
+
+    auto& stream = m_streams[si.channel];
+    if (stream == nullptr) {
+      stream          = std::make_unique<StreamStorage>();
+      stream->channel = si.channel;
+    }
+
+    batchBytes += chunk.size;
+    m_chunks.push_back(chunk);
+  }
+
+  for (auto& chunk: m_chunks) { // Storage is stable now
+    if (chunk.data == nullptr) chunk.data = m_chunkData.data() + chunk.offset;
+  }
+
+  return !m_chunks.empty();
+}
+
+void P7Dump::decodeChannel(StreamStorage& stream, std::vector<uint32_t> const& chunks, ChannelBatch& out) {
+  out.lines.clear();
+  out.changes.clear();
+  out.text.clear();
+  out.error      = {};
+  out.errorChunk = std::numeric_limits<uint32_t>::max();
+
+  for (auto const index: chunks) {
+    auto const& chunk = m_chunks[index];
+
+    ChunkReader reader(chunk.data, chunk.size, m_endian);
+
+    auto status = P7Status::Ok;
+    while (status == P7Status::Ok && reader.available() > 0) {
+      StreamItem item;
+      reader.read_endian(item);
+      if (reader.failed()) {
+        status = (out.error = reader.error()).status;
+        break;
+      }
+
+      if (item.size < sizeof(StreamItem)) {
+        out.error = {.status = P7Status::BrokenStreamItem, .args = {item.size, item.subtype, item.type}};
+        status    = out.error.status;
+        break;
+      }
+
+      item.size -= sizeof(StreamItem);
+
+      switch (item.type) {
+        case 0x00: { // STREAM_TRACE
+          uint32_t actualRead = 0;
+          status              = processTraceSItem(stream, item, reader, out, index, actualRead);
+
+          if (item.size > actualRead) {
+            reader.skip(item.size - actualRead);
+          }
+        } break;
+
+        default: {
+          reader.skip(item.size);
+          fprintf(stderr, "Stream %d ignored!\n", item.type);
+        } break;
+      }
+
+      if (status == P7Status::Ok && reader.failed()) status = (out.error = reader.error()).status;
+    }
+
+    if (status == P7Status::Ok && chunk.size < chunk.fullSize)
+      status = (out.error = {.status = P7Status::NotEnoughData, .args = {(uint32_t)chunk.size, (uint32_t)chunk.fullSize, 0}}).status;
+
+    // Running out of a chunk that is all there means an item claimed more than the chunk holds, not that the dump was cut short
+    if (status == P7Status::NotEnoughData && chunk.size == chunk.fullSize) out.error = {.status = P7Status::CorruptedItem, .item = "Stream Item Size"};
+
+    if (status != P7Status::Ok) {
+      // Lines decoded before the failure still have to be rendered, so the error is reported at its position in the chunk order
+      out.errorChunk = index;
+      if (!m_recovery || chunk.size < chunk.fullSize) return;
+
+      // The chunk header was sane, so the next chunk is still where it is supposed to be
+      fprintf(stderr, "P7Dump: Dropped the rest of a corrupted chunk on channel %u\n", chunk.channel);
+      ++m_recoveredChunks;
+      out.error      = {};
+      out.errorChunk = std::numeric_limits<uint32_t>::max();
+    }
+  }
+}
+
+void P7Dump::applyChanges(StreamStorage& stream, ChannelBatch& batch, size_t& next, size_t line) {
+  for (; next < batch.changes.size() && batch.changes[next].line <= line; ++next) {
+    auto& change = batch.changes[next];
+    if (change.moduleId < 0) {
+      stream.info = std::move(change.info);
+      continue;
+    }
+
+    if ((size_t)change.moduleId >= stream.modules.size()) stream.modules.resize(change.moduleId + 1);
+    auto& mod = stream.modules[change.moduleId];
+    if (!mod.defined) mod = std::move(change.module); // Same as lines, the first definition stays
+  }
+}
+
+class P7Dump::DecodePool {
+  public:
+  DecodePool(P7Dump& dump, std::array<std::vector<uint32_t>, 32> const& chunks, std::array<ChannelBatch, 32>& batches)
+      : m_dump(dump), m_chunks(chunks), m_batches(batches) {}
+
+  ~DecodePool() {
+    {
+      std::lock_guard guard(m_lock);
+      m_stop = true;
+    }
+    m_wake.notify_all();
+    for (auto& worker: m_workers)
+      worker.join();
+  }
+
+  // Returns once every channel that has chunks in the batch is decoded
+  void decode() {
+    {
+      std::lock_guard guard(m_lock);
+      m_channels.clear();
+      for (uint8_t ch = 0; ch < m_chunks.size(); ++ch) {
+        if (!m_chunks[ch].empty()) m_channels.push_back(ch);
+      }
+
+      // Most dumps have two or three channels, the threads are only started once a batch has that many
+      auto const helpers = std::min<size_t>(m_channels.size() - 1, std::max(std::thread::hardware_concurrency(), 2u) - 1);
+      while (m_workers.size() < helpers)
+        m_workers.emplace_back(&DecodePool::work, this);
+
+      m_next = 0, m_open = true, ++m_generation;
+    }
+    m_wake.notify_all();
+
+    drain();
+
+    std::unique_lock guard(m_lock);
+    m_open = false; // Workers that wake up only now have nothing left to take
+    m_idle.wait(guard, [this] { return m_active == 0; });
+  }
+
+  private:
+  void drain() {
+    for (size_t i; (i = m_next.fetch_add(1, std::memory_order_relaxed)) < m_channels.size();) {
+      auto const ch = m_channels[i];
+      m_dump.decodeChannel(*m_dump.m_streams[ch], m_chunks[ch], m_batches[ch]);
+    }
+  }
+
+  void work() {
+    uint64_t seen = 0;
+
+    for (;;) {
+      {
+        std::unique_lock guard(m_lock);
+        m_wake.wait(guard, [&] { return m_stop || (m_open && m_generation != seen); });
+        if (m_stop) return;
+        seen = m_generation, ++m_active;
+      }
+
+      drain();
+
+      std::lock_guard guard(m_lock);
+      if (--m_active == 0) m_idle.notify_one();
+    }
+  }
+
+  P7Dump&                                      m_dump;
+  std::array<std::vector<uint32_t>, 32> const& m_chunks;
+  std::array<ChannelBatch, 32>&                m_batches;
+
+  std::vector<std::thread> m_workers;
+  std::mutex               m_lock;
+  std::condition_variable  m_wake, m_idle;
+
+  std::vector<uint8_t> m_channels; // Of the current batch, only changed while no worker is active
+  std::atomic<size_t>  m_next       = 0;
+  uint64_t             m_generation = 0;
+  uint32_t             m_active     = 0;
+  bool                 m_open       = false;
+  bool                 m_stop       = false;
+};
+
+bool P7Dump::finish(P7Error const& error) {
+  switch (error.status) {
+    case P7Status::Ok: break;
+
+    case P7Status::NotEnoughData: {
+      P7DumpNotEnoughBufferSpaceException ex(error.args[0], error.args[1], error.args[2] != 0);
+      if (!validate()) throw ex;
+
+      // We gonna finish rendering anyways, even if we got an error at the end, but we got valid data
+      fprintf(stderr, "%s\n", ex.what());
+    } break;
+
+    case P7Status::BrokenStreamItem: throw P7DumpBrokenStreamItemException(error.args[0], error.args[1], error.args[2]);
+    case P7Status::CorruptedItem: throw P7DumpCorruptedItemException(error.item);
+    case P7Status::UnknownArgument: throw P7DumpUnknownArgumentException(error.args[0]);
+  }
+
+  if (m_recoveredChunks > 0) fprintf(stderr, "P7Dump: Recovered from %zu corrupted chunks, %zu bytes skipped\n", m_recoveredChunks, m_skippedBytes);
+  return true;
+}
+
 bool P7Dump::run() {
   uint64_t header = 0;
-  io_read(&header, sizeof(header));
+  if (!io_read(&header, sizeof(header))) throw P7DumpInvalidHeaderException();
   if (header == P7D_HDR_BE.raw)
     m_endian = std::endian::big;
   else if (header == P7D_HDR_LE.raw)
@@ -28,58 +399,60 @@ bool P7Dump::run() {
   else
     throw P7DumpInvalidHeaderException();
 
-  read_endian(m_processId);
-  read_endian(m_createTime);
-  m_processName = fixed_string<p7string>(0x200);
-  m_hostName    = fixed_string<p7string>(0x200);
+  {
+    char hdrdata[sizeof(m_processId) + sizeof(m_createTime) + 0x400];
+    if (!io_read(hdrdata, sizeof(hdrdata))) throw P7DumpInvalidHeaderException();
 
-  StreamInfo si;
+    ChunkReader reader(hdrdata, sizeof(hdrdata), m_endian);
+    reader.read_endian(m_processId);
+    reader.read_endian(m_createTime);
+    m_processName = reader.fixed_string<p7string>(0x200);
+    m_hostName    = reader.fixed_string<p7string>(0x200);
+  }
 
-  try {
-    while (io_available() >= sizeof(si)) {
-      read_endian(si);
+  if (!prepare()) return false;
 
-      auto currStream = m_streams.find(si.channel);
-      if (currStream == m_streams.end()) currStream = m_streams.emplace(std::make_pair((uint8_t)si.channel, StreamStorage())).first;
+  std::array<std::vector<uint32_t>, 32> channelChunks;
+  std::array<ChannelBatch, 32>          batches;
+  DecodePool                            pool(*this, channelChunks, batches); // Channels don't share any decoder state
 
-      while (si.size > sizeof(StreamInfo)) {
-        StreamItem item;
-        read_endian(item);
-        if (item.size == 0) throw P7DumpBrokenStreamItemException(item.size, item.subtype, item.type);
-        si.size -= item.size;
-        item.size -= 4;
+  P7Error error;
+  while (error.status == P7Status::Ok && readBatch(error)) {
+    if (cancelled()) return false;
 
-        switch (item.type) {
-          case 0x00: { // STREAM_TRACE
-            auto actualRead = processTraceSItem(currStream->second, item);
-            if (actualRead == P7D_RENDER_FAIL) return false;
+    for (auto& chunks: channelChunks)
+      chunks.clear();
+    for (uint32_t i = 0; i < m_chunks.size(); ++i)
+      channelChunks[m_chunks[i].channel].push_back(i);
 
-            if (item.size > actualRead) {
-              io_skip(item.size - actualRead);
-            }
-          } break;
+    pool.decode();
 
-          default: {
-            io_skip(item.size);
-            fprintf(stderr, "Stream %d ignored!\n", item.type);
-          } break;
-        }
-      }
-    }
+    // Render everything in the original chunk order, so the analyser sees the same sequence as with sequential decoding
+    std::array<size_t, 32> cursors = {}, changes = {};
 
-    return true;
-  } catch (std::exception const& ex) {
-    auto const hash = typeid(ex).hash_code();
+    for (uint32_t i = 0; i < m_chunks.size(); ++i) {
+      auto const ch     = m_chunks[i].channel;
+      auto&      batch  = batches[ch];
+      auto&      cursor = cursors[ch];
 
-    if (hash == typeid(P7DumpNotEnoughBufferSpaceException).hash_code()) {
-      if (validate()) { // We gonna finish rendering anyways, even if we got exception at the end, but we got valid data
-        fprintf(stderr, "%s\n", ex.what());
-        return true;
+      for (; cursor < batch.lines.size() && batch.lines[cursor].chunk == i; ++cursor) {
+        auto const& line = batch.lines[cursor];
+        applyChanges(*m_streams[ch], batch, changes[ch], cursor);
+        if (!render(*m_streams[ch], line.tsd, p7string_view(batch.text).substr(line.textOffset, line.textSize))) return false;
+      }
+
+      if (batch.errorChunk == i) {
+        error = batch.error;
+        break;
       }
     }
 
-    throw ex; // Rethrow any unhandled exception
+    for (uint32_t ch = 0; ch < batches.size(); ++ch) { // Whatever came after the last line of the batch
+      if (!channelChunks[ch].empty()) applyChanges(*m_streams[ch], batches[ch], changes[ch], SIZE_MAX);
+    }
   }
+
+  return finish(error) && finalize();
 }
 
 template <typename T>
@@ -92,90 +465,108 @@ static void insert_to_stack(std::vector<char>& stack, T const& value) {
     stack.push_back('\0');
 };
 
-uint32_t P7Dump::processTraceSItem(StreamStorage& stream, StreamItem const& si) {
-  uint32_t cread = 0;
+P7Status P7Dump::processTraceSItem(StreamStorage& stream, StreamItem const& si, ChunkReader& reader, ChannelBatch& out, uint32_t chunk, uint32_t& cread) {
 
   switch (si.subtype) {
     case 0x00: { // Stream Info
-      read_endian(stream.info.time), cread += sizeof(stream.info.time);
-      read_endian(stream.info.timer), cread += sizeof(stream.info.timer);
-      read_endian(stream.info.timer_freq), cread += sizeof(stream.info.timer_freq);
-      read_endian(stream.info.flags), cread += sizeof(stream.info.flags);
-      stream.info.name = fixed_string<p7string>(0x80), cread += 0x80;
+      auto& info = out.changes.emplace_back(StateChange {.line = out.lines.size()}).info;
+      reader.read_endian(info.time), cread += sizeof(info.time);
+      reader.read_endian(info.timer), cread += sizeof(info.timer);
+      reader.read_endian(info.timer_freq), cread += sizeof(info.timer_freq);
+      reader.read_endian(info.flags), cread += sizeof(info.flags);
+      info.name = reader.fixed_string<p7string>(0x80), cread += 0x80;
+      if (reader.failed()) out.changes.pop_back(); // Cut short, the caller reports it
     } break;
 
     case 0x01: { // Description
-      P7Line line;
-
       uint16_t lineId, numFmt;
-      read_endian(lineId), cread += sizeof(lineId);
-      read_endian(line.fileLine), cread += sizeof(line.fileLine);
-      read_endian(line.moduleId), cread += sizeof(line.moduleId);
-      read_endian(numFmt), cread += sizeof(numFmt);
+      reader.read_endian(lineId), cread += sizeof(lineId);
+      if (lineId >= stream.lines.size()) stream.lines.resize(lineId + 1);
+
+      P7Line& line = stream.lines[lineId];
+      if (line.defined) break; // The first definition stays, the caller skips the rest of the item
+      line.defined = true;
+      reader.read_endian(line.fileLine), cread += sizeof(line.fileLine);
+      reader.read_endian(line.moduleId), cread += sizeof(line.moduleId);
+      reader.read_endian(numFmt), cread += sizeof(numFmt);
 
       if (si.size > cread) {
         if (numFmt) {
           auto argSizeByte = numFmt * sizeof(p7argument);
-          if (si.size < (cread + argSizeByte)) throw P7DumpCorruptedItemException("Arguments");
+          if (si.size < (cread + argSizeByte)) {
+            out.error = {.status = P7Status::CorruptedItem, .item = "Arguments"};
+            return out.error.status;
+          }
           line.formatInfos.reserve(numFmt);
           cread += argSizeByte;
 
           for (uint16_t i = 0; i < numFmt; ++i) {
             auto& data = line.formatInfos.emplace_back(std::make_pair(0, 0));
-            read_endian(data.first), read_endian(data.second);
+            reader.read_endian(data.first), reader.read_endian(data.second);
           }
         }
 
         if (cread < si.size) { // Read format string
           uint32_t consumed = 0;
-          line.formatString = zero_string<p7string>(consumed);
-          if ((cread += consumed) > si.size) throw P7DumpCorruptedItemException("Format String");
+          line.formatString = reader.zero_string<p7string>(consumed);
+          if ((cread += consumed) > si.size) {
+            out.error = {.status = P7Status::CorruptedItem, .item = "Format String"};
+            return out.error.status;
+          }
         }
 
         if (cread < si.size) { // Read filename string
           uint32_t consumed = 0;
-          line.fileName     = zero_string<std::string>(consumed);
-          if ((cread += consumed) > si.size) throw P7DumpCorruptedItemException("File Name");
+          line.fileName     = reader.zero_string<std::string>(consumed);
+          if ((cread += consumed) > si.size) {
+            out.error = {.status = P7Status::CorruptedItem, .item = "File Name"};
+            return out.error.status;
+          }
         }
 
         if (cread < si.size) { // Read funcname string
           uint32_t consumed = 0;
-          line.funcName     = zero_string<std::string>(consumed);
-          if ((cread += consumed) > si.size) throw P7DumpCorruptedItemException("Function Name");
+          line.funcName     = reader.zero_string<std::string>(consumed);
+          if ((cread += consumed) > si.size) {
+            out.error = {.status = P7Status::CorruptedItem, .item = "Function Name"};
+            return out.error.status;
+          }
         }
       }
 
-      stream.lines.emplace(lineId, std::move(line));
+      if (m_descriptionLimit != SIZE_MAX) limitDescription(stream, line);
     } break;
 
     case 0x02: { // Data
       TraceLineData tsd;
 
-      read_endian(tsd.id), cread += sizeof(tsd.id);
-      read_endian(tsd.level), cread += sizeof(tsd.level);
-      read_endian(tsd.cpu), cread += sizeof(tsd.cpu);
-      read_endian(tsd.threadid), cread += sizeof(tsd.threadid);
-      read_endian(tsd.sequence), cread += sizeof(tsd.sequence);
-      read_endian(tsd.timer), cread += sizeof(tsd.timer);
+      reader.read_endian(tsd.id), cread += sizeof(tsd.id);
+      reader.read_endian(tsd.level), cread += sizeof(tsd.level);
+      reader.read_endian(tsd.cpu), cread += sizeof(tsd.cpu);
+      reader.read_endian(tsd.threadid), cread += sizeof(tsd.threadid);
+      reader.read_endian(tsd.sequence), cread += sizeof(tsd.sequence);
+      reader.read_endian(tsd.timer), cread += sizeof(tsd.timer);
+      if (reader.failed()) return (out.error = reader.error()).status; // Cut short, no line for it
 
-      auto strinfo = stream.lines.find(tsd.id);
-      if (strinfo == stream.lines.end()) {
+      auto const strinfo = stream.line(tsd.id);
+      if (strinfo == nullptr) {
         fprintf(stderr, "Failed to find format data for parsed stream item!\n");
         break;
       }
 
-      tsd.modid = strinfo->second.moduleId;
-      if (strinfo->second.formatInfos.empty()) {
-        if (!render(stream, tsd, strinfo->second.formatString)) {
-          return P7D_RENDER_FAIL;
-        }
+      tsd.modid = strinfo->moduleId;
+      if (strinfo->formatInfos.empty()) {
+        out.lines.push_back({.chunk = chunk, .tsd = tsd, .textOffset = out.text.size(), .textSize = strinfo->formatString.size()});
+        out.text.append(strinfo->formatString);
         break;
       }
 
-      std::vector<char>   improvised_stack;
-      std::list<std::any> improvised_storage;
+      auto& stack = stream.stack;
+      stack.clear();
+      stream.fixups.clear();
+      stream.arena.reset();
 
-      for (const auto& [aType, aSize]: strinfo->second.formatInfos) {
+      for (const auto& [aType, aSize]: strinfo->formatInfos) {
         switch (aType) {
           case 0x01:   // char (int8)
           case 0x02:   // char16
@@ -185,93 +576,52 @@ uint32_t P7Dump::processTraceSItem(StreamStorage& stream, StreamItem const& si)
           case 0x07:   // pointer
           case 0x0c: { // char32
             int64_t i64;
-            insert_to_stack<int64_t>(improvised_stack, read_endian(i64)), cread += sizeof(i64);
+            insert_to_stack<int64_t>(stack, reader.read_endian(i64)), cread += sizeof(i64);
           } break;
           case 0x06: { // double
             double dbl;
-            insert_to_stack<double>(improvised_stack, read_endian(dbl));
+            insert_to_stack<double>(stack, reader.read_endian(dbl));
             cread += sizeof(dbl);
           } break;
           case 0x08: { // utf16 string
-            p7string u16str;
-
-            char16_t u16char;
-            while (true) {
-              cread += sizeof(u16char);
-              if (read_endian(u16char) != u'\0') {
-                u16str.push_back(u16char);
-                continue;
-              }
-
-              break;
-            }
-
-            insert_to_stack<char16_t*>(improvised_stack, std::any_cast<p7string&>(improvised_storage.emplace_back(std::move(u16str))).data());
+            reader.arena_string<char16_t>(stream, cread);
+            insert_to_stack<char16_t*>(stack, nullptr);
           } break;
           case 0x09: { // ascii string
-            std::string astr;
-
-            char achar;
-            while (true) {
-              cread += sizeof(achar);
-              if (read_endian(achar) != '\0') {
-                astr.push_back(achar);
-                continue;
-              }
-
-              break;
-            }
-
-            insert_to_stack<char*>(improvised_stack, std::any_cast<std::string&>(improvised_storage.emplace_back(std::move(astr))).data());
+            reader.arena_string<char>(stream, cread);
+            insert_to_stack<char*>(stack, nullptr);
           } break;
           case 0x0a: { // utf8 string
-            std::u8string u8str;
-
-            char8_t u8char;
-            while (true) {
-              cread += sizeof(u8char);
-              if (read_endian(u8char) != '\0') {
-                u8str.push_back(u8char);
-                continue;
-              }
-
-              break;
-            }
-
-            insert_to_stack<char8_t*>(improvised_stack, std::any_cast<std::u8string&>(improvised_storage.emplace_back(std::move(u8str))).data());
+            reader.arena_string<char8_t>(stream, cread);
+            insert_to_stack<char8_t*>(stack, nullptr);
           } break;
           case 0x0b: { // utf32 string
-            std::u32string u32str;
-
-            char32_t u32char;
-            while (true) {
-              cread += sizeof(u32char);
-              if (read_endian(u32char) != U'\0') {
-                u32str.push_back(u32char);
-                continue;
-              }
-
-              break;
-            }
-
-            insert_to_stack<char32_t*>(improvised_stack, std::any_cast<std::u32string&>(improvised_storage.emplace_back(std::move(u32str))).data());
+            reader.arena_string<char32_t>(stream, cread);
+            insert_to_stack<char32_t*>(stack, nullptr);
           } break;
           default: {
-            throw P7DumpUnknownArgumentException(si.subtype);
+            out.error = {.status = P7Status::UnknownArgument, .args = {aType}};
+            return out.error.status;
           } break;
         }
       }
 
-      int32_t len = vswprintf(nullptr, 0, (const wchar_t*)strinfo->second.formatString.c_str(), (va_list)improvised_stack.data());
-
-      p7string outstr;
-      outstr.resize(len + 1);
-      vswprintf((wchar_t*)outstr.data(), outstr.size(), (const wchar_t*)strinfo->second.formatString.c_str(), (va_list)improvised_stack.data());
-      while (outstr.back() == u'\00')
-        outstr.pop_back();
-      if (!render(stream, tsd, outstr)) {
-        return P7D_RENDER_FAIL;
+      // The arena might have been reallocated while reading, so string pointers are patched in only now
+      for (auto const& [stackOffset, arenaOffset]: stream.fixups) {
+        char* const strptr = stream.arena.at(arenaOffset);
+        std::memcpy(stack.data() + stackOffset, &strptr, sizeof(strptr));
       }
+
+      if (reader.failed()) return (out.error = reader.error()).status;
+
+      int32_t len = vswprintf(nullptr, 0, (const wchar_t*)strinfo->formatString.c_str(), (va_list)stack.data());
+
+      auto const textOffset = out.text.size();
+      out.text.resize(textOffset + len + 1);
+      vswprintf((wchar_t*)out.text.data() + textOffset, len + 1, (const wchar_t*)strinfo->formatString.c_str(), (va_list)stack.data());
+      while (out.text.size() > textOffset && out.text.back() == u'\00')
+        out.text.pop_back();
+      out.lines.push_back({.chunk = chunk, .tsd = tsd, .textOffset = textOffset, .textSize = out.text.size() - textOffset});
     } break;
 
     case 0x03: { // Verb packet? Wtf is this, dunno
@@ -284,12 +634,13 @@ uint32_t P7Dump::processTraceSItem(StreamStorage& stream, StreamItem const& si)
     } break;
 
     case 0x07: { // Module
-      int16_t  mod_id;
-      P7Module mod;
-      read_endian(mod_id), cread += sizeof(mod_id);
-      read_endian(mod.verbLevel), cread += sizeof(mod.verbLevel);
-      mod.name = fixed_string<std::string>(54), cread += 54;
-      stream.modules.emplace(std::make_pair(mod_id, std::move(mod)));
+      uint16_t mod_id;
+      reader.read_endian(mod_id), cread += sizeof(mod_id);
+
+      auto& mod = out.changes.emplace_back(StateChange {.line = out.lines.size(), .moduleId = mod_id, .module = {.defined = true}}).module;
+      reader.read_endian(mod.verbLevel), cread += sizeof(mod.verbLevel);
+      mod.name = reader.fixed_string<std::string>(54), cread += 54;
+      if (reader.failed()) out.changes.pop_back();
     } break;
 
     default: {
@@ -297,5 +648,5 @@ uint32_t P7Dump::processTraceSItem(StreamStorage& stream, StreamItem const& si)
     } break;
   }
 
-  return cread;
+  return P7Status::Ok;
 }
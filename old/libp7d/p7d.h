@@ -1,13 +1,18 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <bit>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <istream>
 #include <limits>
-#include <list>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <type_traits>
-#include <unordered_map>
 #include <vector>
 
 union P7Header {
@@ -15,16 +20,35 @@ union P7Header {
   uint64_t raw;
 };
 
-constexpr P7Header P7D_HDR_LE      = {.data = {0xa6, 0x2c, 0xf3, 0xec, 0x71, 0xac, 0xd2, 0x45}};
-constexpr P7Header P7D_HDR_BE      = {.data = {0x45, 0xd2, 0xac, 0x71, 0xec, 0xf3, 0x2c, 0xa6}};
-constexpr uint32_t P7D_RENDER_FAIL = (uint32_t)-1;
+constexpr P7Header P7D_HDR_LE       = {.data = {0xa6, 0x2c, 0xf3, 0xec, 0x71, 0xac, 0xd2, 0x45}};
+constexpr P7Header P7D_HDR_BE       = {.data = {0x45, 0xd2, 0xac, 0x71, 0xec, 0xf3, 0x2c, 0xa6}};
+constexpr uint32_t P7D_BATCH_CHUNKS = 1024;                // Chunks decoded in parallel before rendering them in order
+constexpr size_t   P7D_BATCH_BYTES  = 16ull * 1024 * 1024; // Same, but limits the memory copied out of non-viewable ios
+constexpr size_t   P7D_SCAN_WINDOW  = 1024 * 1024;         // Recovery mode looks for the next chunk header in windows of this size
+
+enum class P7Status : uint8_t {
+  Ok,
+  NotEnoughData,
+  BrokenStreamItem,
+  CorruptedItem,
+  UnknownArgument,
+};
+
+// Decoder errors are passed around as values, P7Dump::run() turns the final one into an exception for the caller
+struct P7Error {
+  P7Status    status  = P7Status::Ok;
+  uint32_t    args[3] = {};      // NotEnoughData: avail, required, isSkip; BrokenStreamItem: size, subtype, type; UnknownArgument: type
+  const char* item    = nullptr; // CorruptedItem: name of the broken field
+};
 
 class P7Dump {
   public:
-  using p7string   = std::basic_string<char16_t>;
-  using p7argument = std::pair<uint8_t, uint8_t>;
+  using p7string      = std::basic_string<char16_t>;
+  using p7string_view = std::basic_string_view<char16_t>;
+  using p7argument    = std::pair<uint8_t, uint8_t>;
 
   struct P7Line {
+    bool     defined = false;
     uint16_t fileLine;
     uint16_t moduleId;
 
@@ -35,7 +59,8 @@ class P7Dump {
   };
 
   struct P7Module {
-    uint32_t    verbLevel;
+    bool        defined   = false;
+    uint32_t    verbLevel = 0;
     std::string name;
   };
 
@@ -74,12 +99,56 @@ class P7Dump {
     uint64_t timer;
   };
 
+  // Bump allocator for string arguments of a single data item, reset() drops everything at once
+  class ArgumentArena {
+    public:
+    void reset() { m_used = 0; }
+
+    template <typename T>
+    size_t begin() {
+      m_used = (m_used + alignof(T) - 1) & ~(alignof(T) - 1);
+      return m_used;
+    }
+
+    template <typename T>
+    void push(T value) {
+      if (m_used + sizeof(T) > m_data.size()) m_data.resize(std::max<size_t>(m_data.size() * 2, 256));
+      std::memcpy(m_data.data() + m_used, &value, sizeof(T));
+      m_used += sizeof(T);
+    }
+
+    char* at(size_t offset) { return m_data.data() + offset; }
+
+    private:
+    std::vector<char> m_data;
+    size_t            m_used = 0;
+  };
+
   struct StreamStorage {
+    uint8_t         channel = 0;
     TraceStreamInfo info;
 
-    std::unordered_map<uint16_t, P7Line>   lines;
-    std::unordered_map<uint16_t, P7Module> modules;
-    std::list<p7string>                    formatted;
+    std::vector<P7Line>   lines;   // Indexed by line id
+    std::vector<P7Module> modules; // Indexed by module id
+
+    size_t descriptionBytes      = 0; // Strings of all the lines above, checked against the description limit
+    size_t truncatedDescriptions = 0;
+
+    // Per-item scratch, kept around so the capacity is reused between data items
+    ArgumentArena                          arena;
+    std::vector<char>                      stack;
+    std::vector<std::pair<size_t, size_t>> fixups; // (stack offset, arena offset) of string arguments
+
+    P7Line const* line(uint16_t id) const {
+      if (id >= lines.size() || !lines[id].defined) return nullptr;
+      return &lines[id];
+    }
+
+    P7Module const& module(uint16_t id) const {
+      static P7Module const unknown = {};
+      if (id >= modules.size()) return unknown;
+      return modules[id];
+    }
   };
 
   P7Dump() = default;
@@ -88,13 +157,47 @@ class P7Dump {
 
   virtual size_t io_available() const = 0;
 
-  virtual void io_read(void* buffer, size_t nread) = 0;
+  virtual bool io_read(void* buffer, size_t nread) = 0;
+
+  virtual bool io_skip(size_t nbytes) = 0;
+
+  virtual size_t io_tell() const = 0;
 
-  virtual void io_skip(size_t nbytes) = 0;
+  virtual bool io_seek(size_t pos) = 0;
+
+  // Zero-copy read, returns nullptr if the io can't expose its memory directly
+  virtual const char* io_view(size_t nbytes) { return nullptr; }
 
   virtual bool run();
 
-  virtual bool render(StreamStorage& stream, TraceLineData const& tsd, p7string const& out) = 0;
+  // Called once the dump header was parsed, before the first render()
+  virtual bool prepare() { return true; }
+
+  // Called once all lines were rendered, either by run() or replay()
+  virtual bool finalize() { return true; }
+
+  // Skip corrupted chunks and look for the next plausible chunk header instead of giving up on the whole dump
+  void setRecoveryMode(bool enabled) { m_recovery = enabled; }
+
+  size_t recoveredChunks() const { return m_recoveredChunks; }
+
+  size_t skippedBytes() const { return m_skippedBytes; }
+
+  // Caps what decoding holds on to: bytes copied out of the io per batch, and description strings per channel. Descriptions past the
+  // limit lose file and function names and keep as much of the format string as fits, cut before the specifier that doesn't
+  void setMemoryLimits(size_t batchBytes, size_t descriptionBytes) {
+    m_batchBytes       = std::min(batchBytes, P7D_BATCH_BYTES);
+    m_descriptionLimit = descriptionBytes;
+  }
+
+  size_t truncatedDescriptions() const;
+
+  // Polled between batches, run() and replay() give up with false once the flag is raised
+  void setCancelFlag(std::atomic<bool> const* flag) { m_cancel = flag; }
+
+  bool cancelled() const { return m_cancel != nullptr && m_cancel->load(std::memory_order_relaxed); }
+
+  virtual bool render(StreamStorage& stream, TraceLineData const& tsd, p7string_view out) = 0;
 
   virtual std::string spit() const = 0;
 
@@ -107,7 +210,7 @@ class P7Dump {
   };
 
   template <typename T>
-  constexpr T swap_endian(T value) noexcept {
+  static constexpr T swap_endian(T value) noexcept {
     static_assert(std::is_trivially_copyable_v<T>, "value is not regular type");
 
     AlignedBytes<T> bytes = std::bit_cast<AlignedBytes<T>>(value);
@@ -115,51 +218,164 @@ class P7Dump {
     return std::bit_cast<T>(bytes);
   }
 
-  template <typename T>
-  constexpr T& read_endian(T& buf) {
-    io_read(&buf, sizeof(buf));
-    if ((sizeof(T) > 1) && (m_endian != std::endian::native)) buf = swap_endian(buf);
-    return buf;
-  }
+  // Cursor over a chunk that has already been pulled out of the io, every decoder thread owns its own
+  class ChunkReader {
+    public:
+    ChunkReader(const char* data, size_t size, std::endian endian): m_data(data), m_size(size), m_pos(0), m_endian(endian) {}
 
-  template <typename T>
-  T zero_string(uint32_t& consumed) {
-    T temp;
-
-    while (io_available() > 0) {
-      typename T::value_type ch;
-      read_endian(ch);
-      consumed += sizeof(ch);
-      if (ch == '\0') break;
-      temp.push_back(ch);
+    size_t available() const { return m_size - m_pos; }
+
+    // Reading past the end doesn't throw, the reader zero-fills the buffer and stays failed until the caller checks it
+    void read(void* buffer, size_t nread);
+
+    void skip(size_t nbytes);
+
+    bool failed() const { return m_failed; }
+
+    P7Error error() const { return {.status = P7Status::NotEnoughData, .args = {m_failAvail, m_failRequired, m_failSkip}}; }
+
+    template <typename T>
+    constexpr T& read_endian(T& buf) {
+      read(&buf, sizeof(buf));
+      if ((sizeof(T) > 1) && (m_endian != std::endian::native)) buf = swap_endian(buf);
+      return buf;
     }
 
-    return std::move(temp);
-  }
+    template <typename T>
+    T zero_string(uint32_t& consumed) {
+      T temp;
 
-  template <typename T>
-  T fixed_string(uint32_t bytesize) {
-    T temp;
-
-    while (bytesize > 0) {
-      typename T::value_type ch;
-      read_endian(ch);
-      bytesize -= sizeof(ch);
-      if (ch == '\0') break;
-      temp.push_back(ch);
+      while (available() > 0) {
+        typename T::value_type ch;
+        read_endian(ch);
+        consumed += sizeof(ch);
+        if (ch == '\0') break;
+        temp.push_back(ch);
+      }
+
+      return std::move(temp);
     }
 
-    io_skip(bytesize);
-    return std::move(temp);
-  }
+    template <typename T>
+    T fixed_string(uint32_t bytesize) {
+      T temp;
+
+      while (bytesize > 0) {
+        typename T::value_type ch;
+        read_endian(ch);
+        bytesize -= sizeof(ch);
+        if (ch == '\0') break;
+        temp.push_back(ch);
+      }
 
-  uint32_t processTraceSItem(StreamStorage& ss, StreamItem const& pi);
+      skip(bytesize);
+      return std::move(temp);
+    }
+
+    template <typename T>
+    void arena_string(StreamStorage& stream, uint32_t& consumed) {
+      auto const start = stream.arena.begin<T>();
+
+      T ch;
+      do {
+        read_endian(ch);
+        consumed += sizeof(ch);
+        stream.arena.push(ch);
+      } while (ch != T(0));
+
+      stream.fixups.emplace_back(stream.stack.size(), start);
+    }
 
-  std::unordered_map<uint8_t, StreamStorage> m_streams;
+    private:
+    void fail(size_t nbytes, bool isSkip);
+
+    const char* m_data;
+    size_t      m_size;
+    size_t      m_pos;
+    std::endian m_endian;
+
+    bool     m_failed       = false;
+    uint32_t m_failAvail    = 0;
+    uint32_t m_failRequired = 0;
+    uint32_t m_failSkip     = 0;
+  };
+
+  struct ChunkRef {
+    uint8_t     channel;
+    const char* data;   // nullptr while the chunk is being copied into m_chunkData
+    size_t      offset; // Position in m_chunkData
+    size_t      size;
+    size_t      fullSize; // Bigger than size if the dump was truncated in the middle of this chunk
+  };
+
+  struct DecodedLine {
+    uint32_t      chunk;
+    TraceLineData tsd;
+    size_t        textOffset;
+    size_t        textSize;
+  };
+
+  // Stream info and module items don't matter for decoding, they take effect between the lines they were logged between once those are
+  // rendered, so render() sees the state each line was logged in
+  struct StateChange {
+    size_t          line     = 0;  // Index in ChannelBatch::lines of the first line after it
+    int32_t         moduleId = -1; // -1 for stream info
+    TraceStreamInfo info     = {};
+    P7Module        module   = {};
+  };
+
+  // Output of one channel worker for the current batch
+  struct ChannelBatch {
+    std::vector<DecodedLine> lines;
+    std::vector<StateChange> changes;
+    p7string                 text;
+    P7Error                  error;
+    uint32_t                 errorChunk = std::numeric_limits<uint32_t>::max();
+  };
+
+  // Decodes the channels of a batch on threads that live as long as run(), the calling thread takes part as well
+  class DecodePool;
+
+  P7Status processTraceSItem(StreamStorage& ss, StreamItem const& pi, ChunkReader& reader, ChannelBatch& out, uint32_t chunk, uint32_t& cread);
+
+  void decodeChannel(StreamStorage& stream, std::vector<uint32_t> const& chunks, ChannelBatch& out);
+
+  // Applies the changes of a batch up to its line index line, next is where the previous call stopped
+  static void applyChanges(StreamStorage& stream, ChannelBatch& batch, size_t& next, size_t line);
+
+  bool readBatch(P7Error& error);
+
+  bool plausibleChunk(StreamInfo si, const char* body, size_t checkable, size_t dumpLeft, bool knownChannel) const;
+
+  static size_t descriptionSize(P7Line const& line);
+
+  void limitDescription(StreamStorage& stream, P7Line& line) const;
+
+  bool resync(size_t from);
+
+  bool finish(P7Error const& error);
+
+  std::array<std::unique_ptr<StreamStorage>, 32> m_streams; // Indexed by StreamInfo::channel
+
+  std::vector<ChunkRef> m_chunks;    // Chunks of the current batch in file order
+  std::vector<char>     m_chunkData; // Backing storage for chunks the io can't give us a view of
+  std::vector<char>     m_scanWindow;
+
+  bool   m_recovery        = false;
+  size_t m_recoveredChunks = 0;
+  size_t m_skippedBytes    = 0;
+
+  size_t m_batchBytes       = P7D_BATCH_BYTES;
+  size_t m_descriptionLimit = SIZE_MAX;
+
+  std::atomic<bool> const* m_cancel = nullptr;
 
   protected:
   bool validate();
 
+  // Feeds the lines of a columnar file written by P7DumpConverter to render() without decoding the original dump again
+  bool replay(std::istream& columnar);
+
   std::endian m_endian;
   uint32_t    m_processId  = std::numeric_limits<uint32_t>::max();
   uint64_t    m_createTime = std::numeric_limits<uint64_t>::max();
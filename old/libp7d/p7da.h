@@ -3,65 +3,31 @@
 #define JSON_HAS_CPP_20
 
 #include "libp7d/p7d.h"
-#include "third_party/json.hpp"
+#include "libplog/plogrules.h"
 
 #include <filesystem>
 #include <memory>
 
 class P7DumpAnalyser: public P7Dump {
-  struct /* Flags */ {
-    // psOff specific
-    bool _processTypeGuessed : 1 = false;
-    bool _isChildprocess     : 1 = false;
-    bool _isGpuPicked        : 1 = false;
-
-    // Hints
-    bool _inputNotFoundHint  : 1 = false;
-    bool _nvidiaHint         : 1 = false;
-    bool _hintTrophyKey      : 1 = false;
-    bool _hintAndnPatched    : 1 = false;
-    bool _hintInsertqPatched : 1 = false;
-    bool _hintExtrqPatched   : 1 = false;
-    bool _hintAjmFound       : 1 = false;
-
-    // Game engines
-    bool _unityEngineDetected    : 1 = false;
-    bool _cryEngineDetected      : 1 = false;
-    bool _unrealEngineDetected   : 1 = false;
-    bool _phyreEngineDetected    : 1 = false;
-    bool _gmakerEngineDetected   : 1 = false;
-    bool _naughtyEngineDetected  : 1 = false;
-    bool _irrlichtEngineDetected : 1 = false;
-
-    // SDKs
-    bool _fmodSdkDetected   : 1 = false;
-    bool _monoSdkDetected   : 1 = false;
-    bool _criSdkDetected    : 1 = false;
-    bool _havokSdkDetected  : 1 = false;
-    bool _wwiseSdkDetected  : 1 = false;
-    bool _dialogSdkDetected : 1 = false;
-
-    // Problems
-    bool _shaderGenTodo     : 1 = false;
-    bool _vkValidation      : 1 = false;
-    bool _exceptionDetected : 1 = false;
-    bool _netStuffDetected  : 1 = false;
-    bool _vkNoDevices       : 1 = false;
-  };
-
   public:
-  P7DumpAnalyser() = default;
+  P7DumpAnalyser(PLogOptions const& options = {});
 
   virtual ~P7DumpAnalyser() = default;
 
-  bool render(StreamStorage& stream, TraceLineData const& tsd, p7string const& out) override final;
+  bool prepare() override final;
+
+  bool render(StreamStorage& stream, TraceLineData const& tsd, p7string_view out) override final;
 
   std::string spit() const override final;
 
-  bool run() override final;
+  bool finalize() override final;
+
+  // Same data spit() serializes, for callers that build their own representation of it
+  nlohmann::json const& result() const { return m_rules.info(); }
 
   private:
-  nlohmann::json m_jsonInfo;
+  PLogRules<char16_t> m_rules;
+  uint64_t            m_rendered = 0;
 };
 
 #ifdef _WIN32
@@ -70,5 +36,5 @@ class P7DumpAnalyser: public P7Dump {
 #define EXPORT
 #endif
 
-EXPORT std::unique_ptr<P7Dump> createFileAnalyser(std::filesystem::path const& fpath);
-EXPORT std::unique_ptr<P7Dump> createMemAnalyser(void* memory, size_t size);
+EXPORT std::unique_ptr<P7Dump> createFileAnalyser(std::filesystem::path const& fpath, PLogOptions const& options = {});
+EXPORT std::unique_ptr<P7Dump> createMemAnalyser(void* memory, size_t size, PLogOptions const& options = {});
@@ -0,0 +1,388 @@
+#include "p7dc.h"
+
+#include "p7exceptions.h"
+#include "p7io.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <format>
+#include <ios>
+#include <istream>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace {
+constexpr uint64_t FILETIME_UNIX_EPOCH = 116444736000000000ull; // 1601-01-01 -> 1970-01-01 in 100ns ticks
+
+template <typename T>
+void put(std::string& out, T const& value) {
+  out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void put(std::string& out, std::vector<T> const& values) {
+  out.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+template <typename CharT>
+void putString(std::string& out, std::basic_string_view<CharT> str) {
+  put(out, (uint32_t)str.size());
+  out.append(reinterpret_cast<const char*>(str.data()), str.size() * sizeof(CharT));
+}
+
+template <typename T>
+bool get(std::istream& in, T& value) {
+  return in.read(reinterpret_cast<char*>(&value), sizeof(T)).good();
+}
+
+template <typename T>
+bool get(std::istream& in, std::vector<T>& values, size_t count) {
+  values.resize(count);
+  return in.read(reinterpret_cast<char*>(values.data()), count * sizeof(T)).good();
+}
+
+template <typename T>
+bool getString(std::istream& in, T& str) {
+  uint32_t len;
+  if (!get(in, len) || len * sizeof(typename T::value_type) > P7DC_MAX_STRING) return false;
+  str.resize(len);
+  return in.read(reinterpret_cast<char*>(str.data()), len * sizeof(typename T::value_type)).good();
+}
+
+// Plog fields are separated by ';' and records by newlines, neither may leak from the p7d strings
+void appendField(std::string& out, std::string_view str) {
+  for (auto ch: str)
+    out.push_back((ch == ';' || ch == '\n' || ch == '\r') ? ' ' : ch);
+}
+
+void appendUTF8(std::string& out, std::u16string_view str, bool isField) {
+  for (size_t i = 0; i < str.size(); ++i) {
+    uint32_t cp = str[i];
+
+    if (cp >= 0xd800 && cp <= 0xdbff && (i + 1) < str.size() && str[i + 1] >= 0xdc00 && str[i + 1] <= 0xdfff) {
+      cp = 0x10000 + ((cp - 0xd800) << 10) + (str[++i] - 0xdc00);
+    }
+
+    if (cp < 0x80) {
+      if (cp == '\n' || cp == '\r' || (isField && cp == ';')) cp = ' ';
+      out.push_back((char)cp);
+    } else if (cp < 0x800) {
+      out.push_back((char)(0xc0 | (cp >> 6)));
+      out.push_back((char)(0x80 | (cp & 0x3f)));
+    } else if (cp < 0x10000) {
+      out.push_back((char)(0xe0 | (cp >> 12)));
+      out.push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+      out.push_back((char)(0x80 | (cp & 0x3f)));
+    } else {
+      out.push_back((char)(0xf0 | (cp >> 18)));
+      out.push_back((char)(0x80 | ((cp >> 12) & 0x3f)));
+      out.push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+      out.push_back((char)(0x80 | (cp & 0x3f)));
+    }
+  }
+}
+
+void appendTimestamp(std::string& out, uint64_t filetime) {
+  using namespace std::chrono;
+
+  auto const tp  = sys_time<microseconds>(microseconds((int64_t)(filetime - FILETIME_UNIX_EPOCH) / 10));
+  auto const dp  = floor<days>(tp);
+  auto const ymd = year_month_day(dp);
+  auto const hms = hh_mm_ss<microseconds>(tp - dp);
+
+  char buf[32];
+  auto len = snprintf(buf, sizeof(buf), "%04d-%02u-%02u %02d:%02d:%02d.%06d", (int)ymd.year(), (unsigned)ymd.month(), (unsigned)ymd.day(), (int)hms.hours().count(),
+                      (int)hms.minutes().count(), (int)hms.seconds().count(), (int)hms.subseconds().count());
+  out.append(buf, len);
+}
+
+uint64_t lineFiletime(P7Dump::StreamStorage const& stream, uint64_t timer) {
+  auto const& info = stream.info;
+  if (info.timer_freq == 0 || timer < info.timer) return info.time;
+
+  auto const diff = timer - info.timer;
+  return info.time + (diff / info.timer_freq) * 10'000'000ull + (diff % info.timer_freq) * 10'000'000ull / info.timer_freq;
+}
+} // namespace
+
+bool P7DumpConverter::prepare() {
+  switch (m_format) {
+    case P7ConvertFormat::Plog: {
+      // libplog decides the process type by the first line of the log
+      m_buffer += "p7d;Kernel;I;";
+      appendTimestamp(m_buffer, m_createTime);
+      m_buffer += std::format(";{};0;;;{}\n", m_processId, m_processName == u"psOff_tunnel.exe" ? "child process" : "main process");
+    } break;
+
+    case P7ConvertFormat::Columnar: {
+      m_buffer.append(P7DC_MAGIC, sizeof(P7DC_MAGIC));
+      put(m_buffer, m_processId);
+      put(m_buffer, m_createTime);
+      putString<char16_t>(m_buffer, m_processName);
+      putString<char16_t>(m_buffer, m_hostName);
+    } break;
+  }
+
+  return true;
+}
+
+void P7DumpConverter::writePlogLine(StreamStorage& stream, TraceLineData const& tsd, p7string_view out) {
+  static constexpr char levels[] = {'T', 'D', 'I', 'W', 'E', 'C'};
+
+  auto const line = stream.line(tsd.id);
+
+  appendUTF8(m_buffer, stream.info.name, true);
+  m_buffer.push_back(';');
+  if (stream.info.name.contains(u"tty"))
+    m_buffer += "TTY";
+  else
+    appendField(m_buffer, stream.module(tsd.modid).name);
+  m_buffer.push_back(';');
+  m_buffer.push_back(levels[std::min<size_t>(tsd.level, sizeof(levels) - 1)]);
+  m_buffer.push_back(';');
+  appendTimestamp(m_buffer, lineFiletime(stream, tsd.timer));
+  m_buffer += std::format(";{};{};", m_processId, tsd.threadid);
+  if (line != nullptr) {
+    appendField(m_buffer, line->fileName);
+    m_buffer.push_back(';');
+    appendField(m_buffer, line->funcName);
+    m_buffer.push_back(';');
+  } else {
+    m_buffer += ";;";
+  }
+  appendUTF8(m_buffer, out, false);
+  m_buffer.push_back('\n');
+}
+
+void P7DumpConverter::appendColumnarRow(StreamStorage& stream, TraceLineData const& tsd, p7string_view out) {
+  auto const ch = stream.channel;
+
+  if (!m_channelDefined[ch]) {
+    m_channelDefined[ch] = true;
+    ++m_channelDefCount;
+    put(m_channelDefs, ch);
+    put(m_channelDefs, stream.info.time);
+    put(m_channelDefs, stream.info.timer);
+    put(m_channelDefs, stream.info.timer_freq);
+    putString<char16_t>(m_channelDefs, stream.info.name);
+  }
+
+  auto& modules = m_moduleDefined[ch];
+  if (tsd.modid >= modules.size()) modules.resize(tsd.modid + 1);
+  if (!modules[tsd.modid]) {
+    modules[tsd.modid] = true;
+    ++m_moduleDefCount;
+    put(m_moduleDefs, ch);
+    put(m_moduleDefs, tsd.modid);
+    putString<char>(m_moduleDefs, stream.module(tsd.modid).name);
+  }
+
+  auto& sources = m_sourceIds[ch];
+  if (tsd.id >= sources.size()) sources.resize(tsd.id + 1);
+  if (sources[tsd.id] == 0) {
+    auto const line = stream.line(tsd.id);
+    sources[tsd.id] = ++m_sourceDefCount;
+    putString<char>(m_sourceDefs, line != nullptr ? line->fileName : "");
+    putString<char>(m_sourceDefs, line != nullptr ? line->funcName : "");
+  }
+
+  m_colLevel.push_back(tsd.level);
+  m_colChannel.push_back(ch);
+  m_colModule.push_back(tsd.modid);
+  m_colThread.push_back(tsd.threadid);
+  m_colTimer.push_back(tsd.timer);
+  m_colSource.push_back(sources[tsd.id] - 1);
+  m_colTextOffset.push_back((uint32_t)m_colText.size());
+  m_colText.append(out);
+
+  if (m_colLevel.size() >= P7DC_BLOCK_ROWS) flushBlock();
+}
+
+void P7DumpConverter::flushBlock() {
+  uint32_t const rows = (uint32_t)m_colLevel.size();
+  if (rows == 0) return;
+
+  m_index.push_back({.offset = m_written + m_buffer.size(), .firstRow = m_rows - rows, .rows = rows, .reserved = 0});
+  m_colTextOffset.push_back((uint32_t)m_colText.size());
+
+  put(m_buffer, rows);
+  put(m_buffer, m_channelDefCount);
+  put(m_buffer, m_moduleDefCount);
+  put(m_buffer, m_sourceDefCount);
+  m_buffer += m_channelDefs;
+  m_buffer += m_moduleDefs;
+  m_buffer += m_sourceDefs;
+  put(m_buffer, m_colLevel);
+  put(m_buffer, m_colChannel);
+  put(m_buffer, m_colModule);
+  put(m_buffer, m_colThread);
+  put(m_buffer, m_colTimer);
+  put(m_buffer, m_colSource);
+  put(m_buffer, m_colTextOffset);
+  m_buffer.append(reinterpret_cast<const char*>(m_colText.data()), m_colText.size() * sizeof(char16_t));
+
+  m_channelDefs.clear(), m_moduleDefs.clear(), m_sourceDefs.clear();
+  m_channelDefCount = m_moduleDefCount = m_sourceDefCount = 0;
+  m_channelDefined.fill(false);
+  for (auto& modules: m_moduleDefined)
+    std::fill(modules.begin(), modules.end(), false);
+  for (auto& sources: m_sourceIds)
+    std::fill(sources.begin(), sources.end(), 0);
+  m_colLevel.clear(), m_colChannel.clear(), m_colModule.clear(), m_colThread.clear();
+  m_colTimer.clear(), m_colSource.clear(), m_colTextOffset.clear(), m_colText.clear();
+}
+
+void P7DumpConverter::flushBuffer(bool force) {
+  if (!force && m_buffer.size() < P7DC_FLUSH_SIZE) return;
+
+  m_out.write(m_buffer.data(), m_buffer.size());
+  m_written += m_buffer.size();
+  m_buffer.clear();
+}
+
+bool P7DumpConverter::render(StreamStorage& stream, TraceLineData const& tsd, p7string_view out) {
+  ++m_rows; // Counted before appending, a block flushed by this row derives its firstRow from m_rows
+
+  switch (m_format) {
+    case P7ConvertFormat::Plog: writePlogLine(stream, tsd, out); break;
+    case P7ConvertFormat::Columnar: appendColumnarRow(stream, tsd, out); break;
+  }
+
+  flushBuffer(false);
+  return m_out.good();
+}
+
+bool P7DumpConverter::finalize() {
+  if (m_format == P7ConvertFormat::Columnar) {
+    flushBlock();
+
+    uint64_t const indexOffset = m_written + m_buffer.size();
+    for (auto const& block: m_index)
+      put(m_buffer, block);
+    put(m_buffer, (uint64_t)m_index.size());
+    put(m_buffer, indexOffset);
+    m_buffer.append(P7DC_INDEX_MAGIC, sizeof(P7DC_INDEX_MAGIC));
+  }
+
+  flushBuffer(true);
+  m_out.flush();
+  return m_out.good();
+}
+
+std::string P7DumpConverter::spit() const {
+  return std::format("{{\"lines\": {}, \"bytes\": {}}}", m_rows, m_written + m_buffer.size());
+}
+
+bool P7Dump::replay(std::istream& in) {
+  char magic[sizeof(P7DC_MAGIC)];
+  if (!in.read(magic, sizeof(magic)).good() || std::memcmp(magic, P7DC_MAGIC, sizeof(magic)) != 0) throw P7DumpInvalidHeaderException();
+  if (!get(in, m_processId) || !get(in, m_createTime) || !getString(in, m_processName) || !getString(in, m_hostName)) throw P7DumpInvalidHeaderException();
+  if (!prepare()) return false;
+
+  uint64_t blockCount, indexOffset;
+  in.seekg(-(std::streamoff)(sizeof(blockCount) + sizeof(indexOffset) + sizeof(P7DC_INDEX_MAGIC)), std::ios::end);
+  uint64_t const footerOffset = in.tellg();
+  if (!get(in, blockCount) || !get(in, indexOffset) || !in.read(magic, sizeof(magic)).good() ||
+      std::memcmp(magic, P7DC_INDEX_MAGIC, sizeof(magic)) != 0 || indexOffset > footerOffset ||
+      blockCount > (footerOffset - indexOffset) / sizeof(P7ColumnarBlock))
+    throw P7DumpCorruptedItemException("Columnar index");
+
+  std::vector<P7ColumnarBlock> index;
+  in.seekg(indexOffset, std::ios::beg);
+  if (!get(in, index, blockCount)) throw P7DumpCorruptedItemException("Columnar index");
+
+  std::vector<uint8_t>  level, channel;
+  std::vector<uint16_t> module;
+  std::vector<uint32_t> thread, source, textOffset;
+  std::vector<uint64_t> timer;
+  std::vector<char16_t> text;
+
+  for (auto const& block: index) {
+    if (cancelled()) return false;
+
+    uint32_t rows, channelDefs, moduleDefs, sourceDefs;
+
+    if (block.offset >= indexOffset) throw P7DumpCorruptedItemException("Columnar block");
+    in.seekg(block.offset, std::ios::beg);
+    if (!get(in, rows) || !get(in, channelDefs) || !get(in, moduleDefs) || !get(in, sourceDefs) || rows != block.rows || rows > P7DC_BLOCK_ROWS)
+      throw P7DumpCorruptedItemException("Columnar block");
+
+    for (uint32_t i = 0; i < channelDefs; ++i) {
+      uint8_t ch;
+      if (!get(in, ch) || ch >= m_streams.size()) throw P7DumpCorruptedItemException("Columnar channel");
+
+      auto& stream = m_streams[ch];
+      if (stream == nullptr) stream = std::make_unique<StreamStorage>();
+      stream->channel = ch;
+      if (!get(in, stream->info.time) || !get(in, stream->info.timer) || !get(in, stream->info.timer_freq) || !getString(in, stream->info.name))
+        throw P7DumpCorruptedItemException("Columnar channel");
+    }
+
+    for (uint32_t i = 0; i < moduleDefs; ++i) {
+      uint8_t  ch;
+      uint16_t modid;
+      if (!get(in, ch) || !get(in, modid) || ch >= m_streams.size() || m_streams[ch] == nullptr) throw P7DumpCorruptedItemException("Columnar module");
+
+      auto& modules = m_streams[ch]->modules;
+      if (modid >= modules.size()) modules.resize(modid + 1);
+      if (!getString(in, modules[modid].name)) throw P7DumpCorruptedItemException("Columnar module");
+    }
+
+    for (uint32_t i = 0; i < sourceDefs; ++i) { // Source names aren't used by the rules, only the plog layout has them
+      std::string fileName, funcName;
+      if (!getString(in, fileName) || !getString(in, funcName)) throw P7DumpCorruptedItemException("Columnar source");
+    }
+
+    if (!get(in, level, rows) || !get(in, channel, rows) || !get(in, module, rows) || !get(in, thread, rows) || !get(in, timer, rows) ||
+        !get(in, source, rows) || !get(in, textOffset, rows + 1))
+      throw P7DumpCorruptedItemException("Columnar columns");
+
+    // The text ends before the index does, checked before it is allocated
+    if (uint64_t const textStart = in.tellg(); textStart > indexOffset || textOffset.back() > (indexOffset - textStart) / sizeof(char16_t) ||
+                                                 !get(in, text, textOffset.back()))
+      throw P7DumpCorruptedItemException("Columnar text");
+
+    for (uint32_t row = 0; row < rows; ++row) {
+      auto const& stream = m_streams[channel[row]];
+      if (stream == nullptr || textOffset[row] > textOffset[row + 1]) throw P7DumpCorruptedItemException("Columnar row");
+
+      TraceLineData const tsd = {
+          .id       = 0,
+          .modid    = module[row],
+          .level    = level[row],
+          .cpu      = 0,
+          .threadid = thread[row],
+          .sequence = (uint32_t)(block.firstRow + row),
+          .timer    = timer[row],
+      };
+
+      if (!render(*stream, tsd, p7string_view(text.data() + textOffset[row], textOffset[row + 1] - textOffset[row]))) return false;
+    }
+  }
+
+  return finalize();
+}
+
+// Same file io as the dumps, run() replays the columnar file from it instead of decoding
+class P7DumpColumnarAnalyser: public P7DumpFileIo<P7DumpAnalyser> {
+  public:
+  using P7DumpFileIo::P7DumpFileIo;
+
+  bool run() override final { return replay(io_stream()); }
+};
+
+std::unique_ptr<P7Dump> createFileConverter(std::filesystem::path const& fpath, std::ostream& out, P7ConvertFormat format) {
+  return std::make_unique<P7DumpFileIo<P7DumpConverter>>(fpath, out, format);
+}
+
+std::unique_ptr<P7Dump> createMemConverter(void* memory, size_t size, std::ostream& out, P7ConvertFormat format) {
+  return std::make_unique<P7DumpMemIo<P7DumpConverter>>(memory, size, out, format);
+}
+
+std::unique_ptr<P7Dump> createColumnarAnalyser(std::filesystem::path const& fpath, PLogOptions const& options) {
+  return std::make_unique<P7DumpColumnarAnalyser>(fpath, options);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "libp7d/p7d.h"
+#include "libp7d/p7da.h"
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+enum class P7ConvertFormat {
+  Plog,     // Text layout understood by libplog's parseLogLine
+  Columnar, // Blocks of columns with a block index at the end, can be replayed into P7DumpAnalyser
+};
+
+// Columnar file layout (little endian):
+//   "P7DCOL1\0", u32 processId, u64 createTime, u32 len + char16 processName, u32 len + char16 hostName
+//   blocks: u32 rows, u32 channelDefs, u32 moduleDefs, u32 sourceDefs, definitions,
+//           u8 level[rows], u8 channel[rows], u16 module[rows], u32 thread[rows], u64 timer[rows], u32 source[rows],
+//           u32 textOffset[rows + 1], char16 text[textOffset[rows]]
+//           Every block defines the channels, modules and sources its rows use, so it decodes on its own. source is an index into the
+//           block's source definitions
+//   index:  P7ColumnarBlock per block
+//   footer: u64 blockCount, u64 indexOffset, "P7DCIDX\0"
+constexpr char     P7DC_MAGIC[8]       = {'P', '7', 'D', 'C', 'O', 'L', '1', '\0'};
+constexpr char     P7DC_INDEX_MAGIC[8] = {'P', '7', 'D', 'C', 'I', 'D', 'X', '\0'};
+constexpr uint32_t P7DC_BLOCK_ROWS     = 16384;
+constexpr uint32_t P7DC_MAX_STRING     = 1u << 22; // Strings come from p7 items, which can't be any bigger
+constexpr size_t   P7DC_FLUSH_SIZE     = 1024 * 1024;
+
+struct P7ColumnarBlock {
+  uint64_t offset;
+  uint64_t firstRow; // Line index of the first row in the block
+  uint32_t rows;
+  uint32_t reserved;
+};
+
+class P7DumpConverter: public P7Dump {
+  public:
+  P7DumpConverter(std::ostream& out, P7ConvertFormat format): m_out(out), m_format(format) {}
+
+  virtual ~P7DumpConverter() = default;
+
+  bool prepare() override final;
+
+  bool render(StreamStorage& stream, TraceLineData const& tsd, p7string_view out) override final;
+
+  bool finalize() override final;
+
+  std::string spit() const override final;
+
+  private:
+  void writePlogLine(StreamStorage& stream, TraceLineData const& tsd, p7string_view out);
+
+  void appendColumnarRow(StreamStorage& stream, TraceLineData const& tsd, p7string_view out);
+
+  void flushBlock();
+
+  void flushBuffer(bool force);
+
+  std::ostream&   m_out;
+  P7ConvertFormat m_format;
+
+  uint64_t m_rows    = 0;
+  uint64_t m_written = 0;
+
+  std::string m_buffer; // Pending output bytes
+
+  // Columnar state
+  std::vector<P7ColumnarBlock> m_index;
+  std::string                  m_channelDefs, m_moduleDefs, m_sourceDefs;
+  uint32_t                     m_channelDefCount = 0, m_moduleDefCount = 0, m_sourceDefCount = 0;
+
+  // Definitions written to the current block
+  std::array<bool, 32>                  m_channelDefined = {};
+  std::array<std::vector<bool>, 32>     m_moduleDefined;
+  std::array<std::vector<uint32_t>, 32> m_sourceIds; // (line id) -> block source id + 1
+
+  std::vector<uint8_t>  m_colLevel, m_colChannel;
+  std::vector<uint16_t> m_colModule;
+  std::vector<uint32_t> m_colThread, m_colSource, m_colTextOffset;
+  std::vector<uint64_t> m_colTimer;
+  p7string              m_colText;
+};
+
+EXPORT std::unique_ptr<P7Dump> createFileConverter(std::filesystem::path const& fpath, std::ostream& out, P7ConvertFormat format);
+EXPORT std::unique_ptr<P7Dump> createMemConverter(void* memory, size_t size, std::ostream& out, P7ConvertFormat format);
+EXPORT std::unique_ptr<P7Dump> createColumnarAnalyser(std::filesystem::path const& fpath, PLogOptions const& options = {});
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "libp7d/p7d.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <utility>
+
+// io backends for P7Dump, Base is the P7Dump subclass that decides what to do with the decoded lines
+
+template <typename Base>
+class P7DumpFileIo: public Base {
+  public:
+  template <typename... Args>
+  P7DumpFileIo(std::filesystem::path const& fpath, Args&&... args): Base(std::forward<Args>(args)...), m_file(fpath, std::ios::in | std::ios::binary) {
+    m_file.seekg(0, std::ios::end);
+    m_fileSize = m_file.tellg();
+    m_file.seekg(0, std::ios::beg);
+  };
+
+  size_t io_available() const override final {
+    auto cpos = m_file.tellg();
+    if (cpos > m_fileSize) return 0ull;
+    return m_fileSize - cpos;
+  }
+
+  bool io_read(void* buffer, size_t nread) override final {
+    if (m_file.read((char*)buffer, nread)) return true;
+
+    // Same as the memory io, a failed read leaves the position where it was. A failed stream would also make tellg() return -1
+    m_file.clear();
+    m_file.seekg(-m_file.gcount(), std::ios::cur);
+    return false;
+  }
+
+  bool io_skip(size_t nbytes) override final {
+    if (nbytes > io_available()) return false; // seekg() past the end would succeed
+    return m_file.seekg(nbytes, std::ios::cur).good();
+  }
+
+  size_t io_tell() const override final { return m_file.tellg(); }
+
+  bool io_seek(size_t pos) override final {
+    m_file.clear();
+    return m_file.seekg(pos, std::ios::beg).good();
+  }
+
+  protected:
+  // For subclasses that read the file by other means than run()
+  std::istream& io_stream() { return m_file; }
+
+  private:
+  std::ios::pos_type   m_fileSize;
+  mutable std::fstream m_file;
+};
+
+template <typename Base>
+class P7DumpMemIo: public Base {
+  public:
+  template <typename... Args>
+  P7DumpMemIo(void* memory, size_t size, Args&&... args): Base(std::forward<Args>(args)...), m_memPtr(memory), m_memSize(size), m_memCurPos(0) {};
+
+  size_t io_available() const override final {
+    if (m_memCurPos > m_memSize) return 0ull;
+    return m_memSize - m_memCurPos;
+  }
+
+  bool io_read(void* buffer, size_t nread) override final {
+    if ((m_memCurPos + nread) > m_memSize) return false;
+    std::memcpy(buffer, (char*)m_memPtr + m_memCurPos, nread);
+    m_memCurPos += nread;
+    return true;
+  }
+
+  bool io_skip(size_t nbytes) override final {
+    if ((m_memCurPos + nbytes) > m_memSize) return false;
+    m_memCurPos += nbytes;
+    return true;
+  }
+
+  size_t io_tell() const override final { return m_memCurPos; }
+
+  bool io_seek(size_t pos) override final {
+    if (pos > m_memSize) return false;
+    m_memCurPos = pos;
+    return true;
+  }
+
+  const char* io_view(size_t nbytes) override final {
+    if ((m_memCurPos + nbytes) > m_memSize) return nullptr;
+    auto const view = (const char*)m_memPtr + m_memCurPos;
+    m_memCurPos += nbytes;
+    return view;
+  }
+
+  private:
+  void*  m_memPtr;
+  size_t m_memSize;
+  size_t m_memCurPos;
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "libp7d/p7d.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include <zip.h>
+
+// Zip entry backend, the entry is inflated block by block as P7Dump asks for it, so only the current batch is ever held in memory.
+// Not part of libp7d itself, the including target has to link libzip
+
+// Seeking back in a deflated entry makes libzip inflate it again from its start. Recovery mode goes back at most a chunk or a scan
+// window, so the bytes inflated last are kept and such seeks are served from them
+constexpr size_t P7D_ZIP_HISTORY = 2 * P7D_SCAN_WINDOW;
+
+template <typename Base>
+class P7DumpZipIo: public Base {
+  public:
+  template <typename... Args>
+  P7DumpZipIo(zip_file_t* file, size_t size, Args&&... args): Base(std::forward<Args>(args)...), m_file(file), m_size(size) {};
+
+  size_t io_available() const override final {
+    if (m_pos > m_size) return 0ull;
+    return m_size - m_pos;
+  }
+
+  bool io_read(void* buffer, size_t nread) override final {
+    if ((m_pos + nread) > m_size) return false;
+
+    auto dst = (char*)buffer;
+    while (nread > 0 && m_pos < m_inflated) { // Went back before, the history has these
+      auto const at   = m_pos % m_history.size();
+      auto const step = std::min({nread, m_inflated - m_pos, m_history.size() - at});
+      std::memcpy(dst, m_history.data() + at, step);
+      dst += step, nread -= step, m_pos += step;
+    }
+
+    while (nread > 0) {
+      auto const got = zip_fread(m_file, dst, nread);
+      if (got <= 0) return false;
+      remember(dst, got);
+      dst += got, nread -= got, m_pos += got;
+    }
+
+    return true;
+  }
+
+  bool io_skip(size_t nbytes) override final {
+    auto const replayed = std::min(nbytes, m_inflated - m_pos);
+    m_pos += replayed, nbytes -= replayed;
+
+    char scratch[4096];
+    while (nbytes > 0) {
+      auto const step = std::min(nbytes, sizeof(scratch));
+      if (!io_read(scratch, step)) return false;
+      nbytes -= step;
+    }
+
+    return true;
+  }
+
+  size_t io_tell() const override final { return m_pos; }
+
+  bool io_seek(size_t pos) override final {
+    if (pos > m_size) return false;
+    if (pos >= m_pos) return io_skip(pos - m_pos);
+
+    if (m_inflated - pos <= m_remembered) { // Still in the history
+      m_pos = pos;
+      return true;
+    }
+
+    // Further back libzip has to seek itself: only stored entries, or deflated ones with libzip >= 1.9, which inflates up to pos again
+    if (zip_fseek(m_file, (zip_int64_t)pos, SEEK_SET) != 0) return false;
+    m_pos = m_inflated = pos, m_remembered = 0;
+    return true;
+  }
+
+  private:
+  void remember(const char* data, size_t size) {
+    if (m_history.empty()) m_history.resize(P7D_ZIP_HISTORY);
+
+    auto const keep = std::min(size, m_history.size());
+    data += size - keep, m_inflated += size - keep;
+
+    for (size_t done = 0; done < keep;) {
+      auto const at   = m_inflated % m_history.size();
+      auto const step = std::min(keep - done, m_history.size() - at);
+      std::memcpy(m_history.data() + at, data + done, step);
+      done += step, m_inflated += step;
+    }
+
+    m_remembered = std::min(m_remembered + size, m_history.size());
+  }
+
+  zip_file_t* m_file;
+  size_t      m_size;
+  size_t      m_pos = 0;
+
+  std::vector<char> m_history;        // Ring of the bytes inflated last, position p is at p % size
+  size_t            m_inflated   = 0; // How far libzip inflated the entry
+  size_t            m_remembered = 0; // Bytes before m_inflated the history holds
+};
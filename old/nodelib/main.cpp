@@ -1,50 +1,150 @@
 #include "libp7d/p7d.h"
 #include "libp7d/p7da.h"
+#include "libp7d/p7zio.h"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <cstddef>
+#include <cstdint>
 #include <cstdio>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <napi.h>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <zip.h>
 
-Napi::Value MemAnalyze(const Napi::CallbackInfo& info) {
+namespace {
+enum class ResultFormat {
+  Object,  // Plain JS object
+  MsgPack, // Buffer with the MessagePack encoded result, for bulk consumers that store or forward results as they are
+};
+
+// options.format is either "object" (default) or "msgpack", returns false with a pending exception otherwise
+bool GetResultFormat(Napi::Env env, Napi::Object const& options, ResultFormat& format) {
+  format = ResultFormat::Object;
+  if (options.IsEmpty()) return true;
+
+  Napi::Value value = options.Get("format");
+  if (value.IsUndefined()) return true;
+
+  std::string name = value.IsString() ? value.As<Napi::String>().Utf8Value() : "";
+  if (name == "object") return true;
+  if (name == "msgpack") {
+    format = ResultFormat::MsgPack;
+    return true;
+  }
+
+  Napi::TypeError::New(env, "options.format must be \"object\" or \"msgpack\"").ThrowAsJavaScriptException();
+  return false;
+}
+
+// options.memory is the budget of a call in MiB (see PLogOptions::memoryBudget), unbounded if missing. Returns false with a pending exception
+// if it isn't a number of MiB
+bool GetMemoryBudget(Napi::Env env, Napi::Object const& options, size_t& budget) {
+  budget = 0;
+  if (options.IsEmpty()) return true;
+
+  Napi::Value value = options.Get("memory");
+  if (value.IsUndefined()) return true;
+
+  double const mib = value.IsNumber() ? value.As<Napi::Number>().DoubleValue() : -1;
+  if (!(mib >= 0 && mib < (double)(SIZE_MAX >> 20))) {
+    Napi::TypeError::New(env, "options.memory must be a number of MiB").ThrowAsJavaScriptException();
+    return false;
+  }
+
+  budget = (size_t)(mib * 1024 * 1024);
+  return true;
+}
+
+Napi::Value ToJs(Napi::Env env, nlohmann::json const& value) {
+  switch (value.type()) {
+    case nlohmann::json::value_t::boolean: return Napi::Boolean::New(env, value.get<bool>());
+    case nlohmann::json::value_t::number_integer: return Napi::Number::New(env, (double)value.get<int64_t>());
+    case nlohmann::json::value_t::number_unsigned: return Napi::Number::New(env, (double)value.get<uint64_t>());
+    case nlohmann::json::value_t::number_float: return Napi::Number::New(env, value.get<double>());
+    case nlohmann::json::value_t::string: return Napi::String::New(env, value.get_ref<std::string const&>());
+
+    case nlohmann::json::value_t::array: {
+      Napi::Array array = Napi::Array::New(env, value.size());
+      for (uint32_t i = 0; i < value.size(); ++i)
+        array.Set(i, ToJs(env, value[i]));
+      return array;
+    }
+
+    case nlohmann::json::value_t::object: {
+      Napi::Object object = Napi::Object::New(env);
+      for (auto const& [key, item]: value.items())
+        object.Set(key, ToJs(env, item));
+      return object;
+    }
+
+    default: return env.Null();
+  }
+}
+
+Napi::Value MakeResult(Napi::Env env, nlohmann::json const& result, ResultFormat format) {
+  if (format == ResultFormat::MsgPack) {
+    auto const packed = nlohmann::json::to_msgpack(result);
+    return Napi::Buffer<uint8_t>::Copy(env, packed.data(), packed.size());
+  }
+
+  return ToJs(env, result);
+}
+
+Napi::Object GetOptions(const Napi::CallbackInfo& info) {
+  if (info.Length() > 1 && info[1].IsObject()) return info[1].As<Napi::Object>();
+  return Napi::Object();
+}
+
+// The first argument is the log, returns false with a pending exception if it isn't a readable ArrayBuffer
+bool GetLogBuffer(const Napi::CallbackInfo& info, Napi::ArrayBuffer& buffer) {
   Napi::Env env = info.Env();
 
   if (info.Length() < 1) {
-    Napi::TypeError::New(env, "Expected one argument").ThrowAsJavaScriptException();
-    return env.Null();
+    Napi::TypeError::New(env, "Expected at least one argument").ThrowAsJavaScriptException();
+    return false;
   }
 
-  Napi::Value arg = info[0];
-  if (!arg.IsArrayBuffer()) {
+  if (!info[0].IsArrayBuffer()) {
     Napi::TypeError::New(env, "Argument must be an ArrayBuffer").ThrowAsJavaScriptException();
-    return env.Null();
+    return false;
   }
 
-  Napi::ArrayBuffer arrayBuffer = arg.As<Napi::ArrayBuffer>();
+  buffer = info[0].As<Napi::ArrayBuffer>();
+  if (buffer.IsDetached()) { // Transferred, its memory belongs to someone else now
+    Napi::TypeError::New(env, "ArrayBuffer is detached").ThrowAsJavaScriptException();
+    return false;
+  }
+
+  return true;
+}
+} // namespace
+
+Napi::Value MemAnalyze(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  Napi::ArrayBuffer arrayBuffer;
+  if (!GetLogBuffer(info, arrayBuffer)) return env.Null();
+
+  ResultFormat format;
+  PLogOptions  analyse;
+  if (!GetResultFormat(env, GetOptions(info), format) || !GetMemoryBudget(env, GetOptions(info), analyse.memoryBudget)) return env.Null();
+
   void*             data        = arrayBuffer.Data();
   size_t            length      = arrayBuffer.ByteLength();
 
-  std::unique_ptr<P7Dump> analyzer = createMemAnalyser(data, length);
+  std::unique_ptr<P7Dump> analyzer = createMemAnalyser(data, length, analyse);
 
   try {
     if (analyzer->run()) {
-      std::string  ret       = analyzer->spit();
-      Napi::Object global    = env.Global();
-      Napi::Value  jsonValue = global.Get("JSON");
-      if (!jsonValue.IsObject()) {
-        Napi::Error::New(env, "JSON not found").ThrowAsJavaScriptException();
-        return env.Null();
-      }
-      Napi::Object json    = jsonValue.As<Napi::Object>();
-      Napi::Value  parseFn = json.Get("parse");
-      if (!parseFn.IsFunction()) {
-        Napi::Error::New(env, "JSON.parse not found").ThrowAsJavaScriptException();
-        return env.Null();
-      }
-      Napi::Function parse      = parseFn.As<Napi::Function>();
-      Napi::String   jsonString = Napi::String::New(env, ret);
-      Napi::Value    result     = parse.Call(json, {jsonString});
-      return result;
+      return MakeResult(env, static_cast<P7DumpAnalyser&>(*analyzer).result(), format);
     } else {
       Napi::Error::New(env, "Analyzer run failed").ThrowAsJavaScriptException();
       return env.Null();
@@ -55,8 +155,544 @@ Napi::Value MemAnalyze(const Napi::CallbackInfo& info) {
   }
 }
 
+namespace {
+struct PoolJob;
+struct JobEvent;
+
+void OnJobEvent(Napi::Env env, Napi::Function, std::nullptr_t*, JobEvent* event);
+
+// Partial reports and the end of the job go through the same queue, so options.progress is never called after the promise settled
+using JobEventTsfn = Napi::TypedThreadSafeFunction<std::nullptr_t, JobEvent, OnJobEvent>;
+
+// Result of a single analyser run, filled on a pool thread
+struct AnalyseOutcome {
+  enum class Status {
+    Done,
+    Failed,
+    Cancelled,
+  };
+
+  Status               status = Status::Failed;
+  nlohmann::json       result;
+  std::vector<uint8_t> packed; // MessagePack is encoded here on the pool thread, not on the main one
+  std::string          error;
+
+  void run(P7Dump& analyzer, ResultFormat format) {
+    try {
+      if (analyzer.run()) {
+        status = Status::Done;
+        result = static_cast<P7DumpAnalyser&>(analyzer).result();
+        if (format == ResultFormat::MsgPack) packed = nlohmann::json::to_msgpack(result);
+      } else if (analyzer.cancelled()) {
+        status = Status::Cancelled;
+      } else {
+        error = "Analyzer run failed";
+      }
+    } catch (const std::exception& ex) {
+      error = ex.what();
+    }
+  }
+
+  Napi::Value value(Napi::Env env, ResultFormat format) const {
+    if (format == ResultFormat::MsgPack) return Napi::Buffer<uint8_t>::Copy(env, packed.data(), packed.size());
+    return ToJs(env, result);
+  }
+};
+
+Napi::Value AbortError(Napi::Env env) {
+  Napi::Error error = Napi::Error::New(env, "Analysis cancelled");
+  error.Set("name", Napi::String::New(env, "AbortError"));
+  return error.Value();
+}
+
+// Promise backed work, created on the main thread, executed by the pool and settled back on the main thread by OnJobEvent.
+// Pool threads read the ArrayBuffer as it is, it must not be transferred while the promise is pending
+struct PoolJob {
+  Napi::Promise::Deferred            deferred;
+  Napi::Reference<Napi::ArrayBuffer> buffer; // Keeps the memory alive while pool threads read it, nothing gets copied
+  Napi::ObjectReference              signal; // AbortSignal and our listener on it, removed once the job is settled
+  Napi::FunctionReference            listener;
+  Napi::FunctionReference            progress; // options.progress, see publish()
+  JobEventTsfn                       events;
+
+  const char*                        data = nullptr;
+  size_t                             size = 0;
+  std::string                        path; // Read instead of the buffer if the job accepts one and got it
+  std::shared_ptr<std::atomic<bool>> cancel; // Shared with the AbortSignal listener
+  ResultFormat                       format;
+  PLogOptions                        analyse;
+
+  PoolJob(Napi::Env env): deferred(Napi::Promise::Deferred::New(env)) {}
+
+  virtual ~PoolJob() = default;
+
+  // Validates the (buffer or path, options) arguments, returns false with a pending exception
+  bool setup(const Napi::CallbackInfo& info, const char* name, bool acceptsPath = false) {
+    Napi::Env env = info.Env();
+
+    Napi::ArrayBuffer arrayBuffer;
+    if (acceptsPath && info.Length() > 0 && info[0].IsString())
+      path = info[0].As<Napi::String>().Utf8Value();
+    else if (!GetLogBuffer(info, arrayBuffer))
+      return false;
+
+    Napi::Object options = GetOptions(info);
+    if (!GetResultFormat(env, options, format) || !GetMemoryBudget(env, options, analyse.memoryBudget) || !getProgress(env, options)) return false;
+
+    cancel = std::make_shared<std::atomic<bool>>(false);
+
+    Napi::Value signalValue = options.IsEmpty() ? env.Undefined() : options.Get("signal");
+    if (!signalValue.IsUndefined()) {
+      Napi::Value addListener = signalValue.IsObject() ? signalValue.As<Napi::Object>().Get("addEventListener") : env.Undefined();
+      if (!addListener.IsFunction()) {
+        Napi::TypeError::New(env, "options.signal must be an AbortSignal").ThrowAsJavaScriptException();
+        return false;
+      }
+
+      Napi::Object abortSignal = signalValue.As<Napi::Object>();
+      if (abortSignal.Get("aborted").ToBoolean()) cancel->store(true);
+
+      auto           flag    = cancel;
+      Napi::Function onAbort = Napi::Function::New(env, [flag](const Napi::CallbackInfo&) { flag->store(true); });
+      addListener.As<Napi::Function>().Call(abortSignal, {Napi::String::New(env, "abort"), onAbort});
+      if (env.IsExceptionPending()) return false;
+
+      signal   = Napi::Persistent(abortSignal);
+      listener = Napi::Persistent(onAbort);
+    }
+
+    if (path.empty()) {
+      buffer = Napi::Persistent(arrayBuffer);
+      data   = (const char*)arrayBuffer.Data();
+      size   = arrayBuffer.ByteLength();
+    }
+
+    events = JobEventTsfn::New(env, name, 0, 1);
+    return true;
+  }
+
+  // options.progress(partial, entry) gets the partial reports of PLogOptions::progress, every options.progressLines lines and on
+  // the events listed there. entry is the name of the zip entry the report is of, undefined for single logs
+  bool getProgress(Napi::Env env, Napi::Object const& options) {
+    if (options.IsEmpty()) return true;
+
+    Napi::Value callback = options.Get("progress");
+    if (!callback.IsUndefined() && !callback.IsFunction()) {
+      Napi::TypeError::New(env, "options.progress must be a function").ThrowAsJavaScriptException();
+      return false;
+    }
+
+    Napi::Value lines = options.Get("progressLines");
+    if (!lines.IsUndefined() && !(lines.IsNumber() && lines.As<Napi::Number>().DoubleValue() >= 1)) {
+      Napi::TypeError::New(env, "options.progressLines must be a positive number").ThrowAsJavaScriptException();
+      return false;
+    }
+
+    if (callback.IsFunction()) progress = Napi::Persistent(callback.As<Napi::Function>());
+    if (lines.IsNumber()) analyse.progressLines = (uint64_t)lines.As<Napi::Number>().Int64Value();
+    return true;
+  }
+
+  // Options for one analysis of the job, partial reports carry the entry they are of
+  PLogOptions analyseOptions(std::string_view entry = {}) {
+    auto result = analyse;
+    if (!progress.IsEmpty()) result.progress = [this, entry](nlohmann::json const& partial) { publish(partial, entry); };
+    return result;
+  }
+
+  // Pool thread, queues a partial report for options.progress. A cancelled job has no use for them anymore
+  void publish(nlohmann::json const& partial, std::string_view entry);
+
+  // Main thread
+  void report(Napi::Env env, nlohmann::json const& partial, std::string const& entry) {
+    if (progress.IsEmpty() || cancel->load()) return;
+    progress.Value().Call({MakeResult(env, partial, format), entry.empty() ? env.Undefined() : Napi::String::New(env, entry)});
+    // A throwing callback is reported as uncaught, like a throwing event listener
+  }
+
+  // Main thread, once the job is of no more interest to the signal
+  void unsubscribe(Napi::Env env) {
+    if (signal.IsEmpty()) return;
+
+    Napi::Value removeListener = signal.Value().Get("removeEventListener");
+    if (removeListener.IsFunction()) removeListener.As<Napi::Function>().Call(signal.Value(), {Napi::String::New(env, "abort"), listener.Value()});
+    if (env.IsExceptionPending()) env.GetAndClearPendingException(); // A signal we can't unsubscribe from only keeps the listener alive
+    signal.Reset(), listener.Reset();
+  }
+
+  // Main thread, before settle(). Returns false if the promise was rejected already
+  bool finish(Napi::Env env) {
+    unsubscribe(env);
+    progress.Reset();
+
+    if (!buffer.IsEmpty() && buffer.Value().IsDetached()) { // Transferred while pool threads were still reading it, whatever they got can't be trusted
+      deferred.Reject(Napi::Error::New(env, "ArrayBuffer was detached during the analysis").Value());
+      return false;
+    }
+
+    return true;
+  }
+
+  // Env teardown, the references can't be deleted anymore
+  void abandon() {
+    buffer.SuppressDestruct();
+    signal.SuppressDestruct();
+    listener.SuppressDestruct();
+    progress.SuppressDestruct();
+  }
+
+  // Called on a pool thread once all the work is done, OnJobEvent takes the ownership
+  void complete();
+
+  virtual void settle(Napi::Env env) = 0;
+};
+
+// Sent from pool threads to the main thread: a partial report, or the end of the job if there is none
+struct JobEvent {
+  PoolJob*                        job;
+  std::unique_ptr<nlohmann::json> partial;
+  std::string                     entry;
+};
+
+void PoolJob::publish(nlohmann::json const& partial, std::string_view entry) {
+  if (cancel->load()) return;
+
+  auto event = new JobEvent {.job = this, .partial = std::make_unique<nlohmann::json>(partial), .entry = std::string(entry)};
+  if (events.BlockingCall(event) != napi_ok) delete event; // The env is already closing
+}
+
+void PoolJob::complete() {
+  auto event = new JobEvent {.job = this, .partial = nullptr, .entry = {}};
+  if (events.BlockingCall(event) != napi_ok) { // The env is already closing
+    delete event;
+    abandon();
+    delete this;
+  }
+}
+
+struct MemJob: PoolJob {
+  AnalyseOutcome outcome;
+
+  using PoolJob::PoolJob;
+
+  void execute() {
+    if (cancel->load()) {
+      outcome.status = AnalyseOutcome::Status::Cancelled;
+      return;
+    }
+
+    std::unique_ptr<P7Dump> analyzer = createMemAnalyser((void*)data, size, analyseOptions());
+    analyzer->setCancelFlag(cancel.get());
+    outcome.run(*analyzer, format);
+  }
+
+  void settle(Napi::Env env) override {
+    switch (outcome.status) {
+      case AnalyseOutcome::Status::Done: deferred.Resolve(outcome.value(env, format)); break;
+      case AnalyseOutcome::Status::Failed: deferred.Reject(Napi::Error::New(env, outcome.error).Value()); break;
+      case AnalyseOutcome::Status::Cancelled: deferred.Reject(AbortError(env)); break;
+    }
+  }
+};
+
+// Every .p7d entry of the archive is a separate pool task, the last one to finish settles the promise
+struct ZipJob: PoolJob {
+  struct Entry {
+    zip_uint64_t   index;
+    zip_uint64_t   size;
+    std::string    name;
+    AnalyseOutcome outcome;
+  };
+
+  std::vector<Entry>  entries;
+  std::atomic<size_t> remaining;
+
+  using PoolJob::PoolJob;
+
+  // Runs on the main thread, only the central directory is read here
+  bool list(std::string& error) {
+    zip_error_t zerr;
+    zip_error_init(&zerr);
+
+    zip_t* zarc = open(zerr);
+    if (zarc == nullptr) {
+      error = zip_error_strerror(&zerr);
+      zip_error_fini(&zerr);
+      return false;
+    }
+    zip_error_fini(&zerr);
+
+    zip_int64_t const num_files = zip_get_num_entries(zarc, 0);
+    for (zip_int64_t i = 0; i < num_files; ++i) {
+      zip_stat_t sb;
+      if (zip_stat_index(zarc, i, 0, &sb) < 0) continue;
+      if (!std::string_view(sb.name).ends_with(".p7d")) continue;
+
+      auto& entry = entries.emplace_back(Entry {.index = (zip_uint64_t)i, .size = sb.size, .name = sb.name});
+      if (sb.encryption_method != ZIP_EM_NONE) entry.outcome.error = "This file is encrypted";
+    }
+
+    zip_discard(zarc);
+    remaining = entries.size();
+    return true;
+  }
+
+  // libzip archives can't be shared between threads, so every task opens its own one over the same buffer or file
+  zip_t* open(zip_error_t& zerr) const {
+    zip_source_t* zsrc = path.empty() ? zip_source_buffer_create(data, size, 0, &zerr) : zip_source_file_create(path.c_str(), 0, ZIP_LENGTH_TO_END, &zerr);
+    if (zsrc == nullptr) return nullptr;
+
+    zip_t* zarc = zip_open_from_source(zsrc, ZIP_RDONLY, &zerr);
+    if (zarc == nullptr) zip_source_free(zsrc);
+    return zarc;
+  }
+
+  void execute(Entry& entry) {
+    if (cancel->load()) {
+      entry.outcome.status = AnalyseOutcome::Status::Cancelled;
+      return;
+    }
+    if (!entry.outcome.error.empty()) return;
+
+    zip_error_t zerr;
+    zip_error_init(&zerr);
+
+    zip_t*      zarc = open(zerr);
+    zip_file_t* zf   = zarc != nullptr ? zip_fopen_index(zarc, entry.index, 0) : nullptr;
+    if (zf == nullptr) {
+      entry.outcome.error = zarc != nullptr ? zip_strerror(zarc) : zip_error_strerror(&zerr);
+      if (zarc != nullptr) zip_discard(zarc);
+      zip_error_fini(&zerr);
+      return;
+    }
+    zip_error_fini(&zerr);
+
+    P7DumpZipIo<P7DumpAnalyser> analyzer(zf, entry.size, analyseOptions(entry.name));
+    analyzer.setCancelFlag(cancel.get());
+    entry.outcome.run(analyzer, format);
+
+    zip_fclose(zf);
+    zip_discard(zarc);
+  }
+
+  void settle(Napi::Env env) override {
+    Napi::Array results = Napi::Array::New(env, entries.size());
+
+    for (uint32_t i = 0; i < entries.size(); ++i) {
+      auto const& entry = entries[i];
+      if (entry.outcome.status == AnalyseOutcome::Status::Cancelled) {
+        deferred.Reject(AbortError(env));
+        return;
+      }
+
+      Napi::Object item = Napi::Object::New(env);
+      item.Set("name", Napi::String::New(env, entry.name));
+      if (entry.outcome.status == AnalyseOutcome::Status::Done)
+        item.Set("result", entry.outcome.value(env, format));
+      else
+        item.Set("error", Napi::String::New(env, entry.outcome.error));
+      results.Set(i, item);
+    }
+
+    deferred.Resolve(results);
+  }
+};
+
+// Analysers run here instead of the libuv pool, so a few huge logs can't starve node's own file and dns work
+class AnalysePool {
+  public:
+  AnalysePool(): m_size(std::max(1u, std::thread::hardware_concurrency() / 2)) {}
+
+  ~AnalysePool() {
+    {
+      std::unique_lock lock(m_mutex);
+      m_stopping = true;
+
+      // Running analysers give up at their next batch, so the joins below don't wait for whole logs
+      for (auto const& task: m_queue)
+        task.cancel->store(true);
+      for (auto const& cancel: m_active)
+        cancel->store(true);
+    }
+    m_cond.notify_all();
+
+    for (auto& thread: m_threads)
+      thread.join();
+
+    // Tasks still queued are dropped, their jobs are leaked on purpose: the env is going away and their references can't be deleted anymore
+  }
+
+  void resize(size_t size) {
+    {
+      std::unique_lock lock(m_mutex);
+      m_size = std::max<size_t>(size, 1);
+    }
+    m_cond.notify_all(); // Lets extra workers quit
+  }
+
+  size_t size() const { return m_size; }
+
+  // cancel is the flag of the job the task belongs to, raised if the pool goes away before the task is done
+  void push(std::function<void()> task, std::shared_ptr<std::atomic<bool>> cancel) {
+    {
+      std::unique_lock lock(m_mutex);
+      m_queue.push_back({.run = std::move(task), .cancel = std::move(cancel)});
+
+      // Workers are spawned on demand, up to the pool size
+      if (m_running < m_size && m_queue.size() > m_idle) {
+        ++m_running;
+        m_threads.emplace_back(&AnalysePool::worker, this);
+      }
+    }
+    m_cond.notify_one();
+  }
+
+  private:
+  void worker() {
+    std::unique_lock lock(m_mutex);
+
+    while (true) {
+      ++m_idle;
+      m_cond.wait(lock, [this] { return m_stopping || m_running > m_size || !m_queue.empty(); });
+      --m_idle;
+
+      if (m_stopping || m_running > m_size) break;
+
+      auto task = std::move(m_queue.front());
+      m_queue.pop_front();
+      m_active.push_back(task.cancel);
+
+      lock.unlock();
+      task.run();
+      lock.lock();
+
+      m_active.erase(std::find(m_active.begin(), m_active.end(), task.cancel));
+    }
+
+    --m_running;
+  }
+
+  struct Task {
+    std::function<void()>              run;
+    std::shared_ptr<std::atomic<bool>> cancel;
+  };
+
+  std::mutex              m_mutex;
+  std::condition_variable m_cond;
+
+  std::deque<Task>                                m_queue;
+  std::vector<std::shared_ptr<std::atomic<bool>>> m_active; // Of the tasks being run
+  std::vector<std::thread>                        m_threads;
+
+  size_t m_size;
+  size_t m_running  = 0;
+  size_t m_idle     = 0;
+  bool   m_stopping = false;
+};
+
+AnalysePool& GetPool(Napi::Env env) {
+  auto pool = env.GetInstanceData<AnalysePool>();
+  if (pool == nullptr) {
+    pool = new AnalysePool();
+    env.SetInstanceData(pool); // Deleted (and joined) when the env is torn down
+  }
+
+  return *pool;
+}
+
+void OnJobEvent(Napi::Env env, Napi::Function, std::nullptr_t*, JobEvent* event) {
+  std::unique_ptr<JobEvent> received(event);
+  if (event->partial != nullptr) { // The job is still running, at env teardown nobody is interested anymore
+    if (env != nullptr) event->job->report(env, *event->partial, event->entry);
+    return;
+  }
+
+  std::unique_ptr<PoolJob> owned(event->job);
+  owned->events.Release();
+
+  if (env == nullptr) { // Env teardown, nobody is waiting for the promise anymore
+    owned->abandon();
+    return;
+  }
+
+  if (owned->finish(env)) owned->settle(env);
+}
+} // namespace
+
+Napi::Value MemAnalyzeAsync(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  auto job = std::make_unique<MemJob>(env);
+  if (!job->setup(info, "meman")) return env.Null();
+
+  Napi::Promise promise = job->deferred.Promise();
+  auto cancel = job->cancel;
+  GetPool(env).push(
+      [job = job.release()] {
+        job->execute();
+        job->complete();
+      },
+      std::move(cancel));
+  return promise;
+}
+
+Napi::Value ZipAnalyze(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  auto job = std::make_unique<ZipJob>(env);
+  if (!job->setup(info, "analyzeZip", true)) return env.Null();
+
+  Napi::Promise promise = job->deferred.Promise();
+
+  std::string error;
+  if (!job->list(error)) {
+    job->deferred.Reject(Napi::Error::New(env, "Failed to open zip: " + error).Value());
+    job->unsubscribe(env);
+    job->events.Release();
+    return promise;
+  }
+
+  if (job->entries.empty()) {
+    job->deferred.Resolve(Napi::Array::New(env));
+    job->unsubscribe(env);
+    job->events.Release();
+    return promise;
+  }
+
+  auto& pool = GetPool(env);
+  auto  raw  = job.release();
+
+  raw->analyse = raw->analyse.share(std::min(pool.size(), raw->entries.size())); // Entries run side by side, the call's budget is split
+  for (size_t i = 0, count = raw->entries.size(); i < count; ++i) { // The last task may free the job before the loop is done with it
+    pool.push(
+        [raw, &entry = raw->entries[i]] {
+          raw->execute(entry);
+          if (--raw->remaining == 0) raw->complete();
+        },
+        raw->cancel);
+  }
+
+  return promise;
+}
+
+Napi::Value SetPoolSize(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (info.Length() < 1 || !info[0].IsNumber()) {
+    Napi::TypeError::New(env, "Argument must be a number").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  auto& pool = GetPool(env);
+  pool.resize(info[0].As<Napi::Number>().Uint32Value());
+  return Napi::Number::New(env, (double)pool.size());
+}
+
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
   exports.Set("meman", Napi::Function::New(env, MemAnalyze));
+  exports.Set("memanAsync", Napi::Function::New(env, MemAnalyzeAsync));
+  exports.Set("analyzeZip", Napi::Function::New(env, ZipAnalyze));
+  exports.Set("setPoolSize", Napi::Function::New(env, SetPoolSize));
   return exports;
 }
 
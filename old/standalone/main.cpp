@@ -1,5 +1,7 @@
 #include "libp7d/p7d.h"
 #include "libp7d/p7da.h"
+#include "libp7d/p7dc.h"
+#include "libp7d/p7zio.h"
 #include "zipconf.h"
 
 #include <Windows.h>
@@ -8,9 +10,11 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <filesystem>
 #include <format>
+#include <fstream>
 #include <iostream>
 #include <iterator>
 #include <memory>
@@ -50,7 +54,32 @@ enum LogAnExitCodes : int32_t {
   _ZipErrorsEnd = 300,
 };
 
+static bool            g_recoveryMode  = false;
+static bool            g_convert       = false; // Write the decoded lines to g_convertOut instead of analysing them
+static P7ConvertFormat g_convertFormat = P7ConvertFormat::Plog;
+static std::ofstream   g_convertOut;
+static PLogOptions     g_options;
+
+static std::unique_ptr<P7Dump> createMemDump(void* memory, size_t size) {
+  if (g_convert) return createMemConverter(memory, size, g_convertOut, g_convertFormat);
+  return createMemAnalyser(memory, size, g_options);
+}
+
+// Inflates the entry while it's being decoded instead of unpacking it first, used with a memory budget
+static std::unique_ptr<P7Dump> createZipDump(zip_file_t* file, size_t size) {
+  if (g_convert) return std::make_unique<P7DumpZipIo<P7DumpConverter>>(file, size, g_convertOut, g_convertFormat);
+  return std::make_unique<P7DumpZipIo<P7DumpAnalyser>>(file, size, g_options);
+}
+
+static std::unique_ptr<P7Dump> createFileDump(std::filesystem::path const& fpath) {
+  if (fpath.extension() == ".p7dc") return createColumnarAnalyser(fpath, g_options);
+  if (g_convert) return createFileConverter(fpath, g_convertOut, g_convertFormat);
+  return createFileAnalyser(fpath, g_options);
+}
+
 static void runAnalyser(std::unique_ptr<P7Dump> const& analyser) {
+  analyser->setRecoveryMode(g_recoveryMode);
+
   try {
     if (analyser->run()) {
       printf("%s", analyser->spit().c_str());
@@ -65,13 +94,42 @@ static void runAnalyser(std::unique_ptr<P7Dump> const& analyser) {
 
 int32_t main(int32_t argc, char* argv[]) {
   if (argc < 2) {
-    fprintf(stderr, "Usage: %s <p7d file path> [--noblock]", argv[0]);
+    fprintf(stderr,
+            "Usage: %s <p7d file path> [--noblock] [--recover] [--templates] [--memory <budget in MiB>] [--progress]"
+            " [--convert <out file> [--columnar]]",
+            argv[0]);
     return LogAnExitCodes::ArgumentFail;
   }
 
+  bool noBlock = false;
+  for (int32_t i = 2; i < argc; ++i) {
+    auto const arg = std::string_view(argv[i]);
+    if (arg == "--noblock")
+      noBlock = true;
+    else if (arg == "--recover")
+      g_recoveryMode = true;
+    else if (arg == "--columnar")
+      g_convertFormat = P7ConvertFormat::Columnar;
+    else if (arg == "--templates")
+      g_options.templates = true;
+    else if (arg == "--memory" && (i + 1) < argc)
+      g_options.memoryBudget = std::strtoull(argv[++i], nullptr, 10) * 1024 * 1024;
+    else if (arg == "--progress")
+      g_options.progress = [](nlohmann::json const& partial) { fprintf(stderr, "%s\n", partial.dump(-1, ' ', true).c_str()); };
+    else if (arg == "--convert" && (i + 1) < argc) {
+      g_convertOut.open(argv[++i], std::ios::out | std::ios::binary | std::ios::trunc);
+      if (!g_convertOut.is_open()) {
+        fprintf(stderr, "Failed to open %s for writing\n", argv[i]);
+        return LogAnExitCodes::ArgumentFail;
+      }
+      g_convert = true;
+    }
+  }
+
   if (auto argLink = std::string_view(argv[1]); !argLink.empty()) {
     std::unique_ptr<P7Dump> analyser;
     std::vector<char>       growingdata, unpdata;
+    bool                    analysed = false; // Zip entries streamed under a memory budget are analysed right away
 
     if (argLink.starts_with("http")) {
       int32_t need = MultiByteToWideChar(CP_UTF8, 0, argLink.data(), -1, nullptr, 0);
@@ -198,6 +256,12 @@ int32_t main(int32_t argc, char* argv[]) {
             return LogAnExitCodes::HttpTooMuch;
           }
 
+          // The archive can't be analysed in parts, it has to fit next to the analysis
+          if (g_options.memoryBudget != 0 && growingdata.size() + downloaded > g_options.memoryBudget / 2) {
+            fprintf(stderr, "Server sent more than half of the memory budget!\n");
+            return LogAnExitCodes::HttpTooMuch;
+          }
+
           growingdata.insert(growingdata.end(), std::begin(buffer), std::begin(buffer) + downloaded);
         } while (true);
 
@@ -347,6 +411,20 @@ int32_t main(int32_t argc, char* argv[]) {
             return LogAnExitCodes::Success;
           };
 
+          // Same under a memory budget, but the entry is never held whole, it's decoded straight out of the archive
+          auto streamZipFile = [zarc](MenuEntry& lf) {
+            zip_file_t* zf = zip_fopen_index(zarc, lf.index, 0);
+
+            if (zf == nullptr) {
+              fprintf(stderr, "Failed to open zip file: %s\n", zip_strerror(zarc));
+              return LogAnExitCodes::ZipUnexpected;
+            }
+
+            runAnalyser(createZipDump(zf, lf.size));
+            zip_fclose(zf);
+            return LogAnExitCodes::Success;
+          };
+
           if (files.size() > 1) { // Entering interactive mode
             while (true) {
               std::cout << "\x1b[0;0H\x1b[2J0. [Exit]" << std::endl;
@@ -360,11 +438,16 @@ int32_t main(int32_t argc, char* argv[]) {
               getchar(); // Skip newline
               if (index == 0) break;
               if (index > files.size()) continue;
-              if (unpackZipFile(files[index - 1]) != LogAnExitCodes::Success) {
+              if (g_options.memoryBudget != 0) {
+                std::cout << "\x1b[0;0H\x1b[2J";
+                streamZipFile(files[index - 1]);
+              } else {
+                if (unpackZipFile(files[index - 1]) != LogAnExitCodes::Success) {
+                }
+                std::cout << "\x1b[0;0H\x1b[2J";
+                runAnalyser(createMemDump(unpdata.data(), unpdata.size()));
+                unpdata.clear();
               }
-              std::cout << "\x1b[0;0H\x1b[2J";
-              runAnalyser(createMemAnalyser(unpdata.data(), unpdata.size()));
-              unpdata.clear();
               std::cout << std::endl << "Press enter to go back...";
               while (getchar() != '\n')
                 ;
@@ -373,6 +456,12 @@ int32_t main(int32_t argc, char* argv[]) {
             zip_close(zarc);
             zip_source_close(zsrc);
             return LogAnExitCodes::Success;
+          } else if (g_options.memoryBudget != 0) {
+            auto const result = streamZipFile(files.front());
+            zip_close(zarc);
+            zip_source_close(zsrc);
+            if (result != LogAnExitCodes::Success) return result;
+            analysed = true;
           } else {
             if (unpackZipFile(files.front()) != LogAnExitCodes::Success) {
               zip_close(zarc);
@@ -386,24 +475,24 @@ int32_t main(int32_t argc, char* argv[]) {
           }
         }
 
-        analyser = createMemAnalyser(outdata, outdatasize);
+        if (!analysed) analyser = createMemDump(outdata, outdatasize);
       } else {
         fprintf(stderr, "Invalid output buffer!\n");
         return LogAnExitCodes::BufferFail;
       }
     } else if (auto fpath = std::filesystem::path(argLink); std::filesystem::exists(fpath)) {
-      analyser = createFileAnalyser(argv[1]);
+      analyser = createFileDump(fpath);
     }
 
     if (analyser != nullptr) {
       runAnalyser(analyser);
-    } else {
+    } else if (!analysed) {
       fprintf(stderr, "P7Dump fail: No suitable analyser found for specified link\n");
       return LogAnExitCodes::NoAnalyser;
     }
   }
 
-  if (argc == 2 || std::string_view(argv[2]) != "--noblock") {
+  if (!noBlock) {
     while (true)
       std::this_thread::sleep_for(std::chrono::seconds(1));
   }
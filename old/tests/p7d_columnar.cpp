@@ -0,0 +1,108 @@
+#include "libp7d/p7dc.h"
+#include "libp7d/p7exceptions.h"
+#include "p7dbuild.h"
+#include "tests/check.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static std::vector<char> makeDump() {
+  P7DumpBuilder dump;
+  dump.streamInfo(u"trace").module(0, "Kernel").module(1, "runtime").description(0, 0, u"--> thread main").description(1, 1, u"Missing Symbol|foo");
+  dump.chunk(0);
+  dump.streamInfo(u"tty").module(0, "TTY").description(0, 0, u"hello").chunk(1);
+
+  for (uint32_t i = 0; i < 3000; ++i) // More rows than one block holds
+    dump.data(i % 2, i % 3, i).data(0).data(1).data(0).data(1).data(0).data(1).data(0).data(1).data(0).chunk(0).data(0, 7, i).chunk(1);
+  return dump.dump();
+}
+
+static std::string convert(std::vector<char>& dump) {
+  std::ostringstream out(std::ios::binary);
+  CHECK(createMemConverter(dump.data(), dump.size(), out, P7ConvertFormat::Columnar)->run());
+  return out.str();
+}
+
+template <typename T>
+static T at(std::string const& bytes, size_t offset) {
+  T value;
+  std::memcpy(&value, bytes.data() + offset, sizeof(T));
+  return value;
+}
+
+static std::string replay(std::string const& columnar) {
+  auto const path = std::filesystem::temp_directory_path() / "p7d_columnar.p7dc";
+  std::ofstream(path, std::ios::binary).write(columnar.data(), columnar.size());
+
+  std::string report;
+  try {
+    auto analyser = createColumnarAnalyser(path);
+    if (analyser->run()) report = analyser->spit();
+  } catch (P7DumpCorruptedItemException const&) {
+    report = "corrupted";
+  }
+
+  std::filesystem::remove(path);
+  return report;
+}
+
+static void testReplayMatchesDump() {
+  auto       dump     = makeDump();
+  auto const columnar = convert(dump);
+
+  auto direct = createMemAnalyser(dump.data(), dump.size());
+  CHECK(direct->run());
+  CHECK(replay(columnar) == direct->spit());
+}
+
+static void testBlocksDefineWhatTheyUse() {
+  auto       dump     = makeDump();
+  auto const columnar = convert(dump);
+
+  auto const footer      = columnar.size() - 16 - sizeof(P7DC_INDEX_MAGIC);
+  auto const blockCount  = at<uint64_t>(columnar, footer);
+  auto const indexOffset = at<uint64_t>(columnar, footer + 8);
+  CHECK(blockCount > 1);
+
+  for (uint64_t i = 0; i < blockCount; ++i) {
+    auto const block = at<P7ColumnarBlock>(columnar, indexOffset + i * sizeof(P7ColumnarBlock));
+    CHECK(at<uint32_t>(columnar, block.offset + 4) == 2);  // Both channels
+    CHECK(at<uint32_t>(columnar, block.offset + 8) == 3);  // Kernel, runtime and TTY
+    CHECK(at<uint32_t>(columnar, block.offset + 12) == 3); // The three lines
+  }
+}
+
+static void testCorruptSizesAreRejected() {
+  auto       dump     = makeDump();
+  auto const columnar = convert(dump);
+
+  auto const footer      = columnar.size() - 16 - sizeof(P7DC_INDEX_MAGIC);
+  auto const indexOffset = at<uint64_t>(columnar, footer + 8);
+
+  auto blockCount = columnar;
+  std::memset(blockCount.data() + footer, 0x7f, sizeof(uint64_t));
+  CHECK(replay(blockCount) == "corrupted");
+
+  // The last block ends with its text, right after the text length which is the last of its text offsets
+  auto const last     = at<P7ColumnarBlock>(columnar, indexOffset + (at<uint64_t>(columnar, footer) - 1) * sizeof(P7ColumnarBlock));
+  size_t     lengthAt = 0;
+  for (size_t pos = indexOffset - sizeof(uint32_t); pos > last.offset && lengthAt == 0; pos -= sizeof(char16_t)) {
+    if (pos + sizeof(uint32_t) + at<uint32_t>(columnar, pos) * sizeof(char16_t) == indexOffset) lengthAt = pos;
+  }
+  if (!CHECK(lengthAt != 0)) return;
+
+  auto text = columnar;
+  std::memset(text.data() + lengthAt, 0x7f, sizeof(uint32_t));
+  CHECK(replay(text) == "corrupted");
+}
+
+int main() {
+  testReplayMatchesDump();
+  testBlocksDefineWhatTheyUse();
+  testCorruptSizesAreRejected();
+  return check::result();
+}
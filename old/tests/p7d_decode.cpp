@@ -0,0 +1,123 @@
+#include "libp7d/p7exceptions.h"
+#include "libp7d/p7io.h"
+#include "p7dbuild.h"
+#include "tests/check.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using P7MemCollector  = P7DumpMemIo<P7Collector>;
+using P7FileCollector = P7DumpFileIo<P7Collector>;
+
+static void testRedefinitionKeepsFirst() {
+  P7DumpBuilder dump;
+  dump.streamInfo(u"trace").module(0, "first").module(0, "second").description(0, 0, u"first text").description(0, 0, u"second text").data(0);
+  dump.chunk(0);
+
+  P7MemCollector collector(dump.dump().data(), dump.dump().size());
+  CHECK(collector.run());
+  if (!CHECK(collector.lines.size() == 1)) return;
+  CHECK(collector.lines[0].text == u"first text");
+  CHECK(collector.lines[0].module == "first");
+}
+
+static void testStateChangesBetweenLines() {
+  P7DumpBuilder dump;
+  dump.streamInfo(u"first").description(0, 1, u"text").data(0).module(1, "late").data(0).chunk(0);
+  dump.streamInfo(u"second").data(0).chunk(0);
+
+  P7MemCollector collector(dump.dump().data(), dump.dump().size());
+  CHECK(collector.run());
+  if (!CHECK(collector.lines.size() == 3)) return;
+  CHECK(collector.lines[0].stream == u"first" && collector.lines[0].module.empty());
+  CHECK(collector.lines[1].stream == u"first" && collector.lines[1].module == "late");
+  CHECK(collector.lines[2].stream == u"second" && collector.lines[2].module == "late");
+}
+
+static void testChannelsRenderInChunkOrder() {
+  std::u16string const names[] = {u"zero", u"one", u"two"};
+
+  P7DumpBuilder dump;
+  for (uint8_t ch = 0; ch < 3; ++ch)
+    dump.streamInfo(names[ch]).description(0, 0, names[ch]).chunk(ch);
+
+  std::vector<std::u16string> expected;
+  for (uint32_t i = 0; i < 3000; ++i) { // Several batches, the decoding threads are reused
+    auto const ch = (i * 7 + i / 5) % 3;
+    dump.data(0).data(0).chunk(ch);
+    expected.insert(expected.end(), 2, names[ch]);
+  }
+
+  P7MemCollector collector(dump.dump().data(), dump.dump().size());
+  CHECK(collector.run());
+
+  std::vector<std::u16string> rendered;
+  for (auto const& line: collector.lines)
+    rendered.push_back(line.text);
+  CHECK(rendered == expected);
+}
+
+static void testOverreadInWholeChunkIsCorruption() {
+  std::vector<char> header;
+  P7DumpBuilder::put(header, uint32_t(0x02 << 5 | 64 << 10)); // Data item that claims 64 bytes, only 8 follow
+
+  P7DumpBuilder dump;
+  dump.streamInfo(u"trace").description(0, 0, u"text").data(0).bytes(header).bytes(std::vector<char>(8)).chunk(0);
+
+  P7MemCollector collector(dump.dump().data(), dump.dump().size());
+  bool corrupted = false;
+  try {
+    collector.run();
+  } catch (P7DumpCorruptedItemException const&) {
+    corrupted = true;
+  }
+  CHECK(corrupted);
+  CHECK(!collector.lines.empty() && collector.lines[0].text == u"text"); // Lines before the broken item are still rendered
+}
+
+static void testTruncatedDataItemHasNoLine() {
+  P7DumpBuilder dump;
+  dump.streamInfo(u"trace").description(0, 0, u"text").data(0).chunk(0).data(0).data(0).chunk(0);
+  dump.dump().resize(dump.dump().size() - 10); // Into the second data item of the last chunk
+
+  P7MemCollector collector(dump.dump().data(), dump.dump().size());
+  CHECK(collector.run()); // A dump that ends early is still reported
+  CHECK(collector.lines.size() == 2);
+}
+
+static void testFileIoAfterFailedRead() {
+  P7DumpBuilder dump;
+  dump.streamInfo(u"trace").description(0, 0, u"text").data(0).chunk(0);
+
+  auto const path = std::filesystem::temp_directory_path() / "p7d_decode.p7d";
+  std::ofstream(path, std::ios::binary).write(dump.dump().data(), dump.dump().size());
+
+  {
+    P7FileCollector io(path);
+    char            buffer[64];
+    CHECK(io.io_seek(dump.dump().size() - 16));
+    CHECK(!io.io_read(buffer, sizeof(buffer)));
+    CHECK(io.io_tell() == dump.dump().size() - 16);
+    CHECK(io.io_available() == 16);
+    CHECK(!io.io_skip(17));
+    CHECK(io.io_read(buffer, 16));
+    CHECK(io.io_available() == 0);
+  }
+
+  P7FileCollector collector(path);
+  CHECK(collector.run());
+  CHECK(collector.lines.size() == 1);
+  std::filesystem::remove(path);
+}
+
+int main() {
+  testRedefinitionKeepsFirst();
+  testStateChangesBetweenLines();
+  testChannelsRenderInChunkOrder();
+  testOverreadInWholeChunkIsCorruption();
+  testTruncatedDataItemHasNoLine();
+  testFileIoAfterFailedRead();
+  return check::result();
+}
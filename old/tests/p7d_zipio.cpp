@@ -0,0 +1,127 @@
+#include "libp7d/p7io.h"
+#include "libp7d/p7zio.h"
+#include "p7dbuild.h"
+#include "tests/check.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <zip.h>
+
+using P7ZipCollector = P7DumpZipIo<P7Collector>;
+using P7MemCollector = P7DumpMemIo<P7Collector>;
+
+// A zip with the single stored entry "log.p7d", written by hand so the test doesn't depend on libzip's writing side
+static std::vector<char> makeZip(std::vector<char> const& entry) {
+  uint32_t crc = 0xffffffff;
+  for (auto ch: entry) {
+    crc ^= (uint8_t)ch;
+    for (int i = 0; i < 8; ++i)
+      crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+  }
+  crc = ~crc;
+
+  std::string const name = "log.p7d";
+  auto const        size = (uint32_t)entry.size();
+
+  std::vector<char> zip;
+  auto              put16 = [&zip](uint16_t value) { P7DumpBuilder::put(zip, value); };
+  auto              put32 = [&zip](uint32_t value) { P7DumpBuilder::put(zip, value); };
+
+  put32(0x04034b50), put16(20), put16(0), put16(0), put16(0), put16(0x21), put32(crc), put32(size), put32(size), put16(name.size()), put16(0);
+  zip.insert(zip.end(), name.begin(), name.end());
+  zip.insert(zip.end(), entry.begin(), entry.end());
+
+  auto const directory = (uint32_t)zip.size();
+  put32(0x02014b50), put16(20), put16(20), put16(0), put16(0), put16(0), put16(0x21), put32(crc), put32(size), put32(size), put16(name.size());
+  put16(0), put16(0), put16(0), put16(0), put32(0), put32(0);
+  zip.insert(zip.end(), name.begin(), name.end());
+
+  auto const directorySize = (uint32_t)zip.size() - directory;
+  put32(0x06054b50), put16(0), put16(0), put16(1), put16(1), put32(directorySize), put32(directory), put16(0);
+  return zip;
+}
+
+// Opens the entry, calls test with it and closes everything again
+template <typename Test>
+static void withEntry(std::vector<char> const& zip, Test&& test) {
+  zip_error_t zerr;
+  zip_error_init(&zerr);
+
+  zip_source_t* source  = zip_source_buffer_create(zip.data(), zip.size(), 0, &zerr);
+  zip_t*        archive = source != nullptr ? zip_open_from_source(source, ZIP_RDONLY, &zerr) : nullptr;
+  zip_file_t*   file    = archive != nullptr ? zip_fopen_index(archive, 0, 0) : nullptr;
+  zip_error_fini(&zerr);
+
+  if (!CHECK(file != nullptr)) {
+    if (archive != nullptr) zip_discard(archive);
+    if (archive == nullptr && source != nullptr) zip_source_free(source);
+    return;
+  }
+
+  test(file);
+  zip_fclose(file);
+  zip_discard(archive);
+}
+
+static void testSeekBack() {
+  std::vector<char> entry(3 * P7D_ZIP_HISTORY / 2);
+  for (size_t i = 0; i < entry.size(); ++i)
+    entry[i] = (char)(i * 7 % 251);
+
+  auto const bytesAt = [&entry](size_t pos, char const* got, size_t size) { return std::equal(got, got + size, entry.begin() + pos); };
+
+  withEntry(makeZip(entry), [&](zip_file_t* file) {
+    P7ZipCollector    io(file, entry.size());
+    std::vector<char> buffer(P7D_ZIP_HISTORY);
+
+    CHECK(io.io_read(buffer.data(), P7D_ZIP_HISTORY / 2));
+    CHECK(io.io_seek(100)); // Within what was inflated so far
+    CHECK(io.io_read(buffer.data(), 64) && bytesAt(100, buffer.data(), 64));
+
+    CHECK(io.io_read(buffer.data(), P7D_ZIP_HISTORY)); // Partly from the history, the rest inflated
+    CHECK(bytesAt(164, buffer.data(), P7D_ZIP_HISTORY));
+    CHECK(io.io_tell() == 164 + P7D_ZIP_HISTORY);
+
+    CHECK(io.io_seek(P7D_ZIP_HISTORY - 10));
+    CHECK(io.io_skip(20));
+    CHECK(io.io_read(buffer.data(), 64) && bytesAt(P7D_ZIP_HISTORY + 10, buffer.data(), 64));
+
+    CHECK(io.io_seek(10)); // Before the history, libzip seeks in the stored entry itself
+    CHECK(io.io_read(buffer.data(), 64) && bytesAt(10, buffer.data(), 64));
+    CHECK(io.io_available() == entry.size() - 74);
+  });
+}
+
+static void testRecoveryMatchesMemory() {
+  std::vector<char> broken;
+  P7DumpBuilder::put(broken, uint32_t(5 | 8 << 10)); // Not a trace item, recovery skips the chunk
+  P7DumpBuilder::put(broken, uint32_t(0));
+
+  P7DumpBuilder dump;
+  dump.streamInfo(u"trace").description(0, 0, u"text").chunk(0);
+  for (uint32_t i = 0; i < 200; ++i) {
+    dump.data(0).data(0).data(0).data(0).chunk(0);
+    if (i % 50 == 7) dump.bytes(broken).chunk(0);
+  }
+
+  P7MemCollector memory(dump.dump().data(), dump.dump().size());
+  memory.setRecoveryMode(true);
+  CHECK(memory.run());
+  CHECK(memory.recoveredChunks() == 4 && memory.lines.size() == 800);
+
+  withEntry(makeZip(dump.dump()), [&](zip_file_t* file) {
+    P7ZipCollector zipped(file, dump.dump().size());
+    zipped.setRecoveryMode(true);
+    CHECK(zipped.run());
+    CHECK(zipped.recoveredChunks() == memory.recoveredChunks());
+    CHECK(zipped.lines.size() == memory.lines.size());
+  });
+}
+
+int main() {
+  testSeekBack();
+  testRecoveryMatchesMemory();
+  return check::result();
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "libp7d/p7d.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Writes little endian P7 dumps the way psOff's tunnel does. Items are collected until chunk() wraps them up for a channel
+
+class P7DumpBuilder {
+  public:
+  P7DumpBuilder(std::u16string_view process = u"psOff_tunnel.exe") {
+    m_dump.insert(m_dump.end(), std::begin(P7D_HDR_LE.data), std::end(P7D_HDR_LE.data));
+    put(m_dump, uint32_t(1234)), put(m_dump, uint64_t(5678));
+    fixed(m_dump, process, 0x200), fixed(m_dump, std::u16string_view(u"host"), 0x200);
+  }
+
+  P7DumpBuilder& streamInfo(std::u16string_view name) {
+    std::vector<char> payload;
+    for (uint64_t value: {1, 2, 3, 4})
+      put(payload, value);
+    fixed(payload, name, 0x80);
+    return item(0x00, payload);
+  }
+
+  P7DumpBuilder& module(uint16_t id, std::string_view name) {
+    std::vector<char> payload;
+    put(payload, id), put(payload, uint32_t(0));
+    fixed(payload, name, 54);
+    return item(0x07, payload);
+  }
+
+  // Argument-less lines only, the decoder hands vswprintf() a 16-bit wchar_t stack that isn't portable
+  P7DumpBuilder& description(uint16_t lineId, uint16_t moduleId, std::u16string_view format) {
+    std::vector<char> payload;
+    put(payload, lineId), put(payload, uint16_t(10)), put(payload, moduleId), put(payload, uint16_t(0));
+    zero(payload, format), zero(payload, std::string_view("file.cpp")), zero(payload, std::string_view("func"));
+    return item(0x01, payload);
+  }
+
+  P7DumpBuilder& data(uint16_t lineId, uint32_t thread = 1, uint64_t timer = 0) {
+    std::vector<char> payload;
+    put(payload, lineId), put(payload, uint8_t(2)), put(payload, uint8_t(0)), put(payload, thread), put(payload, m_sequence++), put(payload, timer);
+    return item(0x02, payload);
+  }
+
+  // Raw item, for the broken ones
+  P7DumpBuilder& item(uint8_t subtype, std::vector<char> const& payload) {
+    put(m_items, uint32_t(subtype << 5 | (payload.size() + 4) << 10));
+    m_items.insert(m_items.end(), payload.begin(), payload.end());
+    return *this;
+  }
+
+  // Raw bytes, for items whose header doesn't match what follows
+  P7DumpBuilder& bytes(std::vector<char> const& raw) {
+    m_items.insert(m_items.end(), raw.begin(), raw.end());
+    return *this;
+  }
+
+  P7DumpBuilder& chunk(uint8_t channel) {
+    put(m_dump, uint32_t((m_items.size() + 4) | uint32_t(channel) << 27));
+    m_dump.insert(m_dump.end(), m_items.begin(), m_items.end());
+    m_items.clear();
+    return *this;
+  }
+
+  std::vector<char>& dump() { return m_dump; }
+
+  template <typename T>
+  static void put(std::vector<char>& to, T value) {
+    auto const bytes = reinterpret_cast<char const*>(&value);
+    to.insert(to.end(), bytes, bytes + sizeof(value));
+  }
+
+  private:
+  template <typename CharT>
+  static void fixed(std::vector<char>& to, std::basic_string_view<CharT> text, size_t bytes) {
+    auto const start = to.size();
+    for (auto ch: text)
+      put(to, ch);
+    to.resize(start + bytes);
+  }
+
+  template <typename CharT>
+  static void zero(std::vector<char>& to, std::basic_string_view<CharT> text) {
+    for (auto ch: text)
+      put(to, ch);
+    put(to, CharT(0));
+  }
+
+  std::vector<char> m_dump, m_items;
+  uint32_t          m_sequence = 0;
+};
+
+// Keeps what render() got, in order
+class P7Collector: public P7Dump {
+  public:
+  struct Line {
+    std::u16string stream;
+    std::string    module;
+    std::u16string text;
+  };
+
+  bool render(StreamStorage& stream, TraceLineData const& tsd, p7string_view out) override {
+    lines.push_back({.stream = stream.info.name, .module = stream.module(tsd.modid).name, .text = p7string(out)});
+    return true;
+  }
+
+  std::string spit() const override { return {}; }
+
+  std::vector<Line> lines;
+};
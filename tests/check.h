@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdio>
+
+// Minimal checks for the test executables. A failed one is printed and the test exits with 1 once it ran through, so one run shows
+// every broken expectation instead of the first
+
+namespace check {
+inline int failures = 0;
+
+inline bool report(bool ok, char const* expr, char const* file, int line) {
+  if (!ok) {
+    ++failures;
+    fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+  }
+  return ok;
+}
+
+inline int result() { return failures == 0 ? 0 : 1; }
+} // namespace check
+
+#define CHECK(expr) check::report(static_cast<bool>(expr), #expr, __FILE__, __LINE__)
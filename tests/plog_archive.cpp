@@ -0,0 +1,122 @@
+#include "libplog/plogarc.h"
+#include "tests/check.h"
+
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Split lines with changing fields, CRLF and lines the archive keeps verbatim
+static std::vector<std::string> makeLines() {
+  std::vector<std::string> lines = {"0;main;I;2024-01-01 00:00:00.000;1;1;;;child process"};
+  for (int i = 0; i < 5000; ++i) {
+    auto const time = "10:" + std::to_string(10 + i / 1000 % 50) + ":" + std::to_string(10 + i / 20 % 50) + "." + std::to_string(100 + i % 900);
+    lines.push_back("0;" + std::string(i % 3 ? "core" : "runtime") + ";I;" + time + ";" + std::to_string(i % 4) + ";" + std::to_string(i % 7 + 1) +
+                    ";file.cpp;func;line " + std::to_string(i) + (i % 11 == 0 ? "\r" : ""));
+    if (i % 97 == 0) lines.push_back("continuation of line " + std::to_string(i));
+    if (i % 389 == 0) lines.push_back("0;core;I;10:00:00.000;007;1;file.cpp;func;leading zeros don't survive the split");
+  }
+  lines.push_back("0;ExceptionHandler;E;10:59:59.999;1;2;file.cpp;func;Faulty instruction: 0x1234");
+  return lines;
+}
+
+static std::string archive(std::vector<std::string> const& lines, uint32_t blockLines) {
+  std::ostringstream out(std::ios::binary);
+  PLogArchiveWriter  writer(out, blockLines);
+  for (auto const& line: lines)
+    writer.write(line);
+  CHECK(writer.finish());
+  return out.str();
+}
+
+static std::string join(std::vector<std::string> const& lines) {
+  std::string text;
+  for (auto const& line: lines)
+    text.append(line).push_back('\n');
+  return text;
+}
+
+static void testRoundTrip() {
+  auto const lines = makeLines();
+  std::istringstream in(archive(lines, 512), std::ios::binary);
+
+  PLogArchiveReader reader(in);
+  if (!CHECK(reader.valid() && reader.blocks().size() > 1)) return;
+
+  PLogAnalyzer::LineInfo info;
+  std::string_view       out;
+  bool                   parsed;
+  size_t                 count = 0;
+  while (reader.next(info, out, parsed)) {
+    if (!CHECK(count < lines.size())) return;
+    CHECK(reader.line() == lines[count]);
+    CHECK(reader.lineSize() == lines[count].size());
+    ++count;
+  }
+  CHECK(count == lines.size());
+
+  std::string text;
+  for (uint64_t number: {uint64_t(4000), uint64_t(3), uint64_t(lines.size() - 1), uint64_t(1500)}) // Back and forth across blocks
+    CHECK(reader.readLine(number, text) && text == lines[number]);
+  CHECK(!reader.readLine(lines.size(), text));
+}
+
+static void testReportMatchesText() {
+  auto const lines = makeLines();
+  auto const text  = join(lines);
+
+  std::istringstream in(archive(lines, 512), std::ios::binary);
+  auto               fromArchive = createArchiveAnalyser(in);
+  auto               fromText    = createMemAnalyser(text.data(), text.size());
+  CHECK(fromArchive->spit() == fromText->spit());
+}
+
+template <typename T>
+static void put(std::string& bytes, size_t offset, T value) {
+  std::memcpy(bytes.data() + offset, &value, sizeof(T));
+}
+
+static bool opens(std::string const& bytes) {
+  std::istringstream in(bytes, std::ios::binary);
+  PLogArchiveReader  reader(in);
+  return reader.valid();
+}
+
+static void testCorruptSizesAreRejected() {
+  auto const good = archive(makeLines(), 512);
+  CHECK(opens(good));
+
+  auto const footer      = good.size() - 16;
+  uint64_t   indexOffset = 0;
+  std::memcpy(&indexOffset, good.data() + footer, sizeof(indexOffset));
+
+  auto blockCount = good;
+  put(blockCount, footer + 8, uint32_t(0x7fffffff));
+  CHECK(!opens(blockCount));
+
+  auto index = good;
+  put(index, footer, uint64_t(good.size()));
+  CHECK(!opens(index));
+
+  auto offset = good; // Second block, (offset, firstLine, lines, rawSize, compressedSize) takes 28 bytes
+  put(offset, indexOffset + 28, uint64_t(1) << 40);
+  CHECK(!opens(offset));
+
+  auto rawSize = good;
+  put(rawSize, indexOffset + 20, uint32_t(0xffffffff));
+  CHECK(!opens(rawSize));
+
+  auto compressedSize = good;
+  put(compressedSize, indexOffset + 24, uint32_t(0xffffffff));
+  CHECK(!opens(compressedSize));
+
+  CHECK(!opens(good.substr(0, good.size() - 1)));
+  CHECK(!opens(good.substr(0, 10)));
+}
+
+int main() {
+  testRoundTrip();
+  testReportMatchesText();
+  testCorruptSizesAreRejected();
+  return check::result();
+}
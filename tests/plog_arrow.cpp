@@ -0,0 +1,138 @@
+#include "libplog/ploga.h"
+#include "libplog/plogarrow.h"
+#include "tests/check.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Split lines, lines that don't split and the Kernel line after which the analysis reads no more
+static std::string makeLog() {
+  std::string log = "0;main;I;2024-01-01 00:00:00.000;1;1;;;child process\n";
+  for (int i = 0; i < 3000; ++i) {
+    log += "0;" + std::string(i % 3 ? "core" : "runtime") + ";I;10:00:00." + std::to_string(100 + i % 900) + ";1;" + std::to_string(i % 7 + 1) +
+           ";file" + std::to_string(i % 5) + ".cpp;func;line " + std::to_string(i) + (i % 11 == 0 ? "\r\n" : "\n");
+    if (i % 97 == 0) log += "continuation of line " + std::to_string(i) + "\n";
+    if (i == 2000) log += "0;Kernel;I;10:00:00.000;1;1;file.cpp;func;-> client shutdown request\n";
+  }
+  return log;
+}
+
+static std::string exportText(std::string const& log, uint32_t groupLines) {
+  std::ostringstream out(std::ios::binary);
+  PLogArrowWriter    writer(out, groupLines);
+  std::istringstream in(log, std::ios::binary);
+  for (std::string line; std::getline(in, line);)
+    writer.write(line);
+  CHECK(writer.finish());
+  return out.str();
+}
+
+// Just enough of a FlatBuffers reader to walk the messages back
+struct FbTable {
+  std::string const& buf;
+  size_t             pos;
+
+  template <typename T>
+  T get(size_t at) const {
+    T value;
+    std::memcpy(&value, buf.data() + at, sizeof(T));
+    return value;
+  }
+
+  size_t field(uint16_t slot) const {
+    auto const vtable = pos - get<int32_t>(pos);
+    if (4 + 2 * slot >= get<uint16_t>(vtable)) return 0;
+    auto const offset = get<uint16_t>(vtable + 4 + 2 * slot);
+    return offset != 0 ? pos + offset : 0;
+  }
+
+  template <typename T>
+  T scalar(uint16_t slot) const {
+    auto const at = field(slot);
+    return at != 0 ? get<T>(at) : T();
+  }
+
+  FbTable table(uint16_t slot) const {
+    auto const at = field(slot);
+    return {buf, at + get<uint32_t>(at)};
+  }
+};
+
+struct Messages {
+  uint64_t dictionaries = 0;
+  uint64_t batches      = 0;
+  uint64_t rows         = 0; // Of the record batches
+  bool     valid        = false;
+};
+
+static uint32_t get32(std::string const& bytes, size_t at) {
+  uint32_t value;
+  std::memcpy(&value, bytes.data() + at, sizeof(value));
+  return value;
+}
+
+static Messages walk(std::string const& stream) {
+  Messages result;
+  size_t   pos    = 0;
+  bool     schema = false;
+  while (pos + 8 <= stream.size() && get32(stream, pos) == 0xffffffff) {
+    auto const size = get32(stream, pos + 4);
+    pos += 8;
+    if (size == 0) {
+      result.valid = schema && pos == stream.size();
+      break;
+    }
+    if (size % 8 != 0 || pos + size > stream.size()) break;
+
+    std::string const metadata = stream.substr(pos, size);
+    FbTable const     message  = {metadata, get32(metadata, 0)};
+    auto const        type     = message.scalar<uint8_t>(1);
+    if (type == 1)
+      schema = true;
+    else if (type == 2)
+      ++result.dictionaries;
+    else if (type == 3) {
+      ++result.batches;
+      result.rows += message.table(2).scalar<uint64_t>(0);
+    }
+    pos += size + message.scalar<uint64_t>(3);
+  }
+  return result;
+}
+
+static void testStreamFraming() {
+  auto const log    = makeLog();
+  auto const stream = exportText(log, 500);
+  auto const walked = walk(stream);
+
+  auto const lines = (uint64_t)std::count(log.begin(), log.end(), '\n');
+  CHECK(walked.valid);
+  CHECK(walked.rows == lines);
+  CHECK(walked.batches == (lines + 499) / 500);
+  CHECK(walked.dictionaries == 6); // Every dictionary goes out with the first group, the Kernel line adds a module and a source as deltas
+}
+
+// The analysis feeds the export the lines it splits, to the end of the log even when it stops caring before that
+static void testTapExportsLikeText() {
+  auto const log = makeLog();
+
+  std::ostringstream out(std::ios::binary);
+  PLogArrowWriter    writer(out, 500);
+  PLogAnalyzer       analyser;
+  std::istringstream in(log, std::ios::binary);
+  analyser.setTap([&writer](std::string_view line, PLogAnalyzer::LineInfo const& info, std::string_view message) { writer.write(line, info, message); });
+  analyser.readstream(in);
+  CHECK(writer.finish());
+
+  CHECK(out.str() == exportText(log, 500));
+  CHECK(analyser.spit() == createMemAnalyser(log.data(), log.size())->spit());
+}
+
+int main() {
+  testStreamFraming();
+  testTapExportsLikeText();
+  return check::result();
+}
@@ -0,0 +1,83 @@
+#include "libplog/ploga.h"
+#include "tests/check.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+// Every allocation carries its size in front of it, so the bytes alive and their peak can be followed
+namespace {
+constexpr size_t Header = alignof(std::max_align_t);
+
+std::atomic<size_t> g_live = 0;
+std::atomic<size_t> g_peak = 0;
+} // namespace
+
+void* operator new(size_t size) {
+  auto const block = (char*)std::malloc(size + Header);
+  if (block == nullptr) throw std::bad_alloc();
+  *(size_t*)block = size;
+
+  auto const live = g_live += size;
+  for (auto peak = g_peak.load(); live > peak && !g_peak.compare_exchange_weak(peak, live);)
+    ;
+  return block + Header;
+}
+
+void operator delete(void* ptr) noexcept {
+  if (ptr == nullptr) return;
+  auto const block = (char*)ptr - Header;
+  g_live -= *(size_t*)block;
+  std::free(block);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  operator delete(ptr);
+}
+
+// Firmware names, templates and long lines, everything that grows with the log
+static std::string makeLog() {
+  std::string log = "0;main;I;2024-01-01 00:00:00.000;1;1;;;child process\n";
+  for (int i = 0; i < 50000; ++i) {
+    auto const name = std::string(80, char('a' + i % 26)) + std::to_string(i);
+    log += "0;elf_loader;I;10:00:00.000;1;2;file.cpp;func;load library[" + std::to_string(i) + "]: /system/" + name + ".sprx\n";
+    log += "0;core;I;10:00:00.000;1;2;file.cpp;func;" + std::string(i % 40 + 1, 'w') + (i % 48 ? " word" : "") + "\n";
+    if (i % 1000 == 0) log += "0;core;I;10:00:00.000;1;2;file.cpp;func;" + std::string(200000, 'x') + "\n";
+  }
+  return log;
+}
+
+// Peak of the bytes the analysers hold, n of them alive at once as for a joint report
+static size_t peakOf(std::string const& log, PLogOptions const& options, size_t n) {
+  std::vector<std::unique_ptr<PLogAnalyzer>> analysers;
+  analysers.reserve(n);
+
+  auto const before = g_live.load();
+  g_peak            = before;
+  for (size_t i = 0; i < n; ++i)
+    analysers.push_back(createMemAnalyser(log.data(), log.size(), options));
+  return g_peak - before;
+}
+
+// A joint report keeps an analyser per log alive. Each of them stays within its own budget, so only sharing it keeps the sum within it
+static void testSharedBudgetHolds() {
+  auto const log = makeLog();
+
+  PLogOptions options;
+  options.templates    = true;
+  options.memoryBudget = 64 * 1024 * 1024;
+
+  auto const full   = peakOf(log, options, 32);
+  auto const shared = peakOf(log, options.share(32), 32);
+  CHECK(full > options.memoryBudget); // Or the test proves nothing
+  CHECK(shared <= options.memoryBudget);
+}
+
+int main() {
+  testSharedBudgetHolds();
+  return check::result();
+}
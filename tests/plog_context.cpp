@@ -0,0 +1,68 @@
+#include "libplog/ploga.h"
+#include "libplog/plogctx.h"
+#include "tests/check.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Lines of 1000 bytes and a bit, some of them cross the end of the 64 KiB window
+static void testWrappedLinesResolve() {
+  PLogContext              context;
+  std::vector<std::string> lines;
+  uint64_t                 offset = 0;
+  for (size_t i = 0; i < 200; ++i) {
+    lines.emplace_back(1000 + i, char('a' + i % 26));
+    context.push(offset, lines.back(), 1);
+    offset += lines.back().size() + 1;
+  }
+
+  auto const snapshot = context.snapshot(1);
+  auto const overall  = snapshot["overall"];
+  if (!CHECK(overall.size() == PLogContext::OverallLines)) return;
+
+  bool wrapped = false;
+  for (auto const& item: overall) {
+    auto const line  = item["line"].get<uint64_t>();
+    auto const start = item["offset"].get<uint64_t>() % PLogContext::WindowSize;
+    wrapped |= start + lines[line - 1].size() > PLogContext::WindowSize;
+    CHECK(item["text"].get<std::string>() == lines[line - 1]);
+  }
+  CHECK(wrapped);
+
+  for (auto const& item: snapshot["thread_lines"])
+    CHECK(item["text"].get<std::string>() == lines[item["line"].get<uint64_t>() - 1]);
+}
+
+// Offsets of a CRLF log read from a file are the ones of the file, as for the same log in memory
+static void testCrashContextOffsets() {
+  std::string log = "0;main;I;2024-01-01 00:00:00.000;1;1;;;child process\r\n";
+  for (int i = 0; i < 40; ++i)
+    log += "0;core;I;10:00:00.000;1;2;file.cpp;func;line " + std::to_string(i) + "\r\n";
+  log += "0;ExceptionHandler;E;10:00:01.000;1;2;file.cpp;func;Faulty instruction: 0x1234\r\n";
+
+  auto const path = std::filesystem::temp_directory_path() / "plog_context.plog";
+  std::ofstream(path, std::ios::binary) << log;
+
+  auto fromFile   = createFileAnalyser(path);
+  auto fromMemory = createMemAnalyser(log.data(), log.size());
+  std::filesystem::remove(path);
+
+  auto const& context = fromFile->info()["crash_context"];
+  if (!CHECK(!context.is_null() && !context["overall"].empty())) return;
+  CHECK(context == fromMemory->info()["crash_context"]);
+
+  for (auto const& item: context["overall"]) {
+    auto const text = item["text"].get<std::string>();
+    CHECK(log.compare(item["offset"].get<uint64_t>(), text.size(), text) == 0);
+  }
+}
+
+int main() {
+  testWrappedLinesResolve();
+  testCrashContextOffsets();
+  return check::result();
+}
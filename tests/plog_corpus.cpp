@@ -0,0 +1,67 @@
+#include "libplog/plogcorpus.h"
+#include "tests/check.h"
+
+#include <string>
+
+static nlohmann::json makeReport(std::initializer_list<std::string> firmware, bool failing = false) {
+  nlohmann::json report = {{"type", "game"}, {"labels", nlohmann::json::array()}, {"firmware", firmware}};
+  if (failing) report["labels"].push_back("exception");
+  return report;
+}
+
+// Thousands of names seen once, a few seen in many logs: the top list has the frequent ones whatever their hashes
+static void testTopIsMostCommon() {
+  PLogCorpus corpus;
+  for (int i = 0; i < 5000; ++i)
+    corpus.add(makeReport({"rare" + std::to_string(i) + ".sprx", "common" + std::to_string(i % 5) + ".sprx"}, i % 10 == 0));
+
+  auto const top = corpus.report()["firmware"]["top"];
+  if (!CHECK(top.size() == 50)) return;
+  for (size_t i = 0; i < 5; ++i) {
+    CHECK(top[i]["name"].get<std::string>().starts_with("common"));
+    CHECK(top[i]["logs"].get<uint64_t>() >= 1000);
+  }
+}
+
+static void testShardsMergeAlike() {
+  PLogCorpus whole, first, second;
+  for (int i = 0; i < 3000; ++i) {
+    auto const report = makeReport({"name" + std::to_string(i % 1500) + ".sprx", i < 1500 ? "early.sprx" : "late.sprx"}, i % 7 == 0);
+    whole.add(report);
+    (i < 1500 ? first : second).add(report);
+  }
+
+  PLogCorpus forward = first, backward = second;
+  forward.merge(second);
+  backward.merge(first);
+  CHECK(forward.report() == backward.report());
+  CHECK(forward.report()["logs"] == whole.report()["logs"]);
+
+  auto const firmware = forward.report()["firmware"];
+  auto const top      = firmware["top"];
+  auto const bound    = firmware["error_bound"].get<uint64_t>();
+  if (!CHECK(top.size() == 50)) return;
+  for (size_t i = 0; i < 2; ++i) { // Estimates never undercount
+    auto const logs = top[i]["logs"].get<uint64_t>();
+    CHECK(top[i]["name"] == "early.sprx" || top[i]["name"] == "late.sprx");
+    CHECK(logs >= 1500 && logs <= 1500 + bound);
+  }
+  CHECK(top[0]["name"] != top[1]["name"]);
+
+  PLogCorpus loaded;
+  CHECK(loaded.load(forward.save()) && loaded.report() == forward.report());
+}
+
+static void testOtherJsonIsNoShard() {
+  PLogCorpus corpus;
+  CHECK(!corpus.load(nlohmann::json::parse(R"({"traceEvents": []})")));
+  CHECK(!corpus.load(nlohmann::json::parse(R"({"plog_corpus": "1"})")));
+  CHECK(!corpus.load(nlohmann::json::parse("[1, 2]")));
+}
+
+int main() {
+  testTopIsMostCommon();
+  testShardsMergeAlike();
+  testOtherJsonIsNoShard();
+  return check::result();
+}
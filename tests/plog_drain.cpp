@@ -0,0 +1,43 @@
+#include "libplog/plogdrain.h"
+#include "tests/check.h"
+
+#include <string>
+#include <string_view>
+
+static std::string asIs(std::string_view text) {
+  return std::string(text);
+}
+
+static void testVariableTokensBecomeWildcards() {
+  PLogDrain<char> drain;
+  for (int i = 0; i < 10; ++i)
+    drain.add("fs", "open file " + std::to_string(i) + " mode read", i);
+  drain.add("fs", "open file 7 mode write", 10);
+
+  auto const report = drain.dump(5, asIs);
+  CHECK(report["total"] == 11 && report["distinct"] == 1);
+  if (!CHECK(report["modules"]["fs"].size() == 1)) return;
+  CHECK(report["modules"]["fs"][0]["template"] == "open file <*> mode <*>");
+  CHECK(report["modules"]["fs"][0]["count"] == 11 && report["modules"]["fs"][0]["first"] == 0);
+}
+
+// A module logging many shapes a lot must not hide the templates of the quiet ones
+static void testRankedPerModule() {
+  PLogDrain<char> drain;
+  char const*     shapes[] = {"alpha", "beta", "gamma", "delta", "epsilon"};
+  for (int i = 0; i < 1000; ++i)
+    drain.add("chatty", std::string(shapes[i % 5]) + " happened here", i);
+  drain.add("quiet", "rare event", 1000);
+
+  auto const report = drain.dump(2, asIs);
+  CHECK(report["distinct"] == 6);
+  CHECK(report["modules"]["chatty"].size() == 2);
+  if (!CHECK(report["modules"]["quiet"].size() == 1)) return;
+  CHECK(report["modules"]["quiet"][0]["template"] == "rare event" && report["modules"]["quiet"][0]["count"] == 1);
+}
+
+int main() {
+  testVariableTokensBecomeWildcards();
+  testRankedPerModule();
+  return check::result();
+}
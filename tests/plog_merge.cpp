@@ -0,0 +1,101 @@
+#include "libplog/plogmerge.h"
+#include "tests/check.h"
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+static std::vector<std::string> merge(std::vector<std::string> const& logs) {
+  std::vector<std::istringstream> streams(logs.begin(), logs.end());
+  std::vector<std::istream*>      inputs;
+  for (auto& stream: streams)
+    inputs.push_back(&stream);
+
+  PLogMerger               merger(inputs);
+  std::vector<std::string> lines;
+  size_t                   source;
+  std::string_view         line;
+  while (merger.next(source, line))
+    lines.emplace_back(std::to_string(source) + ":" + std::string(line));
+  return lines;
+}
+
+static void testTimeOrder() {
+  auto const lines = merge({
+      "0;core;I;2024-01-01 10:00:00.100;a\n0;core;I;2024-01-01 10:00:00.300;c\n",
+      "0;core;I;2024-01-01 10:00:00.200;b\n0;core;I;2024-01-01 10:00:00.400;d\n",
+  });
+  CHECK(lines == std::vector<std::string>({
+                     "0:0;core;I;2024-01-01 10:00:00.100;a",
+                     "1:0;core;I;2024-01-01 10:00:00.200;b",
+                     "0:0;core;I;2024-01-01 10:00:00.300;c",
+                     "1:0;core;I;2024-01-01 10:00:00.400;d",
+                 }));
+}
+
+static void testEqualTimesKeepInputOrder() {
+  auto const lines = merge({
+      "0;core;I;10:00:00.100;b\n",
+      "0;core;I;10:00:00.100;a\n",
+  });
+  CHECK(lines == std::vector<std::string>({"0:0;core;I;10:00:00.100;b", "1:0;core;I;10:00:00.100;a"}));
+}
+
+static void testContinuationStaysWithItsLine() {
+  // The second input's line has the same time and a lower input index would win the tie against the continuation
+  auto const lines = merge({
+      "0;core;I;10:00:00.100;first\n0;core;I;10:00:00.100;second\n",
+      "0;core;I;10:00:00.100;wrapped\n  continued\n  and more\n0;core;I;10:00:00.200;after\n",
+  });
+  CHECK(lines == std::vector<std::string>({
+                     "0:0;core;I;10:00:00.100;first",
+                     "0:0;core;I;10:00:00.100;second",
+                     "1:0;core;I;10:00:00.100;wrapped",
+                     "1:  continued",
+                     "1:  and more",
+                     "1:0;core;I;10:00:00.200;after",
+                 }));
+
+  auto const interleaved = merge({
+      "0;core;I;10:00:00.100;parent\n  child\n0;core;I;10:00:00.300;late\n",
+      "0;core;I;10:00:00.100;other\n",
+  });
+  CHECK(interleaved == std::vector<std::string>({
+                           "0:0;core;I;10:00:00.100;parent",
+                           "0:  child",
+                           "1:0;core;I;10:00:00.100;other",
+                           "0:0;core;I;10:00:00.300;late",
+                       }));
+}
+
+// Every process report passes the hook with the index of its own analyser, for evidence links into the right log
+static void testJointLinksEveryProcess() {
+  std::string const child = "0;main;I;2024-01-01 00:00:00.000;1;1;;;child process\n"
+                            "0;ExceptionHandler;E;10:00:01.000;1;2;file.cpp;func;Faulty instruction: 0x1234\n";
+  std::string const main  = "0;main;I;2024-01-01 00:00:00.000;1;1;;;main process\n";
+
+  std::vector<std::unique_ptr<PLogAnalyzer>> analysers;
+  analysers.push_back(createMemAnalyser(main.data(), main.size()));
+  analysers.push_back(nullptr); // An entry that failed to open
+  analysers.push_back(createMemAnalyser(child.data(), child.size()));
+
+  std::vector<size_t> linked;
+  auto const          joint = nlohmann::json::parse(spitJoint(analysers, [&linked](size_t i, nlohmann::json& process) {
+    linked.push_back(i);
+    process["entry"] = i;
+  }));
+
+  CHECK((linked == std::vector<size_t> {0, 2}));
+  if (!CHECK(joint["processes"].size() == 2)) return;
+  CHECK(joint["processes"][0]["entry"] == 0 && joint["processes"][1]["entry"] == 2);
+}
+
+int main() {
+  testTimeOrder();
+  testEqualTimesKeepInputOrder();
+  testContinuationStaysWithItsLine();
+  testJointLinksEveryProcess();
+  return check::result();
+}
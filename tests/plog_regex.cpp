@@ -0,0 +1,169 @@
+#include "libplog/plogregex.h"
+#include "tests/check.h"
+
+#include <cstdio>
+#include <random>
+#include <regex>
+#include <string>
+
+// Random patterns of the supported subset, checked against std::regex (ECMAScript, which agrees with it on all of them) over random texts.
+// The texts have no line breaks, '.' of ECMAScript doesn't match those
+class PatternMaker {
+  public:
+  PatternMaker(uint32_t seed): m_random(seed) {}
+
+  std::string pattern() {
+    m_groups = 0;
+    return alternation(0);
+  }
+
+  // Literal alternatives only, the prefilter answers those on its own
+  std::string literals() {
+    std::string result;
+    for (int i = pick(3); i >= 0; --i) {
+      if (!result.empty()) result.push_back('|');
+      for (int n = pick(3); n >= 0; --n)
+        result.push_back("abc- "[pick(4)]);
+    }
+    return result;
+  }
+
+  // Wide code units are '\x7f' for std::regex, which nothing but '.' and the negated classes match there either
+  std::string text() {
+    std::string result;
+    for (int n = pick(12); n > 0; --n)
+      result.push_back("abc-1 ._x\x7f"[pick(9)]);
+    return result;
+  }
+
+  private:
+  int pick(int max) { return std::uniform_int_distribution<int>(0, max)(m_random); }
+
+  std::string alternation(int depth) {
+    auto result = concatenation(depth);
+    for (int i = pick(depth < 2 ? 2 : 0); i > 0; --i)
+      result += "|" + concatenation(depth);
+    return result;
+  }
+
+  std::string concatenation(int depth) {
+    std::string result;
+    for (int i = pick(3); i >= 0; --i)
+      result += piece(depth);
+    return result;
+  }
+
+  std::string piece(int depth) {
+    switch (pick(9)) {
+      case 0: return pick(1) ? "^" : "$"; // ECMAScript doesn't repeat assertions
+      case 1: return atom(depth);
+      default: {
+        auto result = atom(depth);
+        return result + repeat(result.front() == '(');
+      }
+    }
+  }
+
+  // Groups only get bounded repeats, std::regex backtracks and nested stars take it exponential time
+  std::string repeat(bool group) {
+    switch (pick(9)) {
+      case 0: return "?";
+      case 1: return group ? "{2}" : "*";
+      case 2: return group ? "{1,2}" : "+";
+      case 3: return "{" + std::to_string(pick(3)) + "}";
+      case 4: return group ? "?" : "{" + std::to_string(pick(3)) + ",}";
+      case 5: {
+        auto const min = pick(2);
+        return "{" + std::to_string(min) + "," + std::to_string(min + pick(2)) + "}";
+      }
+      default: return "";
+    }
+  }
+
+  std::string atom(int depth) {
+    static const char* const escapes[] = {"\\d", "\\D", "\\w", "\\W", "\\s", "\\S", "\\.", "\\-"};
+    static const char* const classes[] = {"[ab]", "[^a]", "[a-c]", "[^a-c1]", "[\\d-]", "[^\\s]", "[.x]", "[-a]"};
+
+    switch (pick(depth < 2 && m_groups < 4 ? 7 : 5)) {
+      case 0: return ".";
+      case 1: return escapes[pick(7)];
+      case 2: return classes[pick(7)];
+      case 6:
+      case 7: ++m_groups; return (pick(1) ? "(" : "(?:") + alternation(depth + 1) + ")";
+      default: return std::string(1, "abc- 1x"[pick(6)]);
+    }
+  }
+
+  std::mt19937 m_random;
+  int          m_groups = 0;
+};
+
+static std::u16string widen(std::string const& text) {
+  std::u16string result;
+  for (auto ch: text)
+    result.push_back(ch == '\x7f' ? u'一' : (char16_t)ch);
+  return result;
+}
+
+// Returns false on the first disagreement, after telling what it was
+static bool agrees(std::string const& pattern, std::vector<std::string> const& texts) {
+  std::regex const    reference(pattern, std::regex::ECMAScript);
+  PLogRegex<char>     cached(pattern);
+  PLogRegex<char>     flushing(pattern, 2); // A state cache that's always full, every few characters it's dropped and refilled
+  PLogRegex<char16_t> wide(pattern);
+
+  for (auto const& text: texts) {
+    bool const expected = std::regex_search(text, reference);
+    if (!CHECK(cached.search(text) == expected) || !CHECK(flushing.search(text) == expected) || !CHECK(wide.search(widen(text)) == expected)) {
+      fprintf(stderr, "  pattern \"%s\" on \"%s\", std::regex says %d\n", pattern.c_str(), text.c_str(), expected);
+      return false;
+    }
+  }
+  return true;
+}
+
+static void testMatchesStdRegex() {
+  PatternMaker maker(20240101);
+  for (int i = 0; i < 3000; ++i) {
+    auto const pattern = i % 10 == 0 ? maker.literals() : maker.pattern();
+
+    std::vector<std::string> texts = {""};
+    for (int t = 0; t < 30; ++t)
+      texts.push_back(maker.text());
+
+    if (!agrees(pattern, texts)) return;
+  }
+}
+
+// Long texts go through many more DFA states than the tiny cache holds, the flushes happen mid-text
+static void testFlushMidText() {
+  std::string text;
+  for (int i = 0; i < 2000; ++i)
+    text += "ab-c"[i * 7 % 4];
+
+  for (auto const* pattern: {"a.{5}b$", "(a|b)[^c]{3,6}c-a", "^(?:[ab-]|c)+$", "-c.?c{2}"}) {
+    std::regex const reference(pattern, std::regex::ECMAScript);
+    PLogRegex<char>  flushing(pattern, 2);
+    CHECK(flushing.search(text) == std::regex_search(text, reference));
+    CHECK(flushing.search(text + "ccc") == std::regex_search(text + "ccc", reference));
+  }
+}
+
+static void testMalformedPatternsThrow() {
+  for (auto const* pattern: {"(a", "a)", "[ab", "*a", "a{2", "a{3,1}", "[b-a]", "\\q", "a{1001}", "a\\"}) {
+    bool thrown = false;
+    try {
+      PLogRegex<char> regex(pattern);
+    } catch (std::invalid_argument const&) {
+      thrown = true;
+    }
+    if (!CHECK(thrown)) fprintf(stderr, "  pattern \"%s\"\n", pattern);
+  }
+}
+
+int main() {
+  testMatchesStdRegex();
+  testFlushMidText();
+  testMalformedPatternsThrow();
+  return check::result();
+}
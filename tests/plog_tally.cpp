@@ -0,0 +1,112 @@
+#include "libplog/plogtally.h"
+#include "tests/check.h"
+
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using Tally = PLogTally<char, 16>;
+
+static std::string asIs(std::string_view key) {
+  return std::string(key);
+}
+
+// Zipf-like stream over more names than the tally has slots
+static std::vector<std::string> makeStream(size_t names, size_t length) {
+  std::vector<double> weights;
+  for (size_t i = 0; i < names; ++i)
+    weights.push_back(1.0 / double(i + 1));
+
+  std::mt19937                       rng(42);
+  std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+
+  std::vector<std::string> stream;
+  for (size_t i = 0; i < length; ++i)
+    stream.push_back("name" + std::to_string(pick(rng)));
+  return stream;
+}
+
+static void testExactBelowCapacity() {
+  Tally tally;
+  for (size_t i = 0; i < 100; ++i)
+    tally.add("key" + std::to_string(i % 10), i);
+
+  auto const report = tally.dump(3, asIs);
+  CHECK(report["exact"] == true && report["total"] == 100 && report["distinct"] == 10);
+  for (auto const& item: report["top"])
+    CHECK(item["count"] == 10 && item["error"] == 0);
+  CHECK(report["top"][0]["first"] == 0);
+}
+
+static void testEvictionKeepsHeavyHitters() {
+  auto const stream = makeStream(200, 20000);
+
+  Tally                           tally;
+  std::map<std::string, uint64_t> truth;
+  for (size_t i = 0; i < stream.size(); ++i) {
+    tally.add(stream[i], i);
+    ++truth[stream[i]];
+  }
+
+  auto const report = tally.dump(5, asIs);
+  CHECK(report["exact"] == false && report["total"] == stream.size() && report["distinct"] == 16);
+  if (!CHECK(report["top"].size() == 5)) return;
+
+  // Space-Saving bounds: count - error <= real count <= count
+  for (auto const& item: report["top"]) {
+    auto const real = truth[item["name"].get<std::string>()];
+    CHECK(item["count"].get<uint64_t>() >= real);
+    CHECK(item["count"].get<uint64_t>() - item["error"].get<uint64_t>() <= real);
+  }
+  CHECK(report["top"][0]["name"] == "name0");
+}
+
+static void testCheckpointGoesOnAlike() {
+  auto const stream = makeStream(100, 10000);
+
+  Tally whole, resumed;
+  for (size_t i = 0; i < stream.size(); ++i) {
+    whole.add(stream[i], i);
+    if (i == stream.size() / 2) {
+      Tally loaded;
+      CHECK(loaded.load(resumed.save()));
+      resumed = loaded;
+    }
+    resumed.add(stream[i], i);
+  }
+
+  CHECK(whole.dump(16, asIs) == resumed.dump(16, asIs));
+  CHECK(whole.save() == resumed.save());
+}
+
+static void testCorruptCheckpointIsRejected() {
+  Tally tally;
+  for (auto key: {"a", "b", "b", "c", "c", "c"})
+    tally.add(key, 0);
+
+  auto state     = tally.save();
+  auto reordered = state;
+  std::swap(reordered["order"][0], reordered["order"][2]); // Counts have to grow along the order
+  CHECK(!Tally().load(reordered));
+
+  auto duplicated        = state;
+  duplicated["order"][1] = duplicated["order"][0];
+  CHECK(!Tally().load(duplicated));
+
+  auto truncated = state;
+  truncated["slots"][0][4] = 100; // Longer than the arena
+  CHECK(!Tally().load(truncated));
+
+  CHECK(Tally().load(state));
+}
+
+int main() {
+  testExactBelowCapacity();
+  testEvictionKeepsHeavyHitters();
+  testCheckpointGoesOnAlike();
+  testCorruptCheckpointIsRejected();
+  return check::result();
+}
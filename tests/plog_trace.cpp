@@ -0,0 +1,89 @@
+#include "libplog/plogtrace.h"
+#include "tests/check.h"
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+static std::string stamp(int64_t micros) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%02d:%02d:%02d.%06d", int(micros / 3600'000'000), int(micros / 60'000'000 % 60), int(micros / 1'000'000 % 60),
+           int(micros % 1'000'000));
+  return buf;
+}
+
+static std::string line(int64_t micros, uint32_t tid, std::string_view module, std::string_view message) {
+  return "0;" + std::string(module) + ";I;" + stamp(micros) + ";1;" + std::to_string(tid) + ";file.cpp;func;" + std::string(message);
+}
+
+struct Traced {
+  nlohmann::json report;
+  uint64_t       bytesIn;
+  uint64_t       bytesOut;
+  int64_t        binMicros;
+};
+
+static Traced trace(std::string const& log) {
+  std::ostringstream out(std::ios::binary);
+  PLogTraceWriter    writer(out);
+  std::istringstream in(log, std::ios::binary);
+  for (std::string text; std::getline(in, text);)
+    writer.write(text);
+  CHECK(writer.finish());
+  return {nlohmann::json::parse(out.str()), writer.bytesIn(), writer.bytesOut(), writer.binMicros()};
+}
+
+// Eight threads that log apart from each other, every one every other bin: a slice per line would be bigger than the log
+static std::string makeLog(int64_t step) {
+  std::string log = line(0, 1, "main", "child process") + "\n";
+  for (int64_t i = 0; i < 8 * 8000; ++i)
+    log += line(i / 8 * step + i % 8 * 100, uint32_t(i % 8 + 2), "core", "thread keeps telling what it does " + std::to_string(i)) + "\n";
+  return log;
+}
+
+static void testSparseThreadsGrowTheBin() {
+  auto const sparse = trace(makeLog(2 * PLogTraceWriter::DefaultBinMicros));
+  CHECK(sparse.bytesOut * 2 < sparse.bytesIn);
+  CHECK(sparse.binMicros > PLogTraceWriter::DefaultBinMicros && sparse.binMicros <= PLogTraceWriter::MaxBinMicros);
+  CHECK(sparse.report["otherData"]["bin_us"] == sparse.binMicros);
+
+  auto const dense = trace(makeLog(PLogTraceWriter::DefaultBinMicros / 10)); // Bursts are one slice as they are
+  CHECK(dense.binMicros == PLogTraceWriter::DefaultBinMicros);
+  CHECK(dense.bytesOut * 4 < dense.bytesIn);
+}
+
+static size_t count(nlohmann::json const& report, std::string_view name) {
+  size_t result = 0;
+  for (auto const& event: report["traceEvents"])
+    if (event["ph"] == "i" && event["name"] == name) result += event["args"]["count"].get<size_t>();
+  return result;
+}
+
+// Markers on the lines the rules take as problems, and on no others
+static void testMarkersMatchTheRules() {
+  std::string child = line(0, 1, "main", "child process") + "\n";
+  child += line(100, 2, "ExceptionHandler", "Exception occured, info:") + "\n";
+  child += line(200, 2, "ExceptionHandler", "Faulty instruction: 0x1234") + "\n";
+  child += line(300, 2, "runtime", "Missing Symbol|sceKernelFoo") + "\n";
+  child += line(400, 2, "core", "Missing Symbol|not the runtime's") + "\n";
+  child += line(500, 2, "videoout", "Validation Error: [ VUID-1 ] only main logs have these") + "\n";
+
+  auto const fromChild = trace(child).report;
+  CHECK(count(fromChild, "exception") == 1);
+  CHECK(count(fromChild, "missing symbol") == 1);
+  CHECK(count(fromChild, "validation error") == 0);
+
+  std::string main = line(0, 1, "main", "main process") + "\n";
+  main += line(100, 2, "videoout", "Validation Error: [ VUID-1 ] bad") + "\n";
+  main += line(200, 2, "runtime", "Missing Symbol|sceKernelFoo") + "\n";
+
+  auto const fromMain = trace(main).report;
+  CHECK(count(fromMain, "validation error") == 1);
+  CHECK(count(fromMain, "missing symbol") == 0);
+}
+
+int main() {
+  testSparseThreadsGrowTheBin();
+  testMarkersMatchTheRules();
+  return check::result();
+}